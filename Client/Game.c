@@ -97,6 +97,26 @@ static void rr_game_read_account(struct rr_game *this, struct proto_bug *decoder
     }
 }
 
+// only the entries that changed, with their new counts
+static void rr_game_read_account_delta(struct rr_game *this,
+                                       struct proto_bug *decoder)
+{
+    this->cache.experience = proto_bug_read_float64(decoder, "xp");
+    uint8_t id;
+    while ((id = proto_bug_read_uint8(decoder, "id")))
+    {
+        uint8_t rarity = proto_bug_read_uint8(decoder, "rarity");
+        uint32_t count = proto_bug_read_varuint(decoder, "count");
+        this->inventory[id][rarity] = count;
+    }
+    while ((id = proto_bug_read_uint8(decoder, "id")))
+    {
+        uint8_t rarity = proto_bug_read_uint8(decoder, "rarity");
+        uint32_t count = proto_bug_read_varuint(decoder, "count");
+        this->cache.mob_kills[id - 1][rarity] = count;
+    }
+}
+
 uint32_t rr_game_get_adjusted_inventory_count(struct rr_game *this, uint8_t id,
                                               uint8_t rarity)
 {
@@ -1035,9 +1055,12 @@ void rr_game_websocket_on_event_function(enum rr_websocket_event_type type,
         }
         case rr_clientbound_squad_dump:
         {
+            // the shared part is only sent when it changed, the per client
+            // patch around it always is
             this->is_dev = proto_bug_read_uint8(&encoder, "is_dev");
             this->kick_vote_pos = proto_bug_read_uint8(&encoder, "kick vote");
-            for (uint32_t s = 0; s < RR_SQUAD_COUNT; ++s)
+            uint8_t has_dump = proto_bug_read_uint8(&encoder, "has dump");
+            for (uint32_t s = 0; has_dump && s < RR_SQUAD_COUNT; ++s)
             {
                 struct rr_game_squad *squad = &this->other_squads[s];
                 for (uint32_t i = 0; i < RR_SQUAD_MEMBER_COUNT; ++i)
@@ -1050,8 +1073,6 @@ void rr_game_websocket_on_event_function(enum rr_websocket_event_type type,
                         proto_bug_read_uint8(&encoder, "ready");
                     squad->squad_members[i].disconnected =
                         proto_bug_read_uint8(&encoder, "disconnected");
-                    squad->squad_members[i].blocked =
-                        proto_bug_read_uint8(&encoder, "blocked");
                     squad->squad_members[i].is_dev =
                         proto_bug_read_uint8(&encoder, "is_dev");
                     uint8_t kick_vote_count =
@@ -1112,6 +1133,26 @@ void rr_game_websocket_on_event_function(enum rr_websocket_event_type type,
                 proto_bug_read_string(&encoder, squad->squad_code, 16,
                                       "squad code");
             }
+            uint8_t blocked[RR_BITSET_ROUND(RR_SQUAD_COUNT *
+                                            RR_SQUAD_MEMBER_COUNT)];
+            for (uint32_t i = 0; i < sizeof blocked; ++i)
+                blocked[i] = proto_bug_read_uint8(&encoder, "blocked");
+            for (uint32_t s = 0; s < RR_SQUAD_COUNT; ++s)
+            {
+                struct rr_game_squad *squad = &this->other_squads[s];
+                for (uint32_t i = 0; i < RR_SQUAD_MEMBER_COUNT; ++i)
+                    squad->squad_members[i].blocked =
+                        rr_bitset_get(blocked, s * RR_SQUAD_MEMBER_COUNT + i);
+                if (!squad->squad_expose_code)
+                    strcpy(squad->squad_code, "(private)");
+            }
+            while (proto_bug_read_uint8(&encoder, "continue"))
+            {
+                struct rr_game_squad *squad = &this->other_squads
+                    [proto_bug_read_uint8(&encoder, "squad") % RR_SQUAD_COUNT];
+                proto_bug_read_string(&encoder, squad->squad_code, 16,
+                                      "squad code");
+            }
             break;
         }
         case rr_clientbound_animation_update:
@@ -1224,6 +1265,9 @@ void rr_game_websocket_on_event_function(enum rr_websocket_event_type type,
         case rr_clientbound_account_result:
             rr_game_read_account(this, &encoder);
             break;
+        case rr_clientbound_account_delta:
+            rr_game_read_account_delta(this, &encoder);
+            break;
         case rr_clientbound_craft_result:
         {
             this->crafting_data.crafting_id =
@@ -1662,7 +1706,6 @@ void rr_game_tick(struct rr_game *this, float delta)
         }
 #undef GRID_SIZE
         struct rr_simulation *sim = this->simulation;
-        rr_simulation_create_component_vectors(sim);
         if (rr_frand() < 0.05)
         {
             EntityIdx petal_id = rr_simulation_alloc_entity(sim);
@@ -1709,12 +1752,13 @@ void rr_game_tick(struct rr_game *this, float delta)
             physical->velocity.x = rr_frand() * 40 + 80;
             physical->velocity.y = rr_frand() * 5 + 15;
             physical->animation_timer = rr_frand() * M_PI * 2;
-            physical->parent_id = rand() % 3;
+            physical->parent_id = rr_rand() % 3;
         }
         rr_system_particle_render_tick(this, &this->default_particle_manager,
                                        delta);
         struct rr_renderer_context_state state2;
-        for (uint32_t i = 0; i < this->simulation->petal_count; ++i)
+        // no ++i on deletion, the last petal is swapped into the freed slot
+        for (uint32_t i = 0; i < this->simulation->petal_count;)
         {
             struct rr_component_physical *physical = rr_simulation_get_physical(
                 sim, this->simulation->petal_vector[i]);
@@ -1733,11 +1777,13 @@ void rr_game_tick(struct rr_game *this, float delta)
             rr_renderer_context_state_free(this->renderer, &state2);
             if (physical->lerp_x > 1200)
             {
-                __rr_simulation_pending_deletion_free_components(
-                    this->simulation->petal_vector[i], sim);
-                __rr_simulation_pending_deletion_unset_entity(
-                    this->simulation->petal_vector[i], sim);
+                EntityIdx petal_id = this->simulation->petal_vector[i];
+                __rr_simulation_pending_deletion_free_components(petal_id, sim);
+                __rr_simulation_pending_deletion_unset_entity(petal_id, sim);
+                __rr_simulation_release_entity(petal_id, sim);
             }
+            else
+                ++i;
         }
         rr_system_particle_render_tick(this, &this->foreground_particle_manager,
                                        delta);
@@ -190,7 +190,7 @@ void rr_focus_event(struct rr_game *this, uint8_t type, uint8_t trusted)
 void rr_main_loop(struct rr_game *this)
 {
     printf("client on version %llu\n", RR_SECRET8 ^ 255);
-    srand(time(0));
+    rr_srand(time(0));
 #ifdef __EMSCRIPTEN__
     EM_ASM(
         {
@@ -88,7 +88,7 @@ void rr_component_petal_render(EntityIdx entity, struct rr_game *game,
         particle->color = 0xffffffff;
         if (petal->id == rr_petal_id_fireball)
         {
-            switch (rand() % 3)
+            switch (rr_rand() % 3)
             {
             case 0:
                 particle->color = 0xffbc0303;
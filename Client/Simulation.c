@@ -89,7 +89,8 @@ void rr_simulation_read_binary(struct rr_game *game, struct proto_bug *encoder)
 //             printf("create entity with id %d, components %d\n", id,
 //                    component_flags);
 // #endif
-            this->entity_tracker[id] = 1 | component_flags;
+            // add sets the component bits so the entity lands in the vectors
+            this->entity_tracker[id] = 1;
 #define XX(COMPONENT, ID)                                                      \
     if (component_flags & (1 << ID))                                           \
         rr_simulation_add_##COMPONENT(this, id);
@@ -118,7 +119,6 @@ void rr_simulation_read_binary(struct rr_game *game, struct proto_bug *encoder)
 
 void rr_simulation_tick(struct rr_simulation *this, float delta)
 {
-    rr_simulation_create_component_vectors(this);
     rr_system_interpolation_tick(this, delta);
 }
 
@@ -132,24 +132,23 @@ void rr_deletion_simulation_tick(struct rr_simulation *this, float delta)
                            this->pending_deletions +
                                RR_BITSET_ROUND(RR_MAX_ENTITY_COUNT),
                            this, __rr_simulation_pending_deletion_unset_entity);
+    rr_bitset_for_each_bit(
+        this->pending_deletions,
+        this->pending_deletions + RR_BITSET_ROUND(RR_MAX_ENTITY_COUNT), this,
+        __rr_simulation_release_entity);
     memset(this->pending_deletions, 0, RR_BITSET_ROUND(RR_MAX_ENTITY_COUNT));
-    rr_simulation_create_component_vectors(this);
     rr_system_deletion_animation_tick(this, delta);
 }
 
 EntityIdx rr_simulation_alloc_entity(struct rr_simulation *this)
 {
-    for (EntityIdx i = 1; i < RR_MAX_ENTITY_COUNT; i++)
-    {
-        if (!rr_simulation_has_entity(this, i))
-        {
-            this->entity_tracker[i] = 1;
-            // no more manual
+    EntityIdx i = __rr_simulation_take_free_entity(this);
+    if (i == RR_NULL_ENTITY)
+        RR_UNREACHABLE("ran out of entity ids");
+    this->entity_tracker[i] = 1;
+    // no more manual
 #ifndef NDEBUG
-            printf("<rr_simulation::entity_create::%d>\n", i);
+    printf("<rr_simulation::entity_create::%d>\n", i);
 #endif
-            return i;
-        }
-    }
-    RR_UNREACHABLE("ran out of entity ids");
+    return i;
 }
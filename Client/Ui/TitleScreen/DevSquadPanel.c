@@ -183,10 +183,10 @@ static void summon_mob_button_on_event(struct rr_ui_element *this,
             uint8_t max_id = rr_mob_id_edmontosaurus + 1;
             uint8_t id = game->dev_cheats.summon_mob_id * max_id;
             if (id == max_id)
-                id = rand() % max_id;
+                id = rr_rand() % max_id;
             uint8_t rarity = game->dev_cheats.summon_mob_rarity * rr_rarity_id_max;
             if (rarity == rr_rarity_id_max)
-                rarity = rand() % rr_rarity_id_max;
+                rarity = rr_rand() % rr_rarity_id_max;
             struct proto_bug encoder;
             proto_bug_init(&encoder, RR_OUTGOING_PACKET);
             proto_bug_write_uint8(&encoder, game->socket.quick_verification, "qv");
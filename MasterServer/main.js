@@ -558,6 +558,37 @@ wss.on("connection", (ws, req) => {
                 db_append_petals_to_logs(petals);
                 break;
             }
+            case 4:
+            {
+                // the entries changed since the last sync, with their new
+                // counts. a full case 2 follows every so often
+                const uuid = decoder.ReadStringNT();
+                if (!connected_clients[uuid] || connected_clients[uuid].server !== game_server.alias)
+                    break;
+                const user = connected_clients[uuid].user;
+                user.xp = decoder.ReadFloat64();
+                let id = decoder.ReadUint8();
+                while (id)
+                {
+                    const rarity = decoder.ReadUint8();
+                    const count = decoder.ReadVarUint();
+                    if (count)
+                        user.petals[id+':'+rarity] = count;
+                    else
+                        delete user.petals[id+':'+rarity];
+                    id = decoder.ReadUint8();
+                }
+                id = decoder.ReadUint8();
+                while (id)
+                {
+                    const rarity = decoder.ReadUint8();
+                    const count = decoder.ReadVarUint();
+                    user.mob_gallery[(id - 1)+':'+rarity] = count;
+                    id = decoder.ReadUint8();
+                }
+                await write_db_entry(uuid, user);
+                break;
+            }
             case 101:
                 game_server.rivet_server_id = decoder.ReadStringNT();
                 log("server id recv", [game_server.rivet_server_id]);
@@ -0,0 +1,157 @@
+// Copyright (C) 2024 Paul Johnson
+// Copyright (C) 2024-2025 Maxim Nesterov
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as
+// published by the Free Software Foundation, either version 3 of the
+// License, or (at your option) any later version.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Affero General Public License for more details.
+
+// You should have received a copy of the GNU Affero General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#include <Server/AnimationGrid.h>
+
+#include <math.h>
+#include <string.h>
+
+#include <Server/Client.h>
+#include <Server/Simulation.h>
+
+static uint32_t hash_cell(int32_t x, int32_t y, uint8_t group)
+{
+    uint32_t hash = ((uint32_t)x * 73856093u) ^ ((uint32_t)y * 19349663u) ^
+                    (group * 83492791u);
+    return hash & (RR_ANIMATION_GRID_BUCKET_COUNT - 1);
+}
+
+static void bounding_box(struct rr_simulation_animation *animation,
+                         float *min_x, float *min_y, float *max_x,
+                         float *max_y)
+{
+    switch (animation->type)
+    {
+    case rr_animation_type_lightningbolt:
+        *min_x = *max_x = animation->points[0].x;
+        *min_y = *max_y = animation->points[0].y;
+        for (uint32_t i = 1; i < animation->length; ++i)
+        {
+            *min_x = fminf(*min_x, animation->points[i].x);
+            *min_y = fminf(*min_y, animation->points[i].y);
+            *max_x = fmaxf(*max_x, animation->points[i].x);
+            *max_y = fmaxf(*max_y, animation->points[i].y);
+        }
+        break;
+    case rr_animation_type_area_damage:
+        *min_x = animation->x - animation->size;
+        *min_y = animation->y - animation->size;
+        *max_x = animation->x + animation->size;
+        *max_y = animation->y + animation->size;
+        break;
+    default:
+        *min_x = *max_x = animation->x;
+        *min_y = *max_y = animation->y;
+        break;
+    }
+}
+
+void rr_animation_grid_build(struct rr_animation_grid *this,
+                             struct rr_simulation *simulation)
+{
+    this->animation_count = simulation->animation_length;
+    this->chat_count = 0;
+    this->max_half_extent = 0;
+    memset(this->bucket_starts, 0, sizeof this->bucket_starts);
+    for (uint32_t i = 0; i < this->animation_count; ++i)
+    {
+        struct rr_simulation_animation *animation = &simulation->animations[i];
+        if (animation->type == rr_animation_type_chat)
+        {
+            this->chats[this->chat_count++] = i;
+            this->bucket[i] = RR_ANIMATION_GRID_BUCKET_COUNT;
+            continue;
+        }
+        this->root_owner[i] =
+            rr_simulation_get_relations(simulation, animation->owner)
+                ->root_owner;
+        this->hidden[i] =
+            dev_cheat_enabled(simulation, animation->owner, invisible);
+        this->group[i] =
+            animation->type == rr_animation_type_damagenumber &&
+                    animation->color_type != rr_animation_color_type_heal
+                ? animation->squad + 1
+                : 0;
+        float min_x, min_y, max_x, max_y;
+        bounding_box(animation, &min_x, &min_y, &max_x, &max_y);
+        this->x[i] = (min_x + max_x) * 0.5f;
+        this->y[i] = (min_y + max_y) * 0.5f;
+        this->half_width[i] = (max_x - min_x) * 0.5f;
+        this->half_height[i] = (max_y - min_y) * 0.5f;
+        if (this->half_width[i] > this->max_half_extent)
+            this->max_half_extent = this->half_width[i];
+        if (this->half_height[i] > this->max_half_extent)
+            this->max_half_extent = this->half_height[i];
+        this->cell_x[i] = floorf(this->x[i] / RR_ANIMATION_GRID_CELL_SIZE);
+        this->cell_y[i] = floorf(this->y[i] / RR_ANIMATION_GRID_CELL_SIZE);
+        this->bucket[i] =
+            hash_cell(this->cell_x[i], this->cell_y[i], this->group[i]);
+        ++this->bucket_starts[this->bucket[i]];
+    }
+    for (uint32_t b = 1; b <= RR_ANIMATION_GRID_BUCKET_COUNT; ++b)
+        this->bucket_starts[b] += this->bucket_starts[b - 1];
+    // walking backwards keeps every bucket in animation order
+    for (uint32_t i = this->animation_count; i-- > 0;)
+        if (this->bucket[i] != RR_ANIMATION_GRID_BUCKET_COUNT)
+            this->sorted[--this->bucket_starts[this->bucket[i]]] = i;
+}
+
+static uint8_t overlaps(struct rr_animation_grid *this, uint32_t i, float x,
+                        float y, float half_width, float half_height)
+{
+    return fabsf(this->x[i] - x) <= half_width + this->half_width[i] &&
+           fabsf(this->y[i] - y) <= half_height + this->half_height[i];
+}
+
+void rr_animation_grid_query(struct rr_animation_grid *this, float x, float y,
+                             float half_width, float half_height,
+                             uint8_t group, void *captures,
+                             void (*cb)(uint32_t, void *))
+{
+    float reach_x = half_width + this->max_half_extent;
+    float reach_y = half_height + this->max_half_extent;
+    int32_t s_x = floorf((x - reach_x) / RR_ANIMATION_GRID_CELL_SIZE);
+    int32_t e_x = floorf((x + reach_x) / RR_ANIMATION_GRID_CELL_SIZE);
+    int32_t s_y = floorf((y - reach_y) / RR_ANIMATION_GRID_CELL_SIZE);
+    int32_t e_y = floorf((y + reach_y) / RR_ANIMATION_GRID_CELL_SIZE);
+    if ((uint64_t)(e_x - s_x + 1) * (e_y - s_y + 1) >
+        RR_ANIMATION_GRID_BUCKET_COUNT)
+    {
+        // a rectangle this large visits every bucket anyway
+        for (uint32_t i = 0; i < this->animation_count; ++i)
+            if (this->bucket[i] != RR_ANIMATION_GRID_BUCKET_COUNT &&
+                this->group[i] == group &&
+                overlaps(this, i, x, y, half_width, half_height))
+                cb(i, captures);
+        return;
+    }
+    for (int32_t c_y = s_y; c_y <= e_y; ++c_y)
+        for (int32_t c_x = s_x; c_x <= e_x; ++c_x)
+        {
+            uint32_t bucket = hash_cell(c_x, c_y, group);
+            for (uint32_t j = this->bucket_starts[bucket];
+                 j < this->bucket_starts[bucket + 1]; ++j)
+            {
+                uint32_t i = this->sorted[j];
+                // other cells and groups can share the bucket
+                if (this->cell_x[i] != c_x || this->cell_y[i] != c_y ||
+                    this->group[i] != group)
+                    continue;
+                if (overlaps(this, i, x, y, half_width, half_height))
+                    cb(i, captures);
+            }
+        }
+}
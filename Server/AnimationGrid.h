@@ -0,0 +1,62 @@
+// Copyright (C) 2024 Paul Johnson
+// Copyright (C) 2024-2025 Maxim Nesterov
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as
+// published by the Free Software Foundation, either version 3 of the
+// License, or (at your option) any later version.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Affero General Public License for more details.
+
+// You should have received a copy of the GNU Affero General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <stdint.h>
+
+#include <Shared/Entity.h>
+
+// must be a power of two
+#define RR_ANIMATION_GRID_BUCKET_COUNT (4096)
+#define RR_ANIMATION_GRID_CELL_SIZE (1024)
+
+struct rr_simulation;
+
+// Index over the animations of one tick, built once before the clients are
+// encoded. Chat messages go to every client and are only kept in order.
+// Everything else is hashed into buckets by the cell of its anchor point and
+// by group, which is 0 for animations everyone may see and squad + 1 for
+// damage numbers that only their squad sees. Owner lookups that used to be
+// repeated for every client are stored per animation.
+struct rr_animation_grid
+{
+    uint32_t bucket_starts[RR_ANIMATION_GRID_BUCKET_COUNT + 1];
+    uint16_t sorted[RR_MAX_ANIMATION_COUNT];
+    uint16_t chats[RR_MAX_ANIMATION_COUNT];
+    int32_t cell_x[RR_MAX_ANIMATION_COUNT];
+    int32_t cell_y[RR_MAX_ANIMATION_COUNT];
+    uint32_t bucket[RR_MAX_ANIMATION_COUNT];
+    // bounding box of the animation, as center and half extents
+    float x[RR_MAX_ANIMATION_COUNT];
+    float y[RR_MAX_ANIMATION_COUNT];
+    float half_width[RR_MAX_ANIMATION_COUNT];
+    float half_height[RR_MAX_ANIMATION_COUNT];
+    EntityIdx root_owner[RR_MAX_ANIMATION_COUNT];
+    uint8_t group[RR_MAX_ANIMATION_COUNT];
+    uint8_t hidden[RR_MAX_ANIMATION_COUNT];
+    float max_half_extent;
+    uint32_t chat_count;
+    uint32_t animation_count;
+};
+
+void rr_animation_grid_build(struct rr_animation_grid *,
+                             struct rr_simulation *);
+// calls back once for every animation of the group whose bounding box may
+// overlap the rectangle given as center and half extents
+void rr_animation_grid_query(struct rr_animation_grid *, float, float, float,
+                             float, uint8_t, void *,
+                             void (*)(uint32_t, void *));
@@ -0,0 +1,70 @@
+// Copyright (C) 2024 Paul Johnson
+// Copyright (C) 2024-2025 Maxim Nesterov
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as
+// published by the Free Software Foundation, either version 3 of the
+// License, or (at your option) any later version.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Affero General Public License for more details.
+
+// You should have received a copy of the GNU Affero General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+// Plays back a recording made with RR_REPLAY_RECORD at full speed, without
+// sockets or the api, and prints the tick profile along the way. Stops after
+// the given tick so that a profiler attached to it ends on the spike.
+//
+// usage: rrolf-replay [-u last tick] recording
+//
+// The build has to match the one that recorded, proto_bug reads debug
+// metadata only in debug builds.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <Server/Profiler.h>
+#include <Server/Replay.h>
+#include <Server/Server.h>
+
+static int usage(char const *name)
+{
+    fprintf(stderr, "usage: %s [-u last tick] recording\n", name);
+    return 1;
+}
+
+int main(int argc, char **argv)
+{
+    uint32_t last_tick = UINT32_MAX;
+    int opt;
+    while ((opt = getopt(argc, argv, "u:")) != -1)
+    {
+        switch (opt)
+        {
+        case 'u':
+            last_tick = strtoul(optarg, NULL, 10);
+            break;
+        default:
+            return usage(argv[0]);
+        }
+    }
+    if (optind != argc - 1)
+        return usage(argv[0]);
+    struct rr_replay replay;
+    if (!rr_replay_open_playback(&replay, argv[optind]))
+    {
+        fprintf(stderr, "%s is not a recording\n", argv[optind]);
+        return 1;
+    }
+    struct rr_server *server = calloc(1, sizeof *server);
+    rr_server_init(server, replay.seed);
+    rr_server_replay(server, &replay, last_tick);
+    rr_profiler_report(&rr_profiler);
+    rr_replay_close(&replay);
+    return 0;
+}
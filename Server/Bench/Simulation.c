@@ -0,0 +1,326 @@
+// Copyright (C) 2024 Paul Johnson
+// Copyright (C) 2024-2025 Maxim Nesterov
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as
+// published by the Free Software Foundation, either version 3 of the
+// License, or (at your option) any later version.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Affero General Public License for more details.
+
+// You should have received a copy of the GNU Affero General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+// Runs the server simulation without lws or the api. Synthetic players are
+// dropped onto the HELL_CREEK maze, which is filled with mobs up front, and
+// wander around attacking. Reports the tick profile, the allocations made
+// while ticking and the update packet size per client.
+//
+// usage: rrolf-bench [-p players] [-d mobs per grid] [-t ticks] [-s seed]
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <Server/EntityAllocation.h>
+#include <Server/Profiler.h>
+#include <Server/Server.h>
+#include <Server/Simulation.h>
+#include <Server/UpdateProtocol.h>
+#include <Shared/Component/Flower.h>
+#include <Shared/StaticData.h>
+#include <Shared/Utilities.h>
+#include <Shared/pb.h>
+
+#define BENCH_PLAYER_LEVEL (100)
+
+struct bench_player
+{
+    float heading;
+};
+
+static uint64_t allocation_count;
+static uint64_t allocation_bytes;
+static uint8_t counting_allocations;
+
+// linked with -Wl,--wrap so every allocation made by the simulation is seen
+void *__real_malloc(size_t);
+void *__real_calloc(size_t, size_t);
+void *__real_realloc(void *, size_t);
+
+void *__wrap_malloc(size_t size)
+{
+    allocation_count += counting_allocations;
+    allocation_bytes += counting_allocations * size;
+    return __real_malloc(size);
+}
+
+void *__wrap_calloc(size_t count, size_t size)
+{
+    allocation_count += counting_allocations;
+    allocation_bytes += counting_allocations * count * size;
+    return __real_calloc(count, size);
+}
+
+void *__wrap_realloc(void *ptr, size_t size)
+{
+    allocation_count += counting_allocations;
+    allocation_bytes += counting_allocations * size;
+    return __real_realloc(ptr, size);
+}
+
+// the bench has no api to talk to and leaves the account bookkeeping of
+// Client.c out
+void rr_server_client_write_to_api(struct rr_server_client *this) {}
+
+void rr_server_client_change_mob_gallery(struct rr_server_client *this,
+                                         uint8_t id, uint8_t rarity)
+{
+}
+
+static uint8_t const loadout_petals[] = {
+    rr_petal_id_stinger, rr_petal_id_basic,  rr_petal_id_pellet,
+    rr_petal_id_leaf,    rr_petal_id_bone,   rr_petal_id_club,
+    rr_petal_id_beak,    rr_petal_id_fossil, rr_petal_id_crest,
+    rr_petal_id_gravel,  rr_petal_id_azalea, rr_petal_id_feather};
+
+static uint32_t walkable[256 * 256];
+static uint32_t walkable_count;
+
+static int is_walkable(struct rr_maze_grid *grid)
+{
+    return grid->value != 0 && (grid->value & 8) == 0;
+}
+
+static void random_position(struct rr_component_arena *arena, float *x,
+                            float *y, struct rr_maze_grid **grid)
+{
+    uint32_t dim = arena->maze->maze_dim;
+    uint32_t index = walkable[rr_rand() % walkable_count];
+    *x = (index % dim + rr_frand()) * arena->maze->grid_size;
+    *y = (index / dim + rr_frand()) * arena->maze->grid_size;
+    *grid = &arena->maze->maze[index];
+}
+
+static uint8_t random_mob_id(void)
+{
+    double seed = rr_frand();
+    uint8_t id = 0;
+    for (; id < rr_mob_id_max - 1; ++id)
+        if (seed <= RR_HELL_CREEK_MOB_ID_RARITY_COEFFICIENTS[id])
+            break;
+    return id;
+}
+
+// mobs are spread over every walkable grid at the rarity its difficulty
+// spawns, leaving room for the players and their petals
+static void fill_maze(struct rr_simulation *simulation, float density,
+                      uint32_t reserved)
+{
+    struct rr_component_arena *arena = rr_simulation_get_arena(simulation, 1);
+    uint32_t dim = arena->maze->maze_dim;
+    for (uint32_t i = 0; i < dim * dim; ++i)
+        if (is_walkable(&arena->maze->maze[i]))
+            walkable[walkable_count++] = i;
+    uint32_t mob_count = walkable_count * density;
+    if (mob_count > RR_MAX_ENTITY_COUNT - reserved)
+        mob_count = RR_MAX_ENTITY_COUNT - reserved;
+    for (uint32_t i = 0; i < mob_count; ++i)
+    {
+        float x;
+        float y;
+        struct rr_maze_grid *grid;
+        random_position(arena, &x, &y, &grid);
+        uint8_t id = random_mob_id();
+        uint8_t rarity = rr_rarity_id_common + (grid->difficulty + 7) / 8;
+        if (rarity > rr_rarity_id_ultimate)
+            rarity = rr_rarity_id_ultimate;
+        EntityIdx mob = rr_simulation_alloc_mob(simulation, 1, x, y, id, rarity,
+                                                rr_simulation_team_id_mobs);
+        rr_simulation_get_mob(simulation, mob)->zone = grid;
+        grid->grid_points += RR_MOB_DIFFICULTY_COEFFICIENTS[id];
+    }
+}
+
+// what joining a squad and then the game does on the server
+static void spawn_player(struct rr_server *server, uint32_t index)
+{
+    struct rr_simulation *simulation = &server->simulation;
+    struct rr_server_client *client = &server->clients[index];
+    memset(client, 0, sizeof *client);
+    client->server = server;
+    client->dev_cheats.speed_percent = 1;
+    client->dev_cheats.fov_percent = 1;
+    client->in_use = 1;
+    client->verified = 1;
+    client->in_squad = 1;
+    client->squad = index / RR_SQUAD_MEMBER_COUNT;
+    rr_bitset_set(server->clients_in_use, index);
+    struct rr_squad *squad = &server->squads[client->squad];
+    rr_squad_add_client(squad, client);
+    struct rr_squad_member *member = &squad->members[client->squad_pos];
+    member->playing = 1;
+    member->level = BENCH_PLAYER_LEVEL;
+    snprintf(member->nickname, sizeof member->nickname, "bench %u", index);
+
+    struct rr_component_player_info *player_info = client->player_info =
+        rr_simulation_add_player_info(simulation,
+                                      rr_simulation_alloc_entity(simulation));
+    player_info->client = client;
+    player_info->squad = client->squad;
+    player_info->squad_member = member;
+    player_info->level = BENCH_PLAYER_LEVEL;
+    rr_component_player_info_set_squad_pos(player_info, client->squad_pos);
+    rr_component_player_info_set_slot_count(
+        player_info, RR_SLOT_COUNT_FROM_LEVEL(BENCH_PLAYER_LEVEL));
+    for (uint32_t i = 0; i < player_info->slot_count; ++i)
+    {
+        uint8_t id = loadout_petals[(index + i) % sizeof loadout_petals];
+        player_info->slots[i].id = id;
+        player_info->slots[i].rarity = rr_rarity_id_ultimate;
+        player_info->slots[i].count =
+            RR_PETAL_DATA[id].count[rr_rarity_id_ultimate];
+        for (uint32_t j = 0; j < player_info->slots[i].count; ++j)
+            player_info->slots[i].petals[j].cooldown_ticks =
+                RR_PETAL_DATA[id].cooldown;
+    }
+
+    EntityIdx flower =
+        rr_simulation_alloc_player(simulation, 1, player_info->parent_id);
+    struct rr_component_physical *physical =
+        rr_simulation_get_physical(simulation, flower);
+    float x;
+    float y;
+    struct rr_maze_grid *grid;
+    random_position(rr_simulation_get_arena(simulation, 1), &x, &y, &grid);
+    rr_component_physical_set_x(physical, x);
+    rr_component_physical_set_y(physical, y);
+}
+
+// players wander in a new direction every two seconds and attack for three
+// out of every four
+static void script_input(struct rr_server *server, struct bench_player *player,
+                         struct rr_server_client *client, uint32_t tick)
+{
+    struct rr_simulation *simulation = &server->simulation;
+    struct rr_component_player_info *player_info = client->player_info;
+    if (!rr_simulation_entity_alive(simulation, player_info->flower_id) ||
+        is_dead_flower(simulation, player_info->flower_id))
+        return;
+    if (tick % 50 == 0)
+        player->heading = rr_frand() * 2 * M_PI;
+    client->player_accel_x = cosf(player->heading) * RR_PLAYER_SPEED;
+    client->player_accel_y = sinf(player->heading) * RR_PLAYER_SPEED;
+    player_info->input = tick % 100 < 75;
+    rr_vector_set(
+        &rr_simulation_get_physical(simulation, player_info->flower_id)
+             ->acceleration,
+        client->player_accel_x, client->player_accel_y);
+}
+
+int main(int argc, char **argv)
+{
+    uint32_t player_count = 20;
+    float density = 1;
+    uint32_t tick_count = 25 * 60;
+    uint32_t seed = 1;
+    int opt;
+    while ((opt = getopt(argc, argv, "p:d:t:s:")) != -1)
+    {
+        switch (opt)
+        {
+        case 'p':
+            player_count = atoi(optarg);
+            break;
+        case 'd':
+            density = atof(optarg);
+            break;
+        case 't':
+            tick_count = atoi(optarg);
+            break;
+        case 's':
+            seed = atoi(optarg);
+            break;
+        default:
+            fprintf(stderr,
+                    "usage: %s [-p players] [-d mobs per grid] [-t ticks] "
+                    "[-s seed]\n",
+                    argv[0]);
+            return 1;
+        }
+    }
+    if (player_count > RR_MAX_CLIENT_COUNT)
+        player_count = RR_MAX_CLIENT_COUNT;
+    rr_srand(seed);
+    RR_GLOBAL_BIOME = rr_biome_id_hell_creek;
+    rr_static_data_init();
+    rr_profiler_init(&rr_profiler);
+
+    struct rr_server *server = calloc(1, sizeof *server);
+    struct rr_simulation *simulation = &server->simulation;
+    rr_simulation_init(simulation);
+    simulation->server = server;
+    for (uint32_t i = 0; i < RR_SQUAD_COUNT; ++i)
+        rr_squad_init(&server->squads[i], server, i);
+    // a player with all slots filled is about 60 entities
+    fill_maze(simulation, density, player_count * 64 + 1024);
+    struct bench_player players[RR_MAX_CLIENT_COUNT] = {0};
+    for (uint32_t i = 0; i < player_count; ++i)
+        spawn_player(server, i);
+    printf("%u players, %u mobs on %u walkable grids, %u ticks\n",
+           player_count, simulation->mob_count, walkable_count, tick_count);
+
+    uint8_t *packet = malloc(MESSAGE_BUFFER_SIZE);
+    uint64_t packet_bytes = 0;
+    uint64_t max_packet_bytes = 0;
+    counting_allocations = 1;
+    for (uint32_t tick = 0; tick < tick_count; ++tick)
+    {
+        for (uint32_t i = 0; i < player_count; ++i)
+            script_input(server, &players[i], &server->clients[i], tick);
+        RR_TIME_BLOCK(simulation, rr_simulation_tick(simulation));
+        RR_TIME_BLOCK(encode, {
+            for (uint32_t i = 0; i < player_count; ++i)
+            {
+                struct rr_server_client *client = &server->clients[i];
+                client->player_info->drops_this_tick_size = 0;
+                struct proto_bug encoder;
+                proto_bug_init(&encoder, packet);
+                rr_simulation_write_binary(simulation, &encoder,
+                                           client->player_info);
+                uint64_t size = encoder.current - encoder.start;
+                client->net_stats.header_bytes[rr_clientbound_update] += size;
+                packet_bytes += size;
+                if (size > max_packet_bytes)
+                    max_packet_bytes = size;
+            }
+        });
+        rr_simulation_reset_protocol_state(simulation);
+        simulation->animation_length = 0;
+        rr_profiler_end_tick(&rr_profiler, simulation);
+    }
+    counting_allocations = 0;
+
+    rr_profiler_report(&rr_profiler);
+    printf("%lu allocations, %.1f per tick, %lu bytes\n", allocation_count,
+           (double)allocation_count / tick_count, allocation_bytes);
+    double client_ticks = (double)player_count * tick_count;
+    printf("update packet: %.1f bytes per client per tick, largest %lu\n",
+           packet_bytes / client_ticks, max_packet_bytes);
+    for (uint32_t id = 0; id < RR_NET_STATS_COMPONENT_SLOTS; ++id)
+    {
+        if (rr_component_names[id] == NULL)
+            continue;
+        uint64_t bytes = 0;
+        for (uint32_t i = 0; i < player_count; ++i)
+            bytes += server->clients[i].net_stats.component_bytes[id];
+        printf("  %-12s %10.1f bytes per client per tick\n",
+               rr_component_names[id], bytes / client_ticks);
+    }
+    return 0;
+}
@@ -0,0 +1,335 @@
+// Copyright (C) 2024 Paul Johnson
+// Copyright (C) 2024-2025 Maxim Nesterov
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as
+// published by the Free Software Foundation, either version 3 of the
+// License, or (at your option) any later version.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Affero General Public License for more details.
+
+// You should have received a copy of the GNU Affero General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+// Replays entity positions through the spatial hash at different cell sizes
+// and reports the cost of building the grid, the collision broadphase (scalar
+// candidate pairs and the batched overlap test) and range queries. Frames either come from a file written by a server running
+// with RR_SPATIAL_HASH_RECORD=<path> or are generated from the HELL_CREEK
+// maze.
+//
+// usage: rrolf-spatial-hash-bench [-r record] [-f frames] [-d mobs per grid]
+//                                 [-p players] [-s seed] [-c cell size]
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <Server/SpatialHash.h>
+#include <Shared/StaticData.h>
+#include <Shared/Utilities.h>
+
+#define MAX_FRAME_COUNT (1024)
+
+struct frame
+{
+    float extent;
+    uint32_t count;
+    float *x;
+    float *y;
+    float *radius;
+};
+
+struct bench_result
+{
+    double build;
+    double broadphase;
+    double batched;
+    double query;
+    uint64_t candidates;
+    uint64_t overlaps;
+    uint64_t batched_overlaps;
+    uint64_t query_candidates;
+};
+
+struct bench_captures
+{
+    struct frame *frame;
+    struct bench_result *result;
+};
+
+static struct frame frames[MAX_FRAME_COUNT];
+static uint32_t frame_count;
+
+static double now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e6 + ts.tv_nsec / 1e3;
+}
+
+static void frame_alloc(struct frame *frame, float extent, uint32_t count)
+{
+    frame->extent = extent;
+    frame->count = count;
+    frame->x = malloc(count * sizeof *frame->x);
+    frame->y = malloc(count * sizeof *frame->y);
+    frame->radius = malloc(count * sizeof *frame->radius);
+}
+
+static void read_record(char const *path)
+{
+    FILE *file = fopen(path, "rb");
+    if (file == NULL)
+    {
+        perror(path);
+        exit(1);
+    }
+    float extent;
+    uint32_t count;
+    while (frame_count < MAX_FRAME_COUNT &&
+           fread(&extent, sizeof extent, 1, file) == 1 &&
+           fread(&count, sizeof count, 1, file) == 1)
+    {
+        struct frame *frame = &frames[frame_count++];
+        frame_alloc(frame, extent, count);
+        for (uint32_t i = 0; i < count; ++i)
+        {
+            float position[3];
+            if (fread(position, sizeof position, 1, file) != 1)
+            {
+                fprintf(stderr, "%s: truncated frame %u\n", path, frame_count);
+                exit(1);
+            }
+            frame->x[i] = position[0];
+            frame->y[i] = position[1];
+            frame->radius[i] = position[2];
+        }
+    }
+    fclose(file);
+}
+
+static uint8_t random_mob_id(void)
+{
+    double seed = rr_frand();
+    uint8_t id = 0;
+    for (; id < rr_mob_id_max - 1; ++id)
+        if (seed <= RR_HELL_CREEK_MOB_ID_RARITY_COEFFICIENTS[id])
+            break;
+    return id;
+}
+
+// mobs are scattered over every walkable grid with the radius of the rarity
+// the grid spawns, players are dropped onto random walkable grids with a ring
+// of petals around them
+static void generate_frames(uint32_t count, float density,
+                            uint32_t player_count)
+{
+    struct rr_maze_declaration *maze = &RR_MAZES[rr_biome_id_hell_creek];
+    uint32_t dim = maze->maze_dim;
+    float grid_size = maze->grid_size;
+    uint32_t walkable[dim * dim];
+    uint32_t walkable_count = 0;
+    for (uint32_t i = 0; i < dim * dim; ++i)
+        if (maze->maze[i].difficulty > 0)
+            walkable[walkable_count++] = i;
+    for (uint32_t f = 0; f < count && frame_count < MAX_FRAME_COUNT; ++f)
+    {
+        uint32_t mob_count = walkable_count * density;
+        uint32_t total = mob_count + player_count * 11;
+        if (total > RR_MAX_ENTITY_COUNT)
+            total = RR_MAX_ENTITY_COUNT;
+        struct frame *frame = &frames[frame_count++];
+        frame_alloc(frame, dim * grid_size, total);
+        uint32_t at = 0;
+        for (; at < mob_count && at < total; ++at)
+        {
+            uint32_t grid = walkable[rr_rand() % walkable_count];
+            uint32_t rarity =
+                rr_rarity_id_common + (maze->maze[grid].difficulty + 7) / 8;
+            if (rarity > rr_rarity_id_ultimate)
+                rarity = rr_rarity_id_ultimate;
+            frame->x[at] = (grid % dim + rr_frand()) * grid_size;
+            frame->y[at] = (grid / dim + rr_frand()) * grid_size;
+            frame->radius[at] = RR_MOB_DATA[random_mob_id()].radius *
+                                RR_MOB_RARITY_SCALING[rarity].radius;
+        }
+        while (at < total)
+        {
+            uint32_t grid = walkable[rr_rand() % walkable_count];
+            float x = (grid % dim + rr_frand()) * grid_size;
+            float y = (grid / dim + rr_frand()) * grid_size;
+            frame->x[at] = x;
+            frame->y[at] = y;
+            frame->radius[at++] = 25;
+            for (uint32_t p = 0; p < 10 && at < total; ++p, ++at)
+            {
+                float angle = p * M_PI / 5;
+                frame->x[at] = x + cosf(angle) * 75;
+                frame->y[at] = y + sinf(angle) * 75;
+                frame->radius[at] = 10;
+            }
+        }
+    }
+}
+
+static void count_candidate(struct rr_simulation *simulation, EntityIdx a,
+                            EntityIdx b, void *_captures)
+{
+    struct bench_captures *captures = _captures;
+    struct frame *frame = captures->frame;
+    ++captures->result->candidates;
+    float dx = frame->x[a] - frame->x[b];
+    float dy = frame->y[a] - frame->y[b];
+    float r = frame->radius[a] + frame->radius[b];
+    if (dx * dx + dy * dy < r * r)
+        ++captures->result->overlaps;
+}
+
+static void count_batched_overlap(struct rr_simulation *simulation,
+                                  EntityIdx a, EntityIdx b, void *_captures)
+{
+    struct bench_captures *captures = _captures;
+    ++captures->result->batched_overlaps;
+}
+
+static void count_query_candidate(EntityIdx entity, void *_captures)
+{
+    struct bench_captures *captures = _captures;
+    ++captures->result->query_candidates;
+}
+
+static void run(float cell_size, struct bench_result *result)
+{
+    memset(result, 0, sizeof *result);
+    struct rr_spatial_hash hash;
+    for (uint32_t f = 0; f < frame_count; ++f)
+    {
+        struct frame *frame = &frames[f];
+        struct bench_captures captures = {frame, result};
+        rr_spatial_hash_init(&hash, NULL, frame->extent, cell_size);
+
+        double start = now();
+        for (uint32_t i = 0; i < frame->count; ++i)
+            rr_spatial_hash_insert(&hash, i, frame->x[i], frame->y[i],
+                                   frame->radius[i]);
+        rr_spatial_hash_build(&hash);
+        double built = now();
+        rr_spatial_hash_find_possible_collisions(&hash, &captures,
+                                                 count_candidate);
+        double collided = now();
+        rr_spatial_hash_find_overlapping_pairs(&hash, &captures,
+                                               count_batched_overlap);
+        double batched = now();
+        // one lightning sized search per small entity plus one client view
+        // per every 64 entities
+        for (uint32_t i = 0; i < frame->count; ++i)
+        {
+            if (frame->radius[i] <= 25)
+                rr_spatial_hash_query(&hash, frame->x[i], frame->y[i],
+                                      400 + frame->radius[i],
+                                      400 + frame->radius[i], &captures,
+                                      count_query_candidate);
+            if (i % 64 == 0)
+                rr_spatial_hash_query(&hash, frame->x[i], frame->y[i], 1280,
+                                      720, &captures, count_query_candidate);
+        }
+        double queried = now();
+
+        result->build += built - start;
+        result->broadphase += collided - built;
+        result->batched += batched - collided;
+        result->query += queried - batched;
+        rr_spatial_hash_free(&hash);
+    }
+}
+
+int main(int argc, char **argv)
+{
+    char const *record = NULL;
+    uint32_t generated_frames = 50;
+    float density = 3;
+    uint32_t player_count = 40;
+    uint32_t seed = 1;
+    float cell_size = 0;
+    int opt;
+    while ((opt = getopt(argc, argv, "r:f:d:p:s:c:")) != -1)
+    {
+        switch (opt)
+        {
+        case 'r':
+            record = optarg;
+            break;
+        case 'f':
+            generated_frames = atoi(optarg);
+            break;
+        case 'd':
+            density = atof(optarg);
+            break;
+        case 'p':
+            player_count = atoi(optarg);
+            break;
+        case 's':
+            seed = atoi(optarg);
+            break;
+        case 'c':
+            cell_size = atof(optarg);
+            break;
+        default:
+            fprintf(stderr,
+                    "usage: %s [-r record] [-f frames] [-d mobs per grid] "
+                    "[-p players] [-s seed] [-c cell size]\n",
+                    argv[0]);
+            return 1;
+        }
+    }
+    rr_srand(seed);
+    rr_static_data_init();
+    if (record != NULL)
+        read_record(record);
+    else
+        generate_frames(generated_frames, density, player_count);
+    if (frame_count == 0)
+    {
+        fputs("no frames to replay\n", stderr);
+        return 1;
+    }
+    uint64_t entity_count = 0;
+    for (uint32_t f = 0; f < frame_count; ++f)
+        entity_count += frames[f].count;
+    printf("%u frames, %.1f entities per frame\n", frame_count,
+           (double)entity_count / frame_count);
+
+    float cell_sizes[] = {128, 256, 512, 1024, 2048};
+    uint32_t cell_size_count = sizeof cell_sizes / sizeof cell_sizes[0];
+    if (cell_size > 0)
+    {
+        cell_sizes[0] = cell_size;
+        cell_size_count = 1;
+    }
+    printf("%9s %10s %10s %10s %10s %12s %10s %12s\n", "cell", "build us",
+           "broad us", "batched us", "query us", "candidates", "overlaps",
+           "query cands");
+    for (uint32_t i = 0; i < cell_size_count; ++i)
+    {
+        struct bench_result result;
+        run(cell_sizes[i], &result);
+        if (result.batched_overlaps != result.overlaps)
+            fprintf(stderr, "batched narrowphase found %lu overlaps, %lu "
+                            "expected\n",
+                    result.batched_overlaps, result.overlaps);
+        printf("%9.0f %10.1f %10.1f %10.1f %10.1f %12.0f %10.0f %12.0f\n",
+               cell_sizes[i], result.build / frame_count,
+               result.broadphase / frame_count, result.batched / frame_count,
+               result.query / frame_count,
+               (double)result.candidates / frame_count,
+               (double)result.overlaps / frame_count,
+               (double)result.query_candidates / frame_count);
+    }
+    return 0;
+}
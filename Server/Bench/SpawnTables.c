@@ -0,0 +1,168 @@
+// Copyright (C) 2024 Paul Johnson
+// Copyright (C) 2024-2025 Maxim Nesterov
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as
+// published by the Free Software Foundation, either version 3 of the
+// License, or (at your option) any later version.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Affero General Public License for more details.
+
+// You should have received a copy of the GNU Affero General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+
+// Checks that the table driven get_spawn_id and get_spawn_rarity follow the
+// distributions of the closed forms they replace. Every biome's mob ids and
+// the rarities of every distinct HELL_CREEK difficulty are sampled and put
+// through a chi-squared goodness of fit test. Exits with 1 when any of them
+// is off at the 0.1% level.
+//
+// usage: rrolf-spawn-check [-n samples] [-s seed]
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <Server/Waves.h>
+#include <Shared/StaticData.h>
+#include <Shared/Utilities.h>
+
+// Wilson-Hilferty approximation of the chi-squared quantile
+static double chi_squared_critical(uint32_t degrees)
+{
+    double const z = 3.090; // 99.9th percentile of the normal distribution
+    double h = 2.0 / (9 * degrees);
+    return degrees * pow(1 - h + z * sqrt(h), 3);
+}
+
+// Returns 1 if the counts pass, bins expected to hold fewer than 5 samples
+// are merged into one as the test requires
+static uint8_t check(char const *name, uint64_t *counts, double *expected,
+                     uint32_t bin_count, uint64_t samples)
+{
+    double statistic = 0;
+    double merged_expected = 0;
+    uint64_t merged_count = 0;
+    uint32_t degrees = 0;
+    for (uint32_t i = 0; i < bin_count; ++i)
+    {
+        double e = expected[i] * samples;
+        if (e < 5)
+        {
+            if (counts[i] > 0 && expected[i] == 0)
+            {
+                printf("%-24s FAIL: %lu samples in an impossible bin\n", name,
+                       counts[i]);
+                return 0;
+            }
+            merged_expected += e;
+            merged_count += counts[i];
+            continue;
+        }
+        statistic += (counts[i] - e) * (counts[i] - e) / e;
+        ++degrees;
+    }
+    if (merged_expected >= 5)
+    {
+        statistic += (merged_count - merged_expected) *
+                     (merged_count - merged_expected) / merged_expected;
+        ++degrees;
+    }
+    if (degrees < 2)
+    {
+        printf("%-24s ok: single outcome\n", name);
+        return 1;
+    }
+    double critical = chi_squared_critical(degrees - 1);
+    printf("%-24s %s: chi2 %.2f, %u degrees, critical %.2f\n", name,
+           statistic <= critical ? "ok" : "FAIL", statistic, degrees - 1,
+           critical);
+    return statistic <= critical;
+}
+
+static uint8_t check_ids(uint8_t biome, uint64_t samples)
+{
+    double *table = biome == 0 ? RR_HELL_CREEK_MOB_ID_RARITY_COEFFICIENTS
+                               : RR_GARDEN_MOB_ID_RARITY_COEFFICIENTS;
+    double expected[rr_mob_id_max];
+    uint64_t counts[rr_mob_id_max] = {0};
+    for (uint8_t id = 0; id < rr_mob_id_max; ++id)
+        expected[id] = table[id] - (id == 0 ? 0 : table[id - 1]);
+    for (uint64_t i = 0; i < samples; ++i)
+        ++counts[get_spawn_id(biome, NULL)];
+    char name[32];
+    snprintf(name, sizeof name, "ids of biome %u", biome);
+    return check(name, counts, expected, rr_mob_id_max, samples);
+}
+
+static uint8_t check_rarities(struct rr_maze_grid *grid, uint64_t samples)
+{
+    double expected[rr_rarity_id_max] = {0};
+    uint64_t counts[rr_rarity_id_max] = {0};
+    // the closed form get_spawn_rarity used to evaluate on every spawn
+    float difficulty = grid->difficulty < 1 ? 1 : grid->difficulty;
+    uint32_t rarity_cap = rr_rarity_id_common + (difficulty + 7) / 8;
+    if (rarity_cap > rr_rarity_id_ultimate)
+        rarity_cap = rr_rarity_id_ultimate;
+    double below = 0;
+    for (uint32_t rarity = rarity_cap >= 2 ? rarity_cap - 2 : 0;
+         rarity < rarity_cap; ++rarity)
+    {
+        double threshold =
+            pow(1 - (1 - RR_MOB_WAVE_RARITY_COEFFICIENTS[rarity + 1]) * 0.3,
+                pow(1.5, difficulty));
+        expected[rarity] = threshold - below;
+        below = threshold;
+    }
+    expected[rarity_cap] = 1 - below;
+    for (uint64_t i = 0; i < samples; ++i)
+        ++counts[get_spawn_rarity(grid)];
+    char name[32];
+    snprintf(name, sizeof name, "rarities at %.0f", grid->difficulty);
+    return check(name, counts, expected, rr_rarity_id_max, samples);
+}
+
+int main(int argc, char **argv)
+{
+    uint64_t samples = 1000000;
+    uint32_t seed = 0;
+    int opt;
+    while ((opt = getopt(argc, argv, "n:s:")) != -1)
+    {
+        switch (opt)
+        {
+        case 'n':
+            samples = atoll(optarg);
+            break;
+        case 's':
+            seed = atoi(optarg);
+            break;
+        default:
+            fprintf(stderr, "usage: %s [-n samples] [-s seed]\n", argv[0]);
+            return 1;
+        }
+    }
+    rr_srand(seed);
+    rr_static_data_init();
+    rr_waves_init();
+    uint8_t passed = 1;
+    for (uint8_t biome = 0; biome < rr_biome_id_max; ++biome)
+        passed &= check_ids(biome, samples);
+    struct rr_maze_declaration *maze = &RR_MAZES[rr_biome_id_hell_creek];
+    uint8_t seen[256] = {0};
+    for (uint32_t i = 0; i < maze->maze_dim * maze->maze_dim; ++i)
+    {
+        struct rr_maze_grid *grid = &maze->maze[i];
+        if (grid->value == 0 || seen[(uint8_t)grid->difficulty])
+            continue;
+        seen[(uint8_t)grid->difficulty] = 1;
+        passed &= check_rarities(grid, samples);
+    }
+    return !passed;
+}
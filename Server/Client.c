@@ -16,7 +16,7 @@
 
 #include <Server/Client.h>
 
-#include <libwebsockets.h>
+#include <assert.h>
 #include <math.h>
 #include <pthread.h>
 #include <stdio.h>
@@ -48,6 +48,61 @@ void rr_server_client_init(struct rr_server_client *this)
     this->dev_cheats.fov_percent = 1;
 }
 
+#define BLOCKED_SLOT_MASK (RR_MAX_CLIENT_COUNT * 2 - 1)
+
+static uint32_t blocked_slot(struct rr_server_client *this, uint32_t uuid)
+{
+    uint32_t slot = (uuid * 2654435761u) & BLOCKED_SLOT_MASK;
+    while (this->blocked_clients[slot] != 0 &&
+           this->blocked_clients[slot] != uuid)
+        slot = (slot + 1) & BLOCKED_SLOT_MASK;
+    return slot;
+}
+
+uint8_t rr_server_client_is_blocked(struct rr_server_client *this,
+                                    uint32_t uuid)
+{
+    if (uuid == 0)
+        return 0;
+    return this->blocked_clients[blocked_slot(this, uuid)] == uuid;
+}
+
+void rr_server_client_toggle_blocked(struct rr_server_client *this,
+                                     uint32_t uuid)
+{
+    if (uuid == 0)
+        return;
+    uint32_t slot = blocked_slot(this, uuid);
+    if (this->blocked_clients[slot] == 0)
+    {
+        // same cap as the old fixed list, keeps the set at most half full
+        if (this->blocked_client_count < RR_MAX_CLIENT_COUNT)
+        {
+            this->blocked_clients[slot] = uuid;
+            ++this->blocked_client_count;
+        }
+        return;
+    }
+    // backward shift deletion so lookups never need tombstones
+    this->blocked_clients[slot] = 0;
+    --this->blocked_client_count;
+    for (uint32_t next = (slot + 1) & BLOCKED_SLOT_MASK;
+         this->blocked_clients[next] != 0;
+         next = (next + 1) & BLOCKED_SLOT_MASK)
+    {
+        uint32_t home =
+            (this->blocked_clients[next] * 2654435761u) & BLOCKED_SLOT_MASK;
+        // move the entry back if its home is not in (slot, next]
+        if (((next - home) & BLOCKED_SLOT_MASK) >=
+            ((next - slot) & BLOCKED_SLOT_MASK))
+        {
+            this->blocked_clients[slot] = this->blocked_clients[next];
+            this->blocked_clients[next] = 0;
+            slot = next;
+        }
+    }
+}
+
 void rr_server_client_create_flower(struct rr_server_client *this)
 {
     if (this->player_info == NULL)
@@ -90,38 +145,78 @@ void rr_server_client_create_flower(struct rr_server_client *this)
         rr_binary_encoder_write_uint8(&encoder, slot->rarity);
     }
     rr_binary_encoder_write_uint8(&encoder, 0);
-    lws_write(this->server->api_client, encoder.start,
-              encoder.at - encoder.start, LWS_WRITE_BINARY);
+    rr_server_write_to_api(this->server, encoder.start,
+                           encoder.at - encoder.start);
 }
 
-void rr_server_client_write_message(struct rr_server_client *this,
-                                    uint8_t *data, uint64_t size)
+uint8_t *rr_server_client_begin_message(struct rr_server_client *this,
+                                        uint64_t reserve)
 {
-    if (this->message_length++ >= 512)
-    {
-        this->pending_kick = 1;
-        lws_callback_on_writable(this->socket_handle);
-        return;
-    }
+    assert(this->message_queue != NULL);
+    if (RR_MESSAGE_QUEUE_SIZE - this->message_queue_size <
+        RR_MESSAGE_ALIGN(RR_MESSAGE_HEADER_SIZE + reserve))
+        return NULL;
+    return this->message_queue + this->message_queue_size +
+           RR_MESSAGE_HEADER_SIZE;
+}
+
+void rr_server_client_end_message(struct rr_server_client *this,
+                                  uint64_t size)
+{
+    uint8_t *header = this->message_queue + this->message_queue_size;
+    struct proto_bug reader;
+    proto_bug_init(&reader, header + RR_MESSAGE_HEADER_SIZE);
+    uint8_t packet_header = proto_bug_read_uint8(&reader, "header");
+    if (packet_header < rr_clientbound_max)
+        this->net_stats.header_bytes[packet_header] += size;
     if (this->received_first_packet)
     {
         this->clientbound_encryption_key =
             rr_get_hash(this->clientbound_encryption_key);
-        rr_encrypt(data, size, this->clientbound_encryption_key);
+        rr_encrypt(header + RR_MESSAGE_HEADER_SIZE, size,
+                   this->clientbound_encryption_key);
     }
-    struct rr_server_client_message *message = malloc(sizeof *message);
-    uint8_t *packet = malloc(LWS_PRE + size);
-    memcpy(packet + LWS_PRE, data, size);
-    message->next = NULL;
-    message->len = size;
-    message->packet = packet;
-    if (this->message_root == NULL)
-        this->message_root = message;
+    memcpy(header, &size, sizeof size);
+    this->message_queue_size +=
+        RR_MESSAGE_ALIGN(RR_MESSAGE_HEADER_SIZE + size);
+}
+
+void rr_server_client_acquire_messages(struct rr_server_client *this)
+{
+    if (this->message_queue != NULL)
+        return;
+    struct rr_server *server = this->server;
+    if (server->free_message_queue_count > 0)
+        this->message_queue =
+            server->free_message_queues[--server->free_message_queue_count];
     else
-        this->message_at->next = message;
-    this->message_at = message;
-    lws_callback_on_writable(this->socket_handle);
-    // lws_write(this->socket_handle, data, size, LWS_WRITE_BINARY);
+        this->message_queue = malloc(RR_MESSAGE_QUEUE_SIZE);
+    assert(this->message_queue);
+    this->message_queue_size = 0;
+}
+
+void rr_server_client_write_message(struct rr_server_client *this,
+                                    uint8_t *data, uint64_t size)
+{
+    rr_server_client_acquire_messages(this);
+    uint8_t *message = rr_server_client_begin_message(this, size);
+    if (message == NULL)
+    {
+        // the network thread could not keep up with this client
+        this->pending_kick = 1;
+        return;
+    }
+    memcpy(message, data, size);
+    rr_server_client_end_message(this, size);
+}
+
+void rr_server_client_release_messages(struct rr_server_client *this)
+{
+    if (this->message_queue == NULL)
+        return;
+    rr_server_release_message_queue(this->server, this->message_queue);
+    this->message_queue = NULL;
+    this->message_queue_size = 0;
 }
 
 void rr_server_client_write_account(struct rr_server_client *client)
@@ -196,18 +291,28 @@ void rr_server_client_craft_petal(struct rr_server_client *this,
     uint32_t last_fails = this->craft_fails[id][rarity];
     double base = RR_CRAFT_CHANCES[rarity];
     double xp_gain = 0;
+    // every attempt takes two rolls: whether it succeeds and how many petals
+    // a failure burns
+    float rolls[128];
+    uint32_t roll = sizeof rolls / sizeof *rolls;
     while (now >= 5)
     {
+        if (roll == sizeof rolls / sizeof *rolls)
+        {
+            rr_frand_n(rolls, roll);
+            roll = 0;
+        }
         last_fails = this->craft_fails[id][rarity];
         if (id == rr_petal_id_basic ||
-            rr_frand() < base * (++this->craft_fails[id][rarity]))
+            rolls[roll] < base * (++this->craft_fails[id][rarity]))
         {
             ++success;
             this->craft_fails[id][rarity] = 0;
             now -= 5;
         }
         else
-            now -= 1 + rand() % 4;
+            now -= 1 + (uint32_t)(rolls[roll + 1] * 4);
+        roll += 2;
         xp_gain += CRAFT_XP_GAINS[rarity];
     }
     if (success > 0)
@@ -357,6 +462,106 @@ void rr_server_client_write_to_api(struct rr_server_client *this)
                                             this->mob_gallery[id][rarity]);
         }
     rr_binary_encoder_write_uint8(&encoder, 0);
-    lws_write(this->server->api_client, encoder.start,
-              encoder.at - encoder.start, LWS_WRITE_BINARY);
-}
\ No newline at end of file
+    rr_server_write_to_api(this->server, encoder.start,
+                           encoder.at - encoder.start);
+}
+void rr_server_client_change_inventory(struct rr_server_client *this,
+                                       uint8_t id, uint8_t rarity)
+{
+    rr_bitset_set(this->changed_inventory, id * rr_rarity_id_max + rarity);
+    this->account_changed = 1;
+}
+
+void rr_server_client_change_mob_gallery(struct rr_server_client *this,
+                                         uint8_t id, uint8_t rarity)
+{
+    rr_bitset_set(this->changed_mob_gallery, id * rr_rarity_id_max + rarity);
+    this->account_changed = 1;
+}
+
+static uint32_t collect_changes(uint8_t const *bits, uint32_t size,
+                                uint16_t *changes)
+{
+    uint32_t count = 0;
+    for (uint32_t byte = 0; byte < size; ++byte)
+        for (uint32_t set = bits[byte]; set != 0; set &= set - 1)
+            changes[count++] = byte * 8 + __builtin_ctz(set);
+    return count;
+}
+
+void rr_server_client_sync_account(struct rr_server_client *this)
+{
+    uint16_t inventory[rr_petal_id_max * rr_rarity_id_max];
+    uint16_t mob_gallery[rr_mob_id_max * rr_rarity_id_max];
+    uint32_t inventory_count = collect_changes(
+        this->changed_inventory, sizeof this->changed_inventory, inventory);
+    uint32_t mob_gallery_count =
+        collect_changes(this->changed_mob_gallery,
+                        sizeof this->changed_mob_gallery, mob_gallery);
+    if (!this->dev)
+    {
+        struct rr_binary_encoder encoder;
+        rr_binary_encoder_init(&encoder, outgoing_message);
+        rr_binary_encoder_write_uint8(&encoder, 4);
+        rr_binary_encoder_write_nt_string(&encoder, this->rivet_account.uuid);
+        rr_binary_encoder_write_float64(&encoder, this->experience);
+        for (uint32_t i = 0; i < inventory_count; ++i)
+        {
+            uint8_t id = inventory[i] / rr_rarity_id_max;
+            uint8_t rarity = inventory[i] % rr_rarity_id_max;
+            rr_binary_encoder_write_uint8(&encoder, id);
+            rr_binary_encoder_write_uint8(&encoder, rarity);
+            rr_binary_encoder_write_varuint(&encoder,
+                                            this->inventory[id][rarity]);
+        }
+        rr_binary_encoder_write_uint8(&encoder, 0);
+        for (uint32_t i = 0; i < mob_gallery_count; ++i)
+        {
+            uint8_t id = mob_gallery[i] / rr_rarity_id_max;
+            uint8_t rarity = mob_gallery[i] % rr_rarity_id_max;
+            rr_binary_encoder_write_uint8(&encoder, id + 1);
+            rr_binary_encoder_write_uint8(&encoder, rarity);
+            rr_binary_encoder_write_varuint(&encoder,
+                                            this->mob_gallery[id][rarity]);
+        }
+        rr_binary_encoder_write_uint8(&encoder, 0);
+        rr_server_write_to_api(this->server, encoder.start,
+                               encoder.at - encoder.start);
+    }
+    if (!this->disconnected)
+    {
+        struct proto_bug encoder;
+        proto_bug_init(&encoder, outgoing_message);
+        proto_bug_write_uint8(&encoder, rr_clientbound_account_delta,
+                              "header");
+        proto_bug_write_float64(&encoder, this->experience, "xp");
+        for (uint32_t i = 0; i < inventory_count; ++i)
+        {
+            uint8_t id = inventory[i] / rr_rarity_id_max;
+            uint8_t rarity = inventory[i] % rr_rarity_id_max;
+            proto_bug_write_uint8(&encoder, id, "id");
+            proto_bug_write_uint8(&encoder, rarity, "rarity");
+            proto_bug_write_varuint(&encoder, this->inventory[id][rarity],
+                                    "count");
+        }
+        proto_bug_write_uint8(&encoder, 0, "id");
+        for (uint32_t i = 0; i < mob_gallery_count; ++i)
+        {
+            uint8_t id = mob_gallery[i] / rr_rarity_id_max;
+            uint8_t rarity = mob_gallery[i] % rr_rarity_id_max;
+            proto_bug_write_uint8(&encoder, id + 1, "id");
+            proto_bug_write_uint8(&encoder, rarity, "rarity");
+            proto_bug_write_varuint(&encoder, this->mob_gallery[id][rarity],
+                                    "count");
+        }
+        proto_bug_write_uint8(&encoder, 0, "id");
+        rr_server_client_write_message(this, encoder.start,
+                                       encoder.current - encoder.start);
+    }
+    memset(this->changed_inventory, 0, sizeof this->changed_inventory);
+    memset(this->changed_mob_gallery, 0, sizeof this->changed_mob_gallery);
+    this->account_changed = 0;
+    this->ticks_to_account_sync = RR_ACCOUNT_SYNC_TICKS;
+    if (this->ticks_to_account_checkpoint == 0)
+        this->ticks_to_account_checkpoint = RR_ACCOUNT_CHECKPOINT_TICKS;
+}
@@ -18,6 +18,7 @@
 
 #include <stdint.h>
 
+#include <Server/Profiler.h>
 #include <Shared/Bitset.h>
 #include <Shared/Rivet.h>
 #include <Shared/StaticData.h>
@@ -33,13 +34,6 @@
 
 struct rr_binary_encoder;
 
-struct rr_server_client_message
-{
-    struct rr_server_client_message *next;
-    uint64_t len;
-    uint8_t *packet;
-};
-
 struct rr_server_client_dev_cheats
 {
     uint8_t invisible : 1;
@@ -52,21 +46,41 @@ struct rr_server_client_dev_cheats
     float fov_percent;
 };
 
+// pickups and kills are gathered for this long before they are synced
+#define RR_ACCOUNT_SYNC_TICKS (25)
+// the whole account goes to the api this long after the first sync since
+// the last time it did, in case a sync was lost
+#define RR_ACCOUNT_CHECKPOINT_TICKS (25 * 60)
+
+// what a client cost since the last rr_server_dump_net_stats. only written
+// by the tick thread or the encode job of the client
+struct rr_server_client_net_stats
+{
+    uint64_t header_bytes[rr_clientbound_max];
+    uint64_t component_bytes[RR_NET_STATS_COMPONENT_SLOTS];
+    uint64_t encode_nanoseconds;
+};
+
 struct rr_server_client
 {
     struct rr_rivet_account rivet_account;
+    uint32_t uuid; // rivet_account.uuid interned by the server
     uint64_t clientbound_encryption_key;
     uint64_t serverbound_encryption_key;
     uint64_t requested_verification;
     uint8_t quick_verification;
     uint16_t nonce;
-    uint64_t message_length;
     struct rr_server *server;
-    struct lws *socket_handle;
-    struct rr_server_client_message *message_root;
-    struct rr_server_client_message *message_at;
+    // id of the socket on the network thread, 0 once it closed
+    uint32_t socket;
+    // packets of this tick, laid out as RR_MESSAGE_HEADER_SIZE describes.
+    // the whole queue is handed to the network thread at the end of the
+    // tick and the next one starts out empty
+    uint8_t *message_queue;
+    uint64_t message_queue_size;
     struct rr_component_player_info *player_info;
     struct rr_server_client_dev_cheats dev_cheats;
+    struct rr_server_client_net_stats net_stats;
     double experience;
     float player_accel_x;
     float player_accel_y;
@@ -76,12 +90,33 @@ struct rr_server_client
     uint32_t inventory[rr_petal_id_max][rr_rarity_id_max];
     uint32_t craft_fails[rr_petal_id_max][rr_rarity_id_max];
     uint32_t mob_gallery[rr_mob_id_max][rr_rarity_id_max];
+    // entries changed since the last rr_server_client_sync_account, bit
+    // id * rr_rarity_id_max + rarity
+    uint8_t changed_inventory[RR_BITSET_ROUND(rr_petal_id_max *
+                                              rr_rarity_id_max)];
+    uint8_t changed_mob_gallery[RR_BITSET_ROUND(rr_mob_id_max *
+                                                rr_rarity_id_max)];
+    uint32_t ticks_to_account_sync;
+    uint32_t ticks_to_account_checkpoint;
     uint32_t ticks_to_next_squad_action;
     uint32_t ticks_to_next_kick_vote;
     uint32_t disconnected_ticks;
     uint32_t afk_ticks;
     uint8_t joined_squad_before[RR_BITSET_ROUND(RR_SQUAD_COUNT)];
-    char blocked_clients[RR_MAX_CLIENT_COUNT][37];
+    // open addressed set of interned uuids, 0 is an empty slot
+    uint32_t blocked_clients[RR_MAX_CLIENT_COUNT * 2];
+    uint8_t blocked_client_count;
+    // squad dump state last sent to the client, see
+    // rr_server_client_encode_squad_dump
+    uint8_t blocked_squad_members[RR_BITSET_ROUND(RR_SQUAD_COUNT *
+                                                  RR_SQUAD_MEMBER_COUNT)];
+    uint64_t squad_dump_patch_hash;
+    uint32_t squad_dump_version;
+#ifndef NDEBUG
+    // set once this tick's update is encoded, checked and cleared by
+    // rr_server_check_wire_baselines
+    uint8_t update_encoded;
+#endif
     uint8_t squad_pos;
     uint8_t squad;
     uint8_t checkpoint;
@@ -93,17 +128,36 @@ struct rr_server_client
     uint8_t in_use : 1;
     uint8_t pending_quick_join : 1;
     uint8_t disconnected : 1;
+    uint8_t blocked_clients_changed : 1;
+    uint8_t account_changed : 1;
 };
 
 void rr_server_client_init(struct rr_server_client *);
 void rr_server_client_create_flower(struct rr_server_client *);
+uint8_t rr_server_client_is_blocked(struct rr_server_client *, uint32_t);
+void rr_server_client_toggle_blocked(struct rr_server_client *, uint32_t);
 
 void rr_server_client_write_message(struct rr_server_client *, uint8_t *,
                                     uint64_t);
+// Returns where the payload of the next packet goes if at least the given
+// number of bytes are free, NULL otherwise. The packet is only queued by
+// rr_server_client_end_message. Needs the message queue to be acquired, the
+// encode workers may then use it for the client they encode.
+uint8_t *rr_server_client_begin_message(struct rr_server_client *, uint64_t);
+void rr_server_client_end_message(struct rr_server_client *, uint64_t);
+void rr_server_client_acquire_messages(struct rr_server_client *);
+void rr_server_client_release_messages(struct rr_server_client *);
 void rr_server_client_write_account(struct rr_server_client *);
 void rr_server_client_write_oauth2_data(struct rr_server_client *);
 void rr_server_client_craft_petal(struct rr_server_client *, struct rr_server *,
                                   uint8_t, uint8_t, uint32_t);
 int rr_server_client_read_from_api(struct rr_server_client *,
                                    struct rr_binary_encoder *);
-void rr_server_client_write_to_api(struct rr_server_client *);
\ No newline at end of file
+void rr_server_client_write_to_api(struct rr_server_client *);
+void rr_server_client_change_inventory(struct rr_server_client *, uint8_t,
+                                       uint8_t);
+void rr_server_client_change_mob_gallery(struct rr_server_client *, uint8_t,
+                                         uint8_t);
+// Sends the changed entries and the xp to the api and, unless it is gone,
+// the client. Counts are absolute, so an entry sent twice does no harm.
+void rr_server_client_sync_account(struct rr_server_client *);
\ No newline at end of file
@@ -57,7 +57,7 @@ EntityIdx rr_simulation_alloc_player(struct rr_simulation *this,
         physical, respawn_zone->y + 2 * arena->maze->grid_size * rr_frand());
     rr_component_physical_set_radius(physical, 25.0f);
     physical->mass = 10;
-    physical->arena = arena_id;
+    rr_component_physical_set_arena(physical, arena_id);
     physical->friction = 0.75;
     if (player_info->client->dev)
         rr_component_physical_set_angle(physical, M_PI);
@@ -107,7 +107,7 @@ EntityIdx rr_simulation_alloc_petal(struct rr_simulation *this, EntityIdx arena,
     rr_component_physical_set_angle(physical, rr_frand() * M_PI * 2);
     rr_component_physical_set_x(physical, x);
     rr_component_physical_set_y(physical, y);
-    physical->arena = arena;
+    rr_component_physical_set_arena(physical, arena);
     physical->mass = 5;
     physical->friction = 0.75;
     float scale_h = data->scale[rarity].health;
@@ -171,7 +171,7 @@ static EntityIdx rr_simulation_alloc_mob_non_recursive(
     rr_component_physical_set_angle(physical, rr_frand() * 2 * M_PI);
     rr_component_physical_set_x(physical, x);
     rr_component_physical_set_y(physical, y);
-    physical->arena = arena_id;
+    rr_component_physical_set_arena(physical, arena_id);
     physical->friction = 0.75;
     physical->mass = 25.0f * powf(6, RR_MOB_RARITY_SCALING[rarity_id].radius);
     rr_component_health_set_max_health(health,
@@ -217,7 +217,7 @@ EntityIdx rr_simulation_alloc_mob(struct rr_simulation *this,
     rr_component_physical_set_angle(physical, rr_frand() * 2 * M_PI);
     rr_component_physical_set_x(physical, x);
     rr_component_physical_set_y(physical, y);
-    physical->arena = arena_id;
+    rr_component_physical_set_arena(physical, arena_id);
     physical->friction = 0.75;
     physical->mass = 25.0f * powf(6, RR_MOB_RARITY_SCALING[rarity_id].radius);
     physical->slow_resist = rr_fclamp(0.075 * powf(1.6, rarity_scale->radius) - 0.075, 0, 1);
@@ -302,20 +302,15 @@ EntityIdx rr_simulation_alloc_mob(struct rr_simulation *this,
 
 EntityIdx rr_simulation_alloc_entity(struct rr_simulation *this)
 {
-    for (EntityIdx i = 1; i < RR_MAX_ENTITY_COUNT; i++)
-    {
-        if (!rr_simulation_has_entity(this, i))
-        {
-            if (rr_bitset_get_bit(this->deleted_last_tick, i))
-                continue;
-            this->entity_tracker[i] = 1;
-            ++this->entity_hash_tracker[i];
+    // ids deleted last tick only reach the free list at the end of this one,
+    // see rr_simulation_tick
+    EntityIdx i = __rr_simulation_take_free_entity(this);
+    if (i == RR_NULL_ENTITY)
+        RR_UNREACHABLE("ran out of entity ids");
+    this->entity_tracker[i] = 1;
+    ++this->entity_hash_tracker[i];
 #ifndef NDEBUG
-            printf("<rr_simulation::entity_create::%d>\n", i);
+    printf("<rr_simulation::entity_create::%d>\n", i);
 #endif
-            return i;
-        }
-    }
-
-    RR_UNREACHABLE("ran out of entity ids");
+    return i;
 }
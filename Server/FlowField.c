@@ -0,0 +1,218 @@
+// Copyright (C) 2024 Paul Johnson
+// Copyright (C) 2024-2025 Maxim Nesterov
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as
+// published by the Free Software Foundation, either version 3 of the
+// License, or (at your option) any later version.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Affero General Public License for more details.
+
+// You should have received a copy of the GNU Affero General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+
+#include <Server/FlowField.h>
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <Shared/Utilities.h>
+
+static int8_t const neighbour_offsets[8][2] = {
+    {1, 0}, {-1, 0}, {0, 1}, {0, -1}, {1, 1}, {1, -1}, {-1, 1}, {-1, -1}};
+
+// Curved grids, bit 2 of value, are only open on the two sides next to the
+// corner their curve is centred on. Inverse ones, bit 3, round off the inner
+// corners of walls: they are mostly wall with their middle inside it, open
+// only on the other two sides, and are never stepped into
+static uint8_t is_walkable(struct rr_flow_field *this, int32_t x, int32_t y)
+{
+    int32_t dim = this->maze->maze_dim;
+    if (x < 0 || y < 0 || x >= dim || y >= dim)
+        return 0;
+    uint8_t value = this->maze->maze[y * dim + x].value;
+    return value != 0 && (value & 8) == 0;
+}
+
+// whether the grid is open on the side towards dx, dy, one of which is 0
+static uint8_t is_open_towards(struct rr_flow_field *this, int32_t x,
+                               int32_t y, int32_t dx, int32_t dy)
+{
+    uint8_t value = this->maze->maze[y * this->maze->maze_dim + x].value;
+    if (value <= 1)
+        return value;
+    int32_t left = (value & 2) ? 1 : -1;
+    int32_t top = (value & 1) ? 1 : -1;
+    if (value & 8)
+    {
+        left = -left;
+        top = -top;
+    }
+    return dx == left || dy == top;
+}
+
+static uint8_t can_step_straight(struct rr_flow_field *this, int32_t x,
+                                 int32_t y, int32_t dx, int32_t dy)
+{
+    return is_walkable(this, x + dx, y + dy) &&
+           is_open_towards(this, x, y, dx, dy) &&
+           is_open_towards(this, x + dx, y + dy, -dx, -dy);
+}
+
+static uint8_t can_step(struct rr_flow_field *this, int32_t x, int32_t y,
+                        int8_t const offset[2])
+{
+    int32_t dx = offset[0];
+    int32_t dy = offset[1];
+    if (dx == 0 || dy == 0)
+        return can_step_straight(this, x, y, dx, dy);
+    // both ways around the corner have to be open
+    return can_step_straight(this, x, y, dx, 0) &&
+           can_step_straight(this, x + dx, y, 0, dy) &&
+           can_step_straight(this, x, y, 0, dy) &&
+           can_step_straight(this, x, y + dy, dx, 0);
+}
+
+static uint32_t position_to_grid(struct rr_flow_field *this, float x, float y)
+{
+    uint32_t dim = this->maze->maze_dim;
+    uint32_t grid_x = rr_fclamp(x / this->maze->grid_size, 0, dim - 1);
+    uint32_t grid_y = rr_fclamp(y / this->maze->grid_size, 0, dim - 1);
+    return grid_y * dim + grid_x;
+}
+
+static void flow_field_reset(struct rr_flow_field *this)
+{
+    for (uint32_t i = 0; i < this->visited_count; ++i)
+        this->distance[this->visited[i]] = RR_FLOW_FIELD_UNREACHABLE;
+    this->visited_count = 0;
+}
+
+static void flow_field_add_goal(struct rr_flow_field *this, uint32_t grid)
+{
+    this->distance[grid] = 0;
+    this->visited[this->visited_count++] = grid;
+}
+
+static void flow_field_search(struct rr_flow_field *this,
+                              uint16_t max_distance)
+{
+    uint32_t dim = this->maze->maze_dim;
+    for (uint32_t i = 0; i < this->visited_count; ++i)
+    {
+        uint32_t grid = this->visited[i];
+        uint16_t next = this->distance[grid] + 1;
+        if (next > max_distance)
+            continue;
+        int32_t x = grid % dim;
+        int32_t y = grid / dim;
+        for (uint8_t n = 0; n < 8; ++n)
+        {
+            if (!can_step(this, x, y, neighbour_offsets[n]))
+                continue;
+            uint32_t neighbour = (y + neighbour_offsets[n][1]) * dim + x +
+                                 neighbour_offsets[n][0];
+            if (this->distance[neighbour] != RR_FLOW_FIELD_UNREACHABLE)
+                continue;
+            this->distance[neighbour] = next;
+            this->visited[this->visited_count++] = neighbour;
+        }
+    }
+}
+
+void rr_flow_field_init(struct rr_flow_field *this,
+                        struct rr_maze_declaration *maze)
+{
+    uint32_t grid_count = maze->maze_dim * maze->maze_dim;
+    memset(this, 0, sizeof *this);
+    this->maze = maze;
+    this->goal = UINT32_MAX;
+    this->distance = malloc(grid_count * sizeof *this->distance);
+    memset(this->distance, 0xff, grid_count * sizeof *this->distance);
+    this->visited = malloc(grid_count * sizeof *this->visited);
+}
+
+void rr_flow_field_free(struct rr_flow_field *this)
+{
+    free(this->distance);
+    free(this->visited);
+    memset(this, 0, sizeof *this);
+}
+
+void rr_flow_field_build_difficulty(struct rr_flow_field *this,
+                                    float difficulty)
+{
+    flow_field_reset(this);
+    this->goal = UINT32_MAX;
+    uint32_t dim = this->maze->maze_dim;
+    for (uint32_t grid = 0; grid < dim * dim; ++grid)
+        if (this->maze->maze[grid].value != 0 &&
+            this->maze->maze[grid].difficulty >= difficulty)
+            flow_field_add_goal(this, grid);
+    flow_field_search(this, RR_FLOW_FIELD_UNREACHABLE - 1);
+}
+
+void rr_flow_field_build_position(struct rr_flow_field *this, float x, float y,
+                                  uint16_t max_distance)
+{
+    uint32_t grid = position_to_grid(this, x, y);
+    if (grid == this->goal)
+        return;
+    flow_field_reset(this);
+    this->goal = grid;
+    if (this->maze->maze[grid].value == 0)
+        return;
+    flow_field_add_goal(this, grid);
+    flow_field_search(this, max_distance);
+}
+
+uint16_t rr_flow_field_get_distance(struct rr_flow_field *this, float x,
+                                   float y)
+{
+    if (this->distance == NULL)
+        return RR_FLOW_FIELD_UNREACHABLE;
+    return this->distance[position_to_grid(this, x, y)];
+}
+
+uint8_t rr_flow_field_get_direction(struct rr_flow_field *this, float x,
+                                    float y, struct rr_vector *direction)
+{
+    if (this->distance == NULL)
+        return 0;
+    uint32_t dim = this->maze->maze_dim;
+    uint32_t grid = position_to_grid(this, x, y);
+    uint16_t best = this->distance[grid];
+    // the open corner of an inverse grid is left through its open sides
+    // like any other grid, it just has no distance of its own
+    if (best == 0 || (best == RR_FLOW_FIELD_UNREACHABLE &&
+                      (this->maze->maze[grid].value & 8) == 0))
+        return 0;
+    int32_t grid_x = grid % dim;
+    int32_t grid_y = grid / dim;
+    int8_t const *step = NULL;
+    for (uint8_t n = 0; n < 8; ++n)
+    {
+        if (!can_step(this, grid_x, grid_y, neighbour_offsets[n]))
+            continue;
+        uint16_t distance =
+            this->distance[(grid_y + neighbour_offsets[n][1]) * dim + grid_x +
+                           neighbour_offsets[n][0]];
+        if (distance >= best)
+            continue;
+        best = distance;
+        step = neighbour_offsets[n];
+    }
+    if (step == NULL)
+        return 0;
+    // aim for the middle of the next grid so curved walls are not clipped
+    float grid_size = this->maze->grid_size;
+    struct rr_vector delta = {(grid_x + step[0] + 0.5f) * grid_size - x,
+                              (grid_y + step[1] + 0.5f) * grid_size - y};
+    rr_vector_normalize(&delta);
+    *direction = delta;
+    return 1;
+}
@@ -0,0 +1,62 @@
+// Copyright (C) 2024 Paul Johnson
+// Copyright (C) 2024-2025 Maxim Nesterov
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as
+// published by the Free Software Foundation, either version 3 of the
+// License, or (at your option) any later version.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Affero General Public License for more details.
+
+// You should have received a copy of the GNU Affero General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+
+#pragma once
+
+#include <stdint.h>
+
+#include <Shared/StaticData.h>
+#include <Shared/Vector.h>
+
+#define RR_FLOW_FIELD_UNREACHABLE (UINT16_MAX)
+// ultimate mobs are kept in grids at least this difficult
+#define RR_FLOW_FIELD_HIGHER_ZONE_DIFFICULTY (48)
+// how close to the higher zone a mob has to wander before it turns back
+#define RR_FLOW_FIELD_HIGHER_ZONE_DISTANCE (3)
+// player fields stop this many grids out, well past any aggro range
+#define RR_FLOW_FIELD_CHASE_DISTANCE (8)
+#define RR_FLOW_FIELD_REFRESH_TICKS (4)
+
+// Breadth first distances over the walkable grids of a maze, counted in grid
+// steps towards the nearest goal. Steps only cross the open sides of curved
+// grids, and diagonal steps are only taken when both ways around the corner
+// are open, so the field never leads into a wall.
+// visited holds every grid the last build reached, in order, which makes it
+// both the search queue and the list of grids to reset on the next build.
+struct rr_flow_field
+{
+    uint16_t *distance;
+    uint32_t *visited;
+    struct rr_maze_declaration *maze;
+    uint32_t visited_count;
+    uint32_t goal;
+};
+
+void rr_flow_field_init(struct rr_flow_field *, struct rr_maze_declaration *);
+void rr_flow_field_free(struct rr_flow_field *);
+// Goals are all walkable grids at least as difficult as the given difficulty
+void rr_flow_field_build_difficulty(struct rr_flow_field *, float);
+// The goal is the grid containing the position. The search stops after the
+// given number of steps, grids further away are left unreachable.
+void rr_flow_field_build_position(struct rr_flow_field *, float, float,
+                                  uint16_t);
+uint16_t rr_flow_field_get_distance(struct rr_flow_field *, float, float);
+// Sets the unit vector towards the neighbouring grid one step closer to a
+// goal. Returns 0 and leaves the vector alone when the position already is
+// in a goal or the field has no way out of its grid.
+uint8_t rr_flow_field_get_direction(struct rr_flow_field *, float, float,
+                                    struct rr_vector *);
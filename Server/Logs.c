@@ -17,50 +17,277 @@
 #include <Server/Logs.h>
 
 #include <assert.h>
+#include <pthread.h>
+#include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
 
-#ifdef RIVET_BUILD
-#ifndef RR_DISABLE_DISCORD_INTEGRATION
+#ifndef NUSE_CURL
 #include <curl/curl.h>
+#endif
 
+#include <Server/SpscQueue.h>
+#include <Shared/Rivet.h>
 #include <Shared/cJSON.h>
 
-void rr_discord_webhook_log(char *webhook_name, char *name, char *value,
-                            uint32_t color)
+#define POLL_MICROSECONDS (50000)
+// discord cuts embed descriptions off there anyway
+#define MAX_JOB_SIZE (4096 + 512)
+
+enum log_job_type
 {
-    CURL *curl = curl_easy_init();
-    CURLcode result;
+    // data is the color followed by the username, title and description,
+    // all null terminated
+    log_job_webhook,
+    // data is the player token, socket the client
+    log_job_rivet_connected,
+    log_job_rivet_disconnected
+};
 
-    struct curl_slist *headers = 0;
-    headers = curl_slist_append(headers, "Content-Type: application/json");
-    assert(curl);
-    curl_easy_setopt(
-        curl, CURLOPT_URL,
-        "https://canary.discord.com/api/webhooks/1114420424277770250/"
-        "e0cMQafY8B5cJBJ0FadAqjvjQgC43O5vVCsk58uv5y9tZB9CWYrXk-P9zdWFxljSEcds");
+static struct
+{
+    // the thread that started the worker to the worker
+    struct rr_spsc_queue jobs;
+    // the worker back, players rivet turned away
+    struct rr_spsc_queue rejected;
+    char const *webhook_url;
+    // jobs the worker had no room for, only written by the queueing thread
+    uint32_t dropped;
+    pthread_t thread;
+} worker;
+
+static uint64_t now_milliseconds(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec * 1000ull + now.tv_nsec / 1000000;
+}
+
+#ifndef NUSE_CURL
+// 1 if the endpoint took it, retries a few times before giving up
+static int post_json(CURL *curl, char const *url, char const *json)
+{
+    struct curl_slist *headers =
+        curl_slist_append(NULL, "Content-Type: application/json");
+    curl_easy_setopt(curl, CURLOPT_URL, url);
     curl_easy_setopt(curl, CURLOPT_HTTPHEADER, headers);
-    cJSON *root = cJSON_CreateObject();
-    cJSON *embeds = cJSON_CreateArray();
-    cJSON *embed = cJSON_CreateObject();
+    curl_easy_setopt(curl, CURLOPT_POSTFIELDS, json);
+    curl_easy_setopt(curl, CURLOPT_TIMEOUT, RR_LOG_TIMEOUT_SECONDS);
+    int success = 0;
+    for (uint32_t attempt = 0; attempt < RR_LOG_ATTEMPT_COUNT; ++attempt)
+    {
+        if (attempt > 0)
+            sleep(1 << (attempt - 1));
+        long code = 0;
+        if (curl_easy_perform(curl) == CURLE_OK)
+            curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &code);
+        if (code >= 200 && code < 300)
+        {
+            success = 1;
+            break;
+        }
+        // anything else than being told to slow down will not get better
+        if (code >= 400 && code < 500 && code != 429)
+            break;
+    }
+    curl_slist_free_all(headers);
+    return success;
+}
+#endif
+
+struct webhook_batch
+{
+    cJSON *root;
+    cJSON *embeds;
+    uint32_t size;
+    char username[128];
+};
 
-    cJSON_AddItemToObject(root, "username", cJSON_CreateString(webhook_name));
-    cJSON_AddItemToObject(root, "embeds", embeds);
-    cJSON_AddItemToArray(embeds, embed);
+static void flush_webhook_batch(struct webhook_batch *batch, void *curl)
+{
+    if (batch->size == 0)
+        return;
+#ifndef NUSE_CURL
+    char *post_data = cJSON_PrintUnformatted(batch->root);
+    if (!post_json(curl, worker.webhook_url, post_data))
+        fprintf(stderr, "webhook dropped %u logs\n", batch->size);
+    free(post_data);
+#endif
+    cJSON_Delete(batch->root);
+    batch->root = NULL;
+    batch->size = 0;
+}
+
+static void add_to_webhook_batch(struct webhook_batch *batch, uint8_t *data)
+{
+    uint32_t color;
+    memcpy(&color, data, sizeof color);
+    char const *username = (char *)data + sizeof color;
+    char const *title = username + strlen(username) + 1;
+    char const *description = title + strlen(title) + 1;
+    if (batch->size == 0)
+    {
+        batch->root = cJSON_CreateObject();
+        batch->embeds = cJSON_CreateArray();
+        cJSON_AddItemToObject(batch->root, "username",
+                              cJSON_CreateString(username));
+        cJSON_AddItemToObject(batch->root, "embeds", batch->embeds);
+        snprintf(batch->username, sizeof batch->username, "%s", username);
+    }
+    cJSON *embed = cJSON_CreateObject();
     cJSON_AddItemToObject(embed, "color", cJSON_CreateNumber(color));
-    cJSON_AddItemToObject(embed, "title", cJSON_CreateString(name));
-    cJSON_AddItemToObject(embed, "description", cJSON_CreateString(value));
+    cJSON_AddItemToObject(embed, "title", cJSON_CreateString(title));
+    cJSON_AddItemToObject(embed, "description",
+                          cJSON_CreateString(description));
+    cJSON_AddItemToArray(batch->embeds, embed);
+    ++batch->size;
+}
 
-    char *post_data = cJSON_Print(root);
+static void run_rivet_job(struct rr_spsc_queue_record *job)
+{
+#ifdef RIVET_BUILD
+    char const *token = (char *)(job + 1);
+    for (uint32_t attempt = 0; attempt < RR_LOG_ATTEMPT_COUNT; ++attempt)
+    {
+        if (attempt > 0)
+            sleep(1 << (attempt - 1));
+        if (job->type == log_job_rivet_disconnected)
+        {
+            if (rr_rivet_players_disconnected(getenv("RIVET_TOKEN"), token))
+                return;
+            continue;
+        }
+        int connected =
+            rr_rivet_players_connected(getenv("RIVET_TOKEN"), token);
+        if (connected == -1)
+            continue;
+        if (connected == 0 &&
+            !rr_spsc_queue_push(&worker.rejected, 0, job->socket, token,
+                                job->size))
+            fputs("rivet rejection lost\n", stderr);
+        return;
+    }
+    // a player is only ever turned away on rivet's word, not for it being
+    // unreachable
+    fputs("could not reach rivet\n", stderr);
+#endif
+}
 
-    curl_easy_setopt(curl, CURLOPT_POSTFIELDS, post_data);
-    result = curl_easy_perform(curl);
-    assert(result == CURLE_OK);
-    curl_easy_cleanup(curl);
-    free(post_data);
-    cJSON_Delete(root);
-    curl_slist_free_all(headers);
+static void *worker_thread(void *_)
+{
+    void *curl = NULL;
+#ifndef NUSE_CURL
+    curl = curl_easy_init();
+    assert(curl);
+#endif
+    struct webhook_batch batch = {0};
+    uint64_t next_post = 0;
+    uint32_t dropped_reported = 0;
+    while (1)
+    {
+        struct rr_spsc_queue_record *job;
+        // the batch holds on to webhooks until discord may be posted to
+        // again, whatever does not fit into it waits in the queue
+        while ((job = rr_spsc_queue_peek(&worker.jobs)) != NULL)
+        {
+            if (job->type != log_job_webhook)
+                run_rivet_job(job);
+            else if (batch.size == RR_LOG_WEBHOOK_BATCH_SIZE ||
+                     (batch.size > 0 &&
+                      strcmp(batch.username,
+                             (char *)(job + 1) + sizeof(uint32_t)) != 0))
+                break;
+            else
+                add_to_webhook_batch(&batch, (uint8_t *)(job + 1));
+            rr_spsc_queue_pop(&worker.jobs);
+        }
+        if (batch.size > 0 && now_milliseconds() >= next_post)
+        {
+            flush_webhook_batch(&batch, curl);
+            next_post = now_milliseconds() + RR_LOG_WEBHOOK_INTERVAL;
+        }
+        uint32_t dropped = __atomic_load_n(&worker.dropped, __ATOMIC_RELAXED);
+        if (dropped != dropped_reported)
+        {
+            fprintf(stderr, "log worker fell behind, %u jobs dropped\n",
+                    dropped - dropped_reported);
+            dropped_reported = dropped;
+        }
+        usleep(POLL_MICROSECONDS);
+    }
+    return NULL;
 }
 
-void rr_discord_curl_init() { curl_global_init(CURL_GLOBAL_ALL); }
+void rr_log_worker_start(void)
+{
+#ifndef NUSE_CURL
+    curl_global_init(CURL_GLOBAL_ALL);
 #endif
+    worker.webhook_url = getenv("RR_WEBHOOK_URL");
+#ifdef RIVET_BUILD
+    if (worker.webhook_url == NULL)
+        worker.webhook_url = RR_DISCORD_WEBHOOK_URL;
 #endif
+    rr_spsc_queue_init(&worker.jobs, RR_LOG_QUEUE_SIZE);
+    rr_spsc_queue_init(&worker.rejected, RR_LOG_QUEUE_SIZE);
+    pthread_create(&worker.thread, NULL, worker_thread, NULL);
+}
+
+// without a worker, as in the benches, everything is dropped quietly
+static void queue_job(uint8_t type, uint32_t socket, void const *data,
+                      uint32_t size)
+{
+    if (worker.jobs.data == NULL)
+        return;
+    if (!rr_spsc_queue_push(&worker.jobs, type, socket, data, size))
+        __atomic_store_n(&worker.dropped, worker.dropped + 1,
+                         __ATOMIC_RELAXED);
+}
+
+#undef rr_discord_webhook_log
+void rr_discord_webhook_log(char const *webhook_name, char const *name,
+                            char const *value, uint32_t color)
+{
+    if (worker.webhook_url == NULL)
+        return;
+    uint8_t job[MAX_JOB_SIZE];
+    memcpy(job, &color, sizeof color);
+    uint32_t size = sizeof color;
+    char const *strings[] = {webhook_name, name, value};
+    for (uint32_t i = 0; i < 3; ++i)
+    {
+        uint32_t length = strlen(strings[i]);
+        if (length > MAX_JOB_SIZE - size - (3 - i))
+            length = MAX_JOB_SIZE - size - (3 - i);
+        memcpy(job + size, strings[i], length);
+        size += length;
+        job[size++] = 0;
+    }
+    queue_job(log_job_webhook, 0, job, size);
+}
+
+void rr_log_rivet_connected(uint32_t client, char const *player_token)
+{
+    queue_job(log_job_rivet_connected, client, player_token,
+              strlen(player_token) + 1);
+}
+
+void rr_log_rivet_disconnected(char const *player_token)
+{
+    queue_job(log_job_rivet_disconnected, 0, player_token,
+              strlen(player_token) + 1);
+}
+
+int rr_log_poll_rivet_rejected(uint32_t *client, char *token)
+{
+    struct rr_spsc_queue_record *rejected =
+        rr_spsc_queue_peek(&worker.rejected);
+    if (rejected == NULL)
+        return 0;
+    *client = rejected->socket;
+    memcpy(token, rejected + 1, rejected->size);
+    rr_spsc_queue_pop(&worker.rejected);
+    return 1;
+}
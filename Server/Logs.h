@@ -22,9 +22,35 @@
     "https://canary.discord.com/api/webhooks/1114420424277770250/"             \
     "e0cMQafY8B5cJBJ0FadAqjvjQgC43O5vVCsk58uv5y9tZB9CWYrXk-P9zdWFxljSEcds"
 
-void rr_discord_webhook_log(char *webhook_name, char *name, char *value,
-                            uint32_t color);
+// bytes of work that may be waiting for the worker, anything past that is
+// dropped
+#define RR_LOG_QUEUE_SIZE (256 * 1024)
+// discord takes at most 10 embeds per message
+#define RR_LOG_WEBHOOK_BATCH_SIZE (10)
+// milliseconds between two webhook posts
+#define RR_LOG_WEBHOOK_INTERVAL (2000)
+// attempts per request, each waiting twice as long as the one before
+#define RR_LOG_ATTEMPT_COUNT (4)
+#define RR_LOG_TIMEOUT_SECONDS (10)
+
+// Starts the one thread that does every http request the server makes while
+// it runs, so that a slow endpoint never holds up a tick. Webhooks go to
+// RR_WEBHOOK_URL, or in rivet builds to discord if that is not set, and are
+// dropped otherwise.
+void rr_log_worker_start(void);
+
+// Only the thread that started the worker may queue work for it. None of
+// these block, if the worker is too far behind the work is dropped.
+void rr_discord_webhook_log(char const *webhook_name, char const *name,
+                            char const *value, uint32_t color);
+void rr_log_rivet_connected(uint32_t client, char const *player_token);
+void rr_log_rivet_disconnected(char const *player_token);
+
+// Returns 1 and the client along with the token it was connected with for
+// every player rivet turned away since the last call, 0 once there are none
+// left. The token has to be large enough for any token that was queued.
+int rr_log_poll_rivet_rejected(uint32_t *client, char *token);
 
 #ifdef RR_DISABLE_DISCORD_INTEGRATION
-#define rr_discord_webhook_log(a, b, c)
+#define rr_discord_webhook_log(a, b, c, d)
 #endif
@@ -27,6 +27,7 @@
 #endif
 
 #include <Server/Logs.h>
+#include <Server/Network.h>
 #include <Server/Server.h>
 #include <Shared/Api.h>
 #include <Shared/MagicNumber.h>
@@ -37,11 +38,12 @@
 int main()
 {
     fprintf(stderr, "gameserver on version %llu\n", RR_SECRET8 ^ 255);
-    srand(time(0));
+    rr_srand(time(0));
     // signal(SIGINT, sigint_handle);
 #ifdef RIVET_BUILD
     curl_global_init(CURL_GLOBAL_ALL);
 #endif
+    rr_log_worker_start();
     char startup_message[1000] = {0};
 #ifdef NDEBUG
     strcat(startup_message, "release");
@@ -78,7 +80,9 @@ int main()
 
 #endif
     struct rr_server *s = calloc(1, sizeof *s);
-    rr_server_init(s);
+    rr_server_init(s, time(0));
+    rr_network_start(&s->network);
     rr_server_run(s);
+    rr_network_free(&s->network);
     rr_server_free(s);
 }
@@ -28,6 +28,10 @@ uint8_t has_new_target(struct rr_component_ai *, struct rr_simulation *);
 uint8_t ai_is_passive(struct rr_component_ai *);
 uint8_t should_aggro(struct rr_simulation *, struct rr_component_ai *);
 struct rr_vector predict(struct rr_vector, struct rr_vector, float);
+// From the entity to its target, bent along the target player's flow field
+// when walls are in the way
+struct rr_vector ai_get_target_delta(struct rr_simulation *, EntityIdx,
+                                     EntityIdx);
 
 void tick_idle(EntityIdx, struct rr_simulation *);
 void tick_idle_move_default(EntityIdx, struct rr_simulation *);
@@ -19,6 +19,7 @@
 #include <math.h>
 
 #include <Server/EntityDetection.h>
+#include <Server/FlowField.h>
 #include <Server/Simulation.h>
 
 static uint8_t is_close_enough_to_parent(struct rr_simulation *simulation,
@@ -73,7 +74,7 @@ uint8_t has_new_target(struct rr_component_ai *ai,
     {
         ai->target_entity = RR_NULL_ENTITY;
         ai->ai_state = rr_ai_state_idle;
-        ai->ticks_until_next_action = rand() % 25 + 25;
+        ai->ticks_until_next_action = rr_rand() % 25 + 25;
     }
     return 0;
 }
@@ -115,7 +116,7 @@ void tick_idle(EntityIdx entity, struct rr_simulation *simulation)
 
     if (ai->ticks_until_next_action == 0)
     {
-        ai->ticks_until_next_action = rand() % 33 + 25;
+        ai->ticks_until_next_action = rr_rand() % 33 + 25;
         ai->ai_state = rr_ai_state_idle_moving;
         rr_component_physical_set_angle(
             physical, physical->angle + (rr_frand() - 0.5) * M_PI);
@@ -202,7 +203,7 @@ uint8_t tick_summon_return_to_owner(EntityIdx entity,
     else if (ai->ai_state == rr_ai_state_returning_to_owner)
     {
         ai->ai_state = rr_ai_state_idle;
-        ai->ticks_until_next_action = rand() % 25 + 25;
+        ai->ticks_until_next_action = rr_rand() % 25 + 25;
         return 0;
     }
     return 0;
@@ -214,14 +215,16 @@ void tick_return_to_higher_zone(EntityIdx entity,
     struct rr_component_ai *ai = rr_simulation_get_ai(simulation, entity);
     struct rr_component_physical *physical =
         rr_simulation_get_physical(simulation, entity);
+    struct rr_component_arena *arena =
+        rr_simulation_get_arena(simulation, physical->arena);
+    struct rr_flow_field *field = &arena->zone_flow_field;
     if (ai->ai_state == rr_ai_state_returning_to_higher_zone)
     {
-        struct rr_vector delta = {ai->return_pos.x - physical->x,
-                                  ai->return_pos.y - physical->y};
-        if (rr_vector_magnitude_cmp(&delta, physical->radius) == 1)
+        struct rr_vector accel;
+        if (rr_flow_field_get_direction(field, physical->x, physical->y,
+                                        &accel))
         {
-            struct rr_vector accel = delta;
-            rr_vector_set_magnitude(&accel, RR_PLAYER_SPEED * 1.2);
+            rr_vector_scale(&accel, RR_PLAYER_SPEED * 1.2);
             rr_vector_add(&physical->acceleration, &accel);
             rr_component_physical_set_angle(physical, rr_vector_theta(&accel));
             ai->target_entity = RR_NULL_ENTITY;
@@ -229,37 +232,56 @@ void tick_return_to_higher_zone(EntityIdx entity,
         else
         {
             ai->ai_state = rr_ai_state_idle;
-            ai->ticks_until_next_action = rand() % 25 + 25;
+            ai->ticks_until_next_action = rr_rand() % 25 + 25;
         }
         return;
     }
     struct rr_component_mob *mob = rr_simulation_get_mob(simulation, entity);
     if (mob->rarity < rr_rarity_id_ultimate)
         return;
-    struct rr_component_arena *arena =
-        rr_simulation_get_arena(simulation, physical->arena);
     int32_t grid_x = rr_fclamp(physical->x / arena->maze->grid_size,
                                0, arena->maze->maze_dim - 1);
     int32_t grid_y = rr_fclamp(physical->y / arena->maze->grid_size,
                                0, arena->maze->maze_dim - 1);
     struct rr_maze_grid *grid =
         rr_component_arena_get_grid(arena, grid_x, grid_y);
-    if (grid->difficulty >= 48 || grid->value == 0 || (grid->value & 8))
+    if (grid->difficulty >= RR_FLOW_FIELD_HIGHER_ZONE_DIFFICULTY ||
+        grid->value == 0 || (grid->value & 8))
         return;
-    for (int8_t i = -1; i <= 1; ++i)
-        for (int8_t j = -1; j <= 1; ++j)
-        {
-            int32_t x = (grid_x / 2 + i) * 2 + 1;
-            int32_t y = (grid_y / 2 + j) * 2 + 1;
-            if (x < 0 || x >= arena->maze->maze_dim ||
-                y < 0 || y >= arena->maze->maze_dim)
-                continue;
-            grid = rr_component_arena_get_grid(arena, x, y);
-            if (grid->difficulty < 48)
-                continue;
-            rr_vector_set(&ai->return_pos, x * arena->maze->grid_size,
-                          y * arena->maze->grid_size);
-            ai->ai_state = rr_ai_state_returning_to_higher_zone;
-            return;
-        }
+    if (rr_flow_field_get_distance(field, physical->x, physical->y) <=
+        RR_FLOW_FIELD_HIGHER_ZONE_DISTANCE)
+        ai->ai_state = rr_ai_state_returning_to_higher_zone;
+}
+
+struct rr_vector ai_get_target_delta(struct rr_simulation *simulation,
+                                     EntityIdx entity, EntityIdx target)
+{
+    struct rr_component_physical *physical =
+        rr_simulation_get_physical(simulation, entity);
+    struct rr_component_physical *target_physical =
+        rr_simulation_get_physical(simulation, target);
+    struct rr_vector delta = {target_physical->x - physical->x,
+                              target_physical->y - physical->y};
+    if (!rr_simulation_has_flower(simulation, target) ||
+        physical->arena != target_physical->arena)
+        return delta;
+    EntityHash owner = rr_simulation_get_relations(simulation, target)->owner;
+    if (!rr_simulation_entity_alive(simulation, owner) ||
+        !rr_simulation_has_player_info(simulation, owner))
+        return delta;
+    struct rr_component_player_info *player_info =
+        rr_simulation_get_player_info(simulation, owner);
+    struct rr_flow_field *field = &player_info->flow_field;
+    if (field->maze !=
+        rr_simulation_get_arena(simulation, physical->arena)->maze)
+        return delta;
+    // a grid away there is no wall worth walking around
+    if (rr_flow_field_get_distance(field, physical->x, physical->y) <= 1)
+        return delta;
+    struct rr_vector direction;
+    if (!rr_flow_field_get_direction(field, physical->x, physical->y,
+                                     &direction))
+        return delta;
+    rr_vector_scale(&direction, rr_vector_get_magnitude(&delta));
+    return direction;
 }
@@ -47,12 +47,8 @@ void tick_ai_default(EntityIdx entity, struct rr_simulation *simulation,
     case rr_ai_state_attacking:
     {
         struct rr_vector accel;
-        struct rr_component_physical *physical2 =
-            rr_simulation_get_physical(simulation, ai->target_entity);
-
-        struct rr_vector delta = {physical2->x, physical2->y};
-        struct rr_vector target_pos = {physical->x, physical->y};
-        rr_vector_sub(&delta, &target_pos);
+        struct rr_vector delta =
+            ai_get_target_delta(simulation, entity, ai->target_entity);
         // struct rr_vector prediction = predict(delta, physical2->velocity, 4);
         float target_angle = rr_vector_theta(&delta);
 
@@ -95,16 +91,15 @@ void tick_ai_triceratops(EntityIdx entity, struct rr_simulation *simulation)
         if (ai->ticks_until_next_action == 0)
         {
             ai->ai_state = rr_ai_state_attacking;
-            ai->ticks_until_next_action = rand() % 25 + 63;
+            ai->ticks_until_next_action = rr_rand() % 25 + 63;
             break;
         }
 
         struct rr_component_physical *physical2 =
             rr_simulation_get_physical(simulation, ai->target_entity);
 
-        struct rr_vector delta = {physical2->x, physical2->y};
-        struct rr_vector target_pos = {physical->x, physical->y};
-        rr_vector_sub(&delta, &target_pos);
+        struct rr_vector delta =
+            ai_get_target_delta(simulation, entity, ai->target_entity);
         struct rr_vector prediction =
             predict(delta, physical2->velocity, ai->has_prediction * 15);
         rr_component_physical_set_angle(physical, rr_vector_theta(&prediction));
@@ -115,7 +110,7 @@ void tick_ai_triceratops(EntityIdx entity, struct rr_simulation *simulation)
         if (ai->ticks_until_next_action == 0)
         {
             ai->ai_state = rr_ai_state_waiting_to_attack;
-            ai->ticks_until_next_action = rand() % 12 + 12;
+            ai->ticks_until_next_action = rr_rand() % 12 + 12;
             break;
         }
 
@@ -123,9 +118,8 @@ void tick_ai_triceratops(EntityIdx entity, struct rr_simulation *simulation)
         struct rr_component_physical *physical2 =
             rr_simulation_get_physical(simulation, ai->target_entity);
 
-        struct rr_vector delta = {physical2->x, physical2->y};
-        struct rr_vector target_pos = {physical->x, physical->y};
-        rr_vector_sub(&delta, &target_pos);
+        struct rr_vector delta =
+            ai_get_target_delta(simulation, entity, ai->target_entity);
         struct rr_vector prediction =
             predict(delta, physical2->velocity, ai->has_prediction * 15);
         float target_angle = rr_vector_theta(&prediction);
@@ -165,12 +159,8 @@ void tick_ai_trex(EntityIdx entity, struct rr_simulation *simulation)
     case rr_ai_state_attacking:
     {
         struct rr_vector accel;
-        struct rr_component_physical *physical2 =
-            rr_simulation_get_physical(simulation, ai->target_entity);
-
-        struct rr_vector delta = {physical2->x, physical2->y};
-        struct rr_vector target_pos = {physical->x, physical->y};
-        rr_vector_sub(&delta, &target_pos);
+        struct rr_vector delta =
+            ai_get_target_delta(simulation, entity, ai->target_entity);
         // struct rr_vector prediction = predict(delta, physical2->velocity, 4);
         float target_angle = rr_vector_theta(&delta);
 
@@ -325,9 +315,8 @@ void tick_ai_pteranodon(EntityIdx entity, struct rr_simulation *simulation)
         struct rr_component_physical *physical2 =
             rr_simulation_get_physical(simulation, ai->target_entity);
 
-        struct rr_vector delta = {physical2->x, physical2->y};
-        struct rr_vector target_pos = {physical->x, physical->y};
-        rr_vector_sub(&delta, &target_pos);
+        struct rr_vector delta =
+            ai_get_target_delta(simulation, entity, ai->target_entity);
         struct rr_vector prediction =
             predict(delta, physical2->velocity,
                     ai->has_prediction * 20); // make this less op
@@ -371,12 +360,8 @@ void tick_ai_pachycephalosaurus(EntityIdx entity,
     case rr_ai_state_attacking:
     {
         struct rr_vector accel;
-        struct rr_component_physical *physical2 =
-            rr_simulation_get_physical(simulation, ai->target_entity);
-
-        struct rr_vector delta = {physical2->x, physical2->y};
-        struct rr_vector target_pos = {physical->x, physical->y};
-        rr_vector_sub(&delta, &target_pos);
+        struct rr_vector delta =
+            ai_get_target_delta(simulation, entity, ai->target_entity);
         // struct rr_vector prediction = predict(delta, physical2->velocity, 4);
         float target_angle = rr_vector_theta(&delta);
 
@@ -479,12 +464,8 @@ void tick_ai_ankylosaurus(EntityIdx entity, struct rr_simulation *simulation)
     case rr_ai_state_attacking:
     {
         struct rr_vector accel;
-        struct rr_component_physical *physical2 =
-            rr_simulation_get_physical(simulation, ai->target_entity);
-
-        struct rr_vector delta = {physical2->x, physical2->y};
-        struct rr_vector target_pos = {physical->x, physical->y};
-        rr_vector_sub(&delta, &target_pos);
+        struct rr_vector delta =
+            ai_get_target_delta(simulation, entity, ai->target_entity);
         // struct rr_vector prediction = predict(delta, physical2->velocity, 4);
         float target_angle = rr_vector_theta(&delta);
 
@@ -508,12 +489,8 @@ void tick_ai_ankylosaurus(EntityIdx entity, struct rr_simulation *simulation)
     {
         physical->knockback_scale = 25;
         struct rr_vector accel;
-        struct rr_component_physical *physical2 =
-            rr_simulation_get_physical(simulation, ai->target_entity);
-
-        struct rr_vector delta = {physical2->x, physical2->y};
-        struct rr_vector target_pos = {physical->x, physical->y};
-        rr_vector_sub(&delta, &target_pos);
+        struct rr_vector delta =
+            ai_get_target_delta(simulation, entity, ai->target_entity);
         float target_angle = rr_vector_theta(&delta);
 
         rr_component_physical_set_angle(physical, target_angle);
@@ -608,12 +585,8 @@ void tick_ai_quetzalcoaltus(EntityIdx entity, struct rr_simulation *simulation)
     case rr_ai_state_attacking:
     {
         physical->knockback_scale = 10;
-        struct rr_component_physical *physical2 =
-            rr_simulation_get_physical(simulation, ai->target_entity);
-
-        struct rr_vector delta = {physical2->x, physical2->y};
-        struct rr_vector target_pos = {physical->x, physical->y};
-        rr_vector_sub(&delta, &target_pos);
+        struct rr_vector delta =
+            ai_get_target_delta(simulation, entity, ai->target_entity);
         rr_component_physical_set_angle(physical, rr_vector_theta(&delta));
         if (ai->ticks_until_next_action == 0)
         {
@@ -0,0 +1,422 @@
+// Copyright (C) 2024 Paul Johnson
+// Copyright (C) 2024-2025 Maxim Nesterov
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as
+// published by the Free Software Foundation, either version 3 of the
+// License, or (at your option) any later version.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Affero General Public License for more details.
+
+// You should have received a copy of the GNU Affero General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#include <Server/Network.h>
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <libwebsockets.h>
+
+#include <Server/Server.h>
+#include <Shared/Api.h>
+
+// api frames are received in pieces of at most this many bytes
+#define API_RECEIVE_SIZE (128 * 1024)
+
+_Static_assert(RR_NETWORK_PRE >= LWS_PRE, "room for the lws headroom");
+_Static_assert(API_RECEIVE_SIZE <=
+                   RR_SPSC_QUEUE_MAX_SIZE(RR_NETWORK_QUEUE_SIZE),
+               "api receives always fit the event queue");
+
+static int close_socket(struct lws *ws, char const *reason)
+{
+    lws_close_reason(ws, LWS_CLOSE_STATUS_GOINGAWAY, (uint8_t *)reason,
+                     strlen(reason));
+    return -1;
+}
+
+// Queues the event for the tick thread, behind whatever is already waiting
+// in the backlog. Returns 0 if it had to wait in the backlog.
+static int push_event(struct rr_network_service *service, uint8_t type,
+                      uint32_t socket, void const *data, uint32_t size)
+{
+    // would hold up everything behind it in the backlog for good
+    assert(size <= RR_SPSC_QUEUE_MAX_SIZE(service->events.capacity));
+    if (service->backlog_size == 0 &&
+        rr_spsc_queue_push(&service->events, type, socket, data, size))
+        return 1;
+    if (service->backlog_size == 0)
+        fputs("tick thread fell behind, holding network events\n", stderr);
+    struct rr_spsc_queue_record record = {size, socket, type};
+    uint32_t needed = service->backlog_size + sizeof record + size;
+    if (needed > service->backlog_capacity)
+    {
+        uint32_t capacity =
+            service->backlog_capacity ? service->backlog_capacity : 4096;
+        while (capacity < needed)
+            capacity *= 2;
+        service->backlog = realloc(service->backlog, capacity);
+        assert(service->backlog);
+        service->backlog_capacity = capacity;
+    }
+    memcpy(service->backlog + service->backlog_size, &record, sizeof record);
+    if (size > 0)
+        memcpy(service->backlog + service->backlog_size + sizeof record, data,
+               size);
+    service->backlog_size = needed;
+    return 0;
+}
+
+// Returns 1 once the backlog is empty
+static int flush_backlog(struct rr_network_service *service)
+{
+    uint32_t at = 0;
+    while (at < service->backlog_size)
+    {
+        struct rr_spsc_queue_record record;
+        memcpy(&record, service->backlog + at, sizeof record);
+        if (!rr_spsc_queue_push(&service->events, record.type, record.socket,
+                                service->backlog + at + sizeof record,
+                                record.size))
+            break;
+        at += sizeof record + record.size;
+    }
+    memmove(service->backlog, service->backlog + at,
+            service->backlog_size - at);
+    service->backlog_size -= at;
+    return service->backlog_size == 0;
+}
+
+static void release_message_queue(struct rr_network *this, uint32_t socket,
+                                  struct rr_network_message_queue *queue)
+{
+    push_event(&this->server, rr_network_event_message_queue_released, socket,
+               queue, sizeof *queue);
+}
+
+static struct rr_network_socket *find_socket(struct rr_network *this,
+                                             uint32_t id)
+{
+    struct rr_network_socket *socket =
+        &this->sockets[id % RR_NETWORK_SOCKET_COUNT];
+    if (socket->ws == NULL || socket->id != id)
+        return NULL;
+    return socket;
+}
+
+static void write_message_queue(struct rr_network_socket *socket,
+                                struct rr_network_message_queue *queue)
+{
+    for (uint64_t at = 0; at < queue->size;)
+    {
+        uint64_t size;
+        memcpy(&size, queue->data + at, sizeof size);
+        lws_write(socket->ws, queue->data + at + RR_MESSAGE_HEADER_SIZE, size,
+                  LWS_WRITE_BINARY);
+        at += RR_MESSAGE_ALIGN(RR_MESSAGE_HEADER_SIZE + size);
+    }
+}
+
+static int socket_callback(struct lws *ws, enum lws_callback_reasons reason,
+                           void *user, void *packet, size_t size)
+{
+    struct rr_network *this = lws_context_user(lws_get_context(ws));
+    struct rr_network_socket *socket = lws_get_opaque_user_data(ws);
+    switch (reason)
+    {
+    case LWS_CALLBACK_ESTABLISHED:
+    {
+        char xff[100];
+        if (lws_hdr_copy(ws, xff, sizeof xff, WSI_TOKEN_X_FORWARDED_FOR) <= 0)
+            return close_socket(ws, "could not get xff header");
+        for (uint32_t i = 0; i < RR_NETWORK_SOCKET_COUNT; ++i)
+        {
+            socket = &this->sockets[i];
+            if (socket->ws != NULL)
+                continue;
+            if (++this->generation >= UINT32_MAX / RR_NETWORK_SOCKET_COUNT)
+                this->generation = 1;
+            socket->ws = ws;
+            socket->id = i + this->generation * RR_NETWORK_SOCKET_COUNT;
+            socket->queue.data = NULL;
+            socket->closing = 0;
+            lws_set_opaque_user_data(ws, socket);
+            push_event(&this->server, rr_network_event_socket_established,
+                       socket->id, xff, strlen(xff) + 1);
+            return 0;
+        }
+        return close_socket(ws, "too many active clients");
+    }
+    case LWS_CALLBACK_RECEIVE:
+        if (socket == NULL)
+            return -1;
+        // lws hands over up to MESSAGE_BUFFER_SIZE at once, more than fits
+        // in debug builds
+        if (size > RR_SPSC_QUEUE_MAX_SIZE(RR_NETWORK_QUEUE_SIZE))
+            return close_socket(ws, "packet too large");
+        // stop reading until the tick thread caught up
+        if (!push_event(&this->server, rr_network_event_socket_receive,
+                        socket->id, packet, size))
+            lws_rx_flow_control(ws, 0);
+        break;
+    case LWS_CALLBACK_SERVER_WRITEABLE:
+        if (socket == NULL)
+            return -1;
+        if (socket->closing)
+            return close_socket(ws, socket->close_reason);
+        if (socket->queue.data == NULL)
+            break;
+        write_message_queue(socket, &socket->queue);
+        release_message_queue(this, socket->id, &socket->queue);
+        socket->queue.data = NULL;
+        break;
+    case LWS_CALLBACK_CLOSED:
+        if (socket == NULL)
+            break;
+        push_event(&this->server, rr_network_event_socket_closed, socket->id,
+                   NULL, 0);
+        if (socket->queue.data != NULL)
+            release_message_queue(this, socket->id, &socket->queue);
+        socket->ws = NULL;
+        lws_set_opaque_user_data(ws, NULL);
+        break;
+    default:
+        break;
+    }
+    return 0;
+}
+
+static int api_callback(struct lws *ws, enum lws_callback_reasons reason,
+                        void *user, void *packet, size_t size)
+{
+    struct rr_network *this = lws_context_user(lws_get_context(ws));
+    switch (reason)
+    {
+    case LWS_CALLBACK_CLIENT_ESTABLISHED:
+        push_event(&this->api, rr_network_event_api_established, 0, NULL, 0);
+        break;
+    case LWS_CALLBACK_CLIENT_RECEIVE:
+        if (!push_event(&this->api, rr_network_event_api_receive, 0, packet,
+                        size))
+            lws_rx_flow_control(ws, 0);
+        break;
+    case LWS_CALLBACK_CLIENT_CLOSED:
+        // uh oh
+        fprintf(stderr, "api ws disconnected\n");
+        abort();
+        break;
+    case LWS_CALLBACK_CLIENT_CONNECTION_ERROR:
+        fprintf(stderr, "api ws refused to connect\n");
+        abort();
+        break;
+    default:
+        break;
+    }
+    return 0;
+}
+
+// only ever runs on the server thread, the sockets are its alone
+static void run_socket_command(struct rr_network *this,
+                               struct rr_spsc_queue_record *command)
+{
+    uint8_t *data = (uint8_t *)(command + 1);
+    struct rr_network_socket *socket = find_socket(this, command->socket);
+    switch (command->type)
+    {
+    case rr_network_command_socket_send:
+    {
+        struct rr_network_message_queue queue;
+        memcpy(&queue, data, sizeof queue);
+        if (socket == NULL || socket->closing)
+            release_message_queue(this, command->socket, &queue);
+        else if (socket->queue.data == NULL)
+        {
+            socket->queue = queue;
+            lws_callback_on_writable(socket->ws);
+        }
+        else if (socket->queue.size + queue.size > RR_MESSAGE_QUEUE_SIZE)
+        {
+            release_message_queue(this, command->socket, &queue);
+            strcpy(socket->close_reason, "kicked for not keeping up");
+            socket->closing = 1;
+            lws_callback_on_writable(socket->ws);
+        }
+        else
+        {
+            // lws has not let the socket write since the last one, both go
+            // out together
+            memcpy(socket->queue.data + socket->queue.size, queue.data,
+                   queue.size);
+            socket->queue.size += queue.size;
+            release_message_queue(this, command->socket, &queue);
+        }
+        break;
+    }
+    case rr_network_command_socket_close:
+        if (socket == NULL || socket->closing)
+            break;
+        snprintf(socket->close_reason, sizeof socket->close_reason, "%.*s",
+                 command->size, data);
+        socket->closing = 1;
+        lws_callback_on_writable(socket->ws);
+        break;
+    default:
+        break;
+    }
+}
+
+static void run_api_command(struct rr_network *this,
+                            struct rr_spsc_queue_record *command)
+{
+    if (command->type != rr_network_command_api_send)
+        return;
+    if (command->size > this->api_message_capacity)
+    {
+        this->api_message_capacity = command->size;
+        this->api_message =
+            realloc(this->api_message, RR_NETWORK_PRE + command->size);
+        assert(this->api_message);
+    }
+    memcpy(this->api_message + RR_NETWORK_PRE, command + 1, command->size);
+    lws_write(this->api_ws, this->api_message + RR_NETWORK_PRE, command->size,
+              LWS_WRITE_BINARY);
+}
+
+// lws holds on to these for as long as the contexts live
+static struct lws_protocols socket_protocols[] = {
+    {"g", socket_callback, sizeof(uint8_t), MESSAGE_BUFFER_SIZE, 0, NULL, 0},
+    {0}};
+static struct lws_protocols api_protocols[] = {
+    {
+        "g",
+        api_callback,
+        0,
+        API_RECEIVE_SIZE,
+    },
+    {NULL, NULL, 0, 0} // terminator
+};
+
+static void store_cpu_time(struct rr_network_service *service)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &now);
+    __atomic_store_n(&service->cpu_nanoseconds,
+                     now.tv_sec * 1000000000ull + now.tv_nsec,
+                     __ATOMIC_RELAXED);
+}
+
+static void *server_thread(void *_this)
+{
+    struct rr_network *this = _this;
+    while (1)
+    {
+        lws_service(this->server.context, RR_NETWORK_SERVICE_TIMEOUT_MS);
+        struct rr_spsc_queue_record *command;
+        while ((command = rr_spsc_queue_peek(&this->server.commands)) != NULL)
+        {
+            run_socket_command(this, command);
+            rr_spsc_queue_pop(&this->server.commands);
+        }
+        if (this->server.backlog_size > 0 && flush_backlog(&this->server))
+            lws_rx_flow_allow_all_protocol(this->server.context,
+                                           &socket_protocols[0]);
+        store_cpu_time(&this->server);
+    }
+    return NULL;
+}
+
+static void *api_thread(void *_this)
+{
+    struct rr_network *this = _this;
+    while (1)
+    {
+        lws_service(this->api.context, RR_NETWORK_SERVICE_TIMEOUT_MS);
+        struct rr_spsc_queue_record *command;
+        while ((command = rr_spsc_queue_peek(&this->api.commands)) != NULL)
+        {
+            run_api_command(this, command);
+            rr_spsc_queue_pop(&this->api.commands);
+        }
+        if (this->api.backlog_size > 0 && flush_backlog(&this->api))
+            lws_rx_flow_control(this->api_ws, 1);
+        store_cpu_time(&this->api);
+    }
+    return NULL;
+}
+
+// lws_service returns as soon as the other thread cancels it, the commands
+// pushed until then run right after
+static void wake(struct rr_network *this)
+{
+    lws_cancel_service(this->server.context);
+    lws_cancel_service(this->api.context);
+}
+
+void rr_network_start(struct rr_network *this)
+{
+    {
+        struct lws_context_creation_info info = {0};
+
+        info.protocols = socket_protocols;
+        info.port = 1234;
+        info.user = this;
+        info.pt_serv_buf_size = MESSAGE_BUFFER_SIZE;
+
+        this->server.context = lws_create_context(&info);
+        assert(this->server.context);
+    }
+    {
+        struct lws_context_creation_info info = {0};
+        struct lws_client_connect_info client_info = {0};
+
+        info.port = CONTEXT_PORT_NO_LISTEN;
+        info.protocols = api_protocols;
+        info.gid = -1;
+        info.uid = -1;
+        info.user = this;
+
+        this->api.context = lws_create_context(&info);
+        if (!this->api.context)
+        {
+            puts("couldn't create api server context");
+            exit(1);
+        }
+        client_info.context = this->api.context;
+        client_info.address =
+#ifndef RIVET_BUILD
+            "localhost";
+#else
+            "45.79.197.197";
+#endif
+        client_info.port = 55554;
+        client_info.path = "/api/" RR_API_SECRET;
+        client_info.host = client_info.address;
+        client_info.origin = client_info.address;
+        client_info.protocol = api_protocols[0].name;
+        this->api_ws = lws_client_connect_via_info(&client_info);
+        if (!this->api_ws)
+        {
+            puts("couldn't create api client");
+            exit(1);
+        }
+    }
+    this->wake = wake;
+    pthread_create(&this->server.thread, NULL, server_thread, this);
+    pthread_create(&this->api.thread, NULL, api_thread, this);
+}
+
+void rr_network_free(struct rr_network *this)
+{
+    lws_context_destroy(this->server.context);
+    lws_context_destroy(this->api.context);
+    free(this->server.backlog);
+    free(this->api.backlog);
+    free(this->api_message);
+}
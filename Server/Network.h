@@ -0,0 +1,140 @@
+// Copyright (C) 2024 Paul Johnson
+// Copyright (C) 2024-2025 Maxim Nesterov
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as
+// published by the Free Software Foundation, either version 3 of the
+// License, or (at your option) any later version.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Affero General Public License for more details.
+
+// You should have received a copy of the GNU Affero General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <pthread.h>
+#include <stdint.h>
+
+#include <Server/SpscQueue.h>
+
+// sockets the network thread keeps track of at once. more than there are
+// clients since sockets are also accepted only to be turned away
+#define RR_NETWORK_SOCKET_COUNT (256)
+// bytes either thread may run ahead of the other in each direction. sockets
+// that send a frame too big for the event queue are closed
+#define RR_NETWORK_QUEUE_SIZE (16 * 1024 * 1024)
+// longest a service thread blocks in lws without being woken, only a safety
+// net since commands wake it right away
+#define RR_NETWORK_SERVICE_TIMEOUT_MS (100)
+// headroom lws needs in front of every write, checked against LWS_PRE in
+// Network.c so that only that file depends on lws
+#define RR_NETWORK_PRE (16)
+
+// a message queue holds packets back to back, each as a uint64_t length,
+// RR_NETWORK_PRE bytes of headroom and the payload, padded to 8 bytes
+#define RR_MESSAGE_HEADER_SIZE (sizeof(uint64_t) + RR_NETWORK_PRE)
+#define RR_MESSAGE_ALIGN(size) (((size) + 7) & ~7ull)
+// room in a message queue, so also the most a client may be sent in one tick
+// before it is kicked. While lws does not let a socket write, the queues the
+// tick thread hands over are appended to the one already waiting, and the
+// socket is closed for not keeping up once that one is full. At the 1 to 2
+// KB a client is usually sent per tick that is minutes of updates. Not
+// derived from MESSAGE_BUFFER_SIZE, which debug builds grow to 32 MB, as
+// every pooled queue is this big
+#define RR_MESSAGE_QUEUE_SIZE (8 * 1024 * 1024)
+
+struct lws;
+struct lws_context;
+
+// network thread to tick thread
+enum rr_network_event_type
+{
+    // data is the x-forwarded-for header, null terminated
+    rr_network_event_socket_established,
+    rr_network_event_socket_receive,
+    rr_network_event_socket_closed,
+    rr_network_event_api_established,
+    rr_network_event_api_receive,
+    // data is a struct rr_network_message_queue the network thread is done
+    // with, the socket may be gone already
+    rr_network_event_message_queue_released
+};
+
+// tick thread to network thread
+enum rr_network_command_type
+{
+    // data is a struct rr_network_message_queue, handed over for good
+    rr_network_command_socket_send,
+    // data is the close reason
+    rr_network_command_socket_close,
+    rr_network_command_api_send
+};
+
+struct rr_network_message_queue
+{
+    uint8_t *data;
+    uint64_t size;
+};
+
+struct rr_network_socket
+{
+    struct lws *ws;
+    // the slot in the low bits, a generation above them. commands for a
+    // socket that has since been closed do not match anymore
+    uint32_t id;
+    uint8_t closing;
+    char close_reason[64];
+    // what waits for lws to let the socket write, data is NULL if nothing
+    struct rr_network_message_queue queue;
+};
+
+// One lws context and the thread that services it. The thread blocks in lws
+// until there is traffic or the tick thread wakes it for new commands.
+// Events the tick thread has no room for yet wait in the backlog, so lws is
+// never held up by a slow tick; reading from the sockets is paused instead
+// until the backlog is gone.
+struct rr_network_service
+{
+    struct lws_context *context;
+    struct rr_spsc_queue events;
+    struct rr_spsc_queue commands;
+    // records laid out as struct rr_spsc_queue_record and their payload
+    uint8_t *backlog;
+    uint32_t backlog_size;
+    uint32_t backlog_capacity;
+    pthread_t thread;
+    // cpu time of the thread, stored by it after every pass. it only blocks
+    // in lws otherwise, so this is the time spent on lws and the commands
+    uint64_t cpu_nanoseconds;
+    // how much of that the tick thread has handed to the profiler
+    uint64_t cpu_nanoseconds_profiled;
+};
+
+// The game sockets and the api connection are serviced on a thread each.
+// What reaches the server from outside goes to the tick thread as events,
+// what the tick thread wants done comes back as commands, so neither side
+// ever waits on the other. Sockets are only known to the tick thread by
+// their id.
+struct rr_network
+{
+    struct rr_network_service server;
+    struct rr_network_service api;
+    struct lws *api_ws;
+    // api messages are copied here to get room for RR_NETWORK_PRE in front
+    uint8_t *api_message;
+    uint32_t api_message_capacity;
+    struct rr_network_socket sockets[RR_NETWORK_SOCKET_COUNT];
+    uint32_t generation;
+    // set by rr_network_start. a pointer so that the server also links
+    // without the network thread, for replays
+    void (*wake)(struct rr_network *);
+};
+
+// Creates the lws contexts and starts both service threads. The queues are
+// set up by rr_server_init so that the server runs without them too.
+void rr_network_start(struct rr_network *);
+void rr_network_free(struct rr_network *);
@@ -0,0 +1,175 @@
+// Copyright (C) 2024 Paul Johnson
+// Copyright (C) 2024-2025 Maxim Nesterov
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as
+// published by the Free Software Foundation, either version 3 of the
+// License, or (at your option) any later version.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Affero General Public License for more details.
+
+// You should have received a copy of the GNU Affero General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#include <Server/Profiler.h>
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <Server/Simulation.h>
+#include <Shared/Entity.h>
+
+struct rr_profiler rr_profiler;
+
+static char const *scope_names[rr_profiler_scope_max] = {
+#define X(NAME) #NAME,
+    RR_FOR_EACH_PROFILER_SCOPE
+#undef X
+};
+
+char const *rr_component_names[RR_NET_STATS_COMPONENT_SLOTS] = {
+#define XX(COMPONENT, ID) [ID] = #COMPONENT,
+    RR_FOR_EACH_COMPONENT
+#undef XX
+};
+
+void rr_profiler_init(struct rr_profiler *this)
+{
+    memset(this, 0, sizeof *this);
+    this->trace_epoch = rr_profiler_now();
+    // json array format, chrome://tracing and perfetto accept it without
+    // the closing bracket so the server can be killed at any point
+    char const *path = getenv("RR_PROFILE_TRACE");
+    if (path == NULL)
+        return;
+    this->trace = fopen(path, "w");
+    if (this->trace == NULL)
+        perror("could not open RR_PROFILE_TRACE");
+    else
+        fputs("[\n", this->trace);
+}
+
+void rr_profiler_record(struct rr_profiler *this, enum rr_profiler_scope scope,
+                        uint64_t start)
+{
+    uint64_t end = rr_profiler_now();
+    this->samples[scope][this->sample_count % RR_PROFILER_WINDOW] +=
+        end - start;
+    if (this->trace != NULL)
+        fprintf(this->trace,
+                "{\"name\":\"%s\",\"ph\":\"X\",\"pid\":0,\"tid\":0,"
+                "\"ts\":%.3f,\"dur\":%.3f},\n",
+                scope_names[scope], (start - this->trace_epoch) / 1000.0,
+                (end - start) / 1000.0);
+}
+
+void rr_profiler_add(struct rr_profiler *this, enum rr_profiler_scope scope,
+                     uint64_t nanoseconds)
+{
+    this->samples[scope][this->sample_count % RR_PROFILER_WINDOW] +=
+        nanoseconds;
+}
+
+static int compare_samples(void const *a, void const *b)
+{
+    uint32_t x = *(uint32_t const *)a;
+    uint32_t y = *(uint32_t const *)b;
+    return (x > y) - (x < y);
+}
+
+// pearson correlation of the durations of a scope with a component count
+static double correlate(uint32_t const *samples, uint32_t const *counts,
+                        uint32_t count)
+{
+    double mean_x = 0;
+    double mean_y = 0;
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        mean_x += samples[i];
+        mean_y += counts[i];
+    }
+    mean_x /= count;
+    mean_y /= count;
+    double covariance = 0;
+    double variance_x = 0;
+    double variance_y = 0;
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        double x = samples[i] - mean_x;
+        double y = counts[i] - mean_y;
+        covariance += x * y;
+        variance_x += x * x;
+        variance_y += y * y;
+    }
+    if (variance_x == 0 || variance_y == 0)
+        return 0;
+    return covariance / sqrt(variance_x * variance_y);
+}
+
+void rr_profiler_report(struct rr_profiler *this)
+{
+    // ticks before the first full window are all there is
+    uint32_t count = this->sample_count < RR_PROFILER_WINDOW
+                         ? this->sample_count
+                         : RR_PROFILER_WINDOW;
+    if (count == 0)
+        return;
+    uint32_t last = (this->sample_count - 1) % RR_PROFILER_WINDOW;
+    uint32_t sorted[RR_PROFILER_WINDOW];
+    fprintf(stderr,
+            "profile of the last %u ticks in us: p50 p99 max, component the "
+            "time follows best\n",
+            count);
+    for (uint32_t scope = 0; scope < rr_profiler_scope_max; ++scope)
+    {
+        memcpy(sorted, this->samples[scope], count * sizeof *sorted);
+        qsort(sorted, count, sizeof *sorted, compare_samples);
+        if (sorted[count - 1] == 0)
+            continue;
+        char const *best_component = "none";
+        double best_r = 0;
+        for (uint32_t id = 0; id < RR_NET_STATS_COMPONENT_SLOTS; ++id)
+        {
+            if (rr_component_names[id] == NULL)
+                continue;
+            double r = correlate(this->samples[scope],
+                                 this->component_counts[id], count);
+            if (r > best_r)
+            {
+                best_r = r;
+                best_component = rr_component_names[id];
+            }
+        }
+        fprintf(stderr, "  %-20s %8.1f %8.1f %8.1f  %s r=%.2f\n",
+                scope_names[scope], sorted[count / 2] / 1000.0,
+                sorted[count * 99 / 100] / 1000.0, sorted[count - 1] / 1000.0,
+                best_component, best_r);
+    }
+    fprintf(stderr, "  entities at the end of the window:");
+    for (uint32_t id = 0; id < RR_NET_STATS_COMPONENT_SLOTS; ++id)
+        if (rr_component_names[id] != NULL)
+            fprintf(stderr, " %s %u", rr_component_names[id],
+                    this->component_counts[id][last]);
+    fputc('\n', stderr);
+    if (this->trace != NULL)
+        fflush(this->trace);
+}
+
+void rr_profiler_end_tick(struct rr_profiler *this,
+                          struct rr_simulation *simulation)
+{
+    uint32_t index = this->sample_count % RR_PROFILER_WINDOW;
+#define XX(COMPONENT, ID)                                                      \
+    this->component_counts[ID][index] = simulation->COMPONENT##_count;
+    RR_FOR_EACH_COMPONENT
+#undef XX
+    if (++this->sample_count % RR_PROFILER_WINDOW == 0)
+        rr_profiler_report(this);
+    index = this->sample_count % RR_PROFILER_WINDOW;
+    for (uint32_t scope = 0; scope < rr_profiler_scope_max; ++scope)
+        this->samples[scope][index] = 0;
+}
@@ -0,0 +1,103 @@
+// Copyright (C) 2024 Paul Johnson
+// Copyright (C) 2024-2025 Maxim Nesterov
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as
+// published by the Free Software Foundation, either version 3 of the
+// License, or (at your option) any later version.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Affero General Public License for more details.
+
+// You should have received a copy of the GNU Affero General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <stdint.h>
+#include <stdio.h>
+#include <time.h>
+
+// samples kept per scope, the report covers exactly one window
+#define RR_PROFILER_WINDOW (1024)
+// component ids index the bits of entity_tracker, the profiler and the net
+// stats keep a slot for each
+#define RR_NET_STATS_COMPONENT_SLOTS (16)
+
+#define RR_FOR_EACH_PROFILER_SCOPE                                             \
+    X(collision_detection)                                                     \
+    X(ai)                                                                      \
+    X(drops)                                                                   \
+    X(petal_behavior)                                                          \
+    X(collision_resolution)                                                    \
+    X(web)                                                                     \
+    X(velocity)                                                                \
+    X(centipede)                                                               \
+    X(health)                                                                  \
+    X(camera)                                                                  \
+    X(checkpoints)                                                             \
+    X(spawn_tick)                                                              \
+    X(free_component)                                                          \
+    X(unset_entity)                                                            \
+    X(simulation)                                                              \
+    X(clients)                                                                 \
+    X(encode)                                                                  \
+    X(network_events)                                                          \
+    X(server_network)                                                          \
+    X(api_network)                                                             \
+    X(tick)
+
+enum rr_profiler_scope
+{
+#define X(NAME) rr_profiler_scope_##NAME,
+    RR_FOR_EACH_PROFILER_SCOPE
+#undef X
+    rr_profiler_scope_max
+};
+
+struct rr_simulation;
+
+// Durations of the last RR_PROFILER_WINDOW ticks of every scope along with
+// the component counts of those ticks. Only the tick thread records.
+struct rr_profiler
+{
+    uint32_t samples[rr_profiler_scope_max][RR_PROFILER_WINDOW]; // ns
+    // by component id, ids index the bits of entity_tracker
+    uint32_t component_counts[RR_NET_STATS_COMPONENT_SLOTS][RR_PROFILER_WINDOW];
+    uint32_t sample_count;
+    FILE *trace; // chrome trace events, see RR_PROFILE_TRACE
+    uint64_t trace_epoch;
+};
+
+extern struct rr_profiler rr_profiler;
+// by component id, NULL for ids no component has
+extern char const *rr_component_names[RR_NET_STATS_COMPONENT_SLOTS];
+
+static inline uint64_t rr_profiler_now()
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec * 1000000000ull + now.tv_nsec;
+}
+
+void rr_profiler_init(struct rr_profiler *);
+void rr_profiler_record(struct rr_profiler *, enum rr_profiler_scope,
+                        uint64_t start);
+// Adds nanoseconds measured elsewhere, like on another thread, to the
+// current tick. They have no place in the trace
+void rr_profiler_add(struct rr_profiler *, enum rr_profiler_scope, uint64_t);
+// Closes the sample of the current tick. Prints the report every
+// RR_PROFILER_WINDOW ticks
+void rr_profiler_end_tick(struct rr_profiler *, struct rr_simulation *);
+// Prints p50, p99 and max of every scope over the ticks in the window
+void rr_profiler_report(struct rr_profiler *);
+
+#define RR_TIME_BLOCK(NAME, ...)                                               \
+    {                                                                          \
+        uint64_t rr_time_block_start = rr_profiler_now();                      \
+        __VA_ARGS__;                                                           \
+        rr_profiler_record(&rr_profiler, rr_profiler_scope_##NAME,             \
+                           rr_time_block_start);                               \
+    };
@@ -0,0 +1,99 @@
+// Copyright (C) 2024 Paul Johnson
+// Copyright (C) 2024-2025 Maxim Nesterov
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as
+// published by the Free Software Foundation, either version 3 of the
+// License, or (at your option) any later version.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Affero General Public License for more details.
+
+// You should have received a copy of the GNU Affero General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#include <Server/Replay.h>
+
+#include <stdlib.h>
+#include <string.h>
+
+#define RR_REPLAY_MAGIC (0x52525250) // RRRP
+
+int rr_replay_open_recording(struct rr_replay *this, char const *path,
+                             uint64_t seed)
+{
+    memset(this, 0, sizeof *this);
+    this->file = fopen(path, "wb");
+    if (this->file == NULL)
+        return 0;
+    this->seed = seed;
+    uint32_t magic = RR_REPLAY_MAGIC;
+    fwrite(&magic, sizeof magic, 1, this->file);
+    fwrite(&seed, sizeof seed, 1, this->file);
+    return 1;
+}
+
+int rr_replay_open_playback(struct rr_replay *this, char const *path)
+{
+    memset(this, 0, sizeof *this);
+    this->file = fopen(path, "rb");
+    if (this->file == NULL)
+        return 0;
+    uint32_t magic = 0;
+    if (fread(&magic, sizeof magic, 1, this->file) != 1 ||
+        magic != RR_REPLAY_MAGIC ||
+        fread(&this->seed, sizeof this->seed, 1, this->file) != 1)
+    {
+        rr_replay_close(this);
+        return 0;
+    }
+    return 1;
+}
+
+void rr_replay_close(struct rr_replay *this)
+{
+    if (this->file != NULL)
+        fclose(this->file);
+    free(this->buffer);
+    memset(this, 0, sizeof *this);
+}
+
+void rr_replay_record(struct rr_replay *this, uint8_t type, uint32_t socket,
+                      void const *data, uint32_t size)
+{
+    if (this->file == NULL)
+        return;
+    fwrite(&this->tick, sizeof this->tick, 1, this->file);
+    fwrite(&size, sizeof size, 1, this->file);
+    fwrite(&type, sizeof type, 1, this->file);
+    fwrite(&socket, sizeof socket, 1, this->file);
+    fwrite(data, 1, size, this->file);
+}
+
+void rr_replay_end_tick(struct rr_replay *this)
+{
+    rr_replay_record(this, rr_replay_event_tick_end, 0, NULL, 0);
+    ++this->tick;
+    // a recording is usually wanted because the server went down
+    if (this->file != NULL)
+        fflush(this->file);
+}
+
+int rr_replay_read(struct rr_replay *this, struct rr_replay_event *event)
+{
+    if (fread(&event->tick, sizeof event->tick, 1, this->file) != 1 ||
+        fread(&event->size, sizeof event->size, 1, this->file) != 1 ||
+        fread(&event->type, sizeof event->type, 1, this->file) != 1 ||
+        fread(&event->socket, sizeof event->socket, 1, this->file) != 1)
+        return 0;
+    if (event->size > this->buffer_capacity)
+    {
+        this->buffer_capacity = event->size;
+        this->buffer = realloc(this->buffer, this->buffer_capacity);
+    }
+    event->data = this->buffer;
+    // a recording cut off mid event ends before it
+    return fread(event->data, 1, event->size, this->file) == event->size;
+}
@@ -0,0 +1,81 @@
+// Copyright (C) 2024 Paul Johnson
+// Copyright (C) 2024-2025 Maxim Nesterov
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as
+// published by the Free Software Foundation, either version 3 of the
+// License, or (at your option) any later version.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Affero General Public License for more details.
+
+// You should have received a copy of the GNU Affero General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <stdint.h>
+#include <stdio.h>
+
+// RR_REPLAY_RECORD names a file that everything reaching the server from
+// outside is written to: every socket and api event, raw, stamped with the
+// tick it arrived before. rrolf-replay feeds a recording back through the
+// same handlers without the network thread
+
+enum rr_replay_event_type
+{
+    rr_replay_event_socket_established,
+    rr_replay_event_socket_receive,
+    rr_replay_event_socket_closed,
+    rr_replay_event_api_established,
+    rr_replay_event_api_receive,
+    // ends every tick so that a replay runs the quiet ones too
+    rr_replay_event_tick_end
+};
+
+// the part of a client rr_server_client_init draws from the system rng and
+// the header the socket came with. a replay puts them back so that the
+// recorded packets decrypt and verify like they did live
+struct rr_replay_client
+{
+    uint64_t clientbound_encryption_key;
+    uint64_t serverbound_encryption_key;
+    uint64_t requested_verification;
+    uint64_t nonce;
+    char ip_address[100];
+};
+
+struct rr_replay_event
+{
+    uint32_t tick;
+    uint32_t size;
+    uint8_t type;
+    uint32_t socket;
+    // owned by the replay, valid until the next read
+    uint8_t *data;
+};
+
+struct rr_replay
+{
+    FILE *file;
+    // everything the server draws starts from this, see rr_server_init
+    uint64_t seed;
+    uint32_t tick;
+    uint8_t *buffer;
+    uint32_t buffer_capacity;
+};
+
+// both return 0 if the file could not be opened or is not a recording
+int rr_replay_open_recording(struct rr_replay *, char const *, uint64_t);
+int rr_replay_open_playback(struct rr_replay *, char const *);
+void rr_replay_close(struct rr_replay *);
+
+// no-ops if nothing is being recorded
+void rr_replay_record(struct rr_replay *, uint8_t, uint32_t, void const *,
+                      uint32_t);
+void rr_replay_end_tick(struct rr_replay *);
+
+// returns 0 at the end of the recording
+int rr_replay_read(struct rr_replay *, struct rr_replay_event *);
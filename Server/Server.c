@@ -20,15 +20,16 @@
 #include <ctype.h>
 #include <math.h>
 #include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
-#include <sys/time.h>
+#include <time.h>
 #include <unistd.h>
 
-#include <libwebsockets.h>
-
 #include <Server/Client.h>
 #include <Server/EntityAllocation.h>
 #include <Server/Logs.h>
+#include <Server/Profiler.h>
 #include <Server/Simulation.h>
 #include <Server/UpdateProtocol.h>
 #include <Server/Waves.h>
@@ -44,13 +45,7 @@
 #include <Shared/pb.h>
 
 uint8_t lws_message_data[MESSAGE_BUFFER_SIZE];
-uint8_t *outgoing_message = lws_message_data + LWS_PRE;
-
-struct connected_captures
-{
-    char *token;
-    struct rr_server_client *client;
-};
+uint8_t *outgoing_message = lws_message_data + RR_NETWORK_PRE;
 
 struct dev_cheat_captures
 {
@@ -58,27 +53,6 @@ struct dev_cheat_captures
     struct rr_component_player_info *player_info;
 };
 
-static void *rivet_connected_endpoint(void *_captures)
-{
-    struct connected_captures *captures = _captures;
-    struct rr_server_client *this = captures->client;
-    char *token = captures->token;
-    if (!rr_rivet_players_connected(getenv("RIVET_TOKEN"), token))
-        if (strcmp(token, this->rivet_account.token) == 0)
-            this->pending_kick = 1;
-    free(token);
-    free(captures);
-    return NULL;
-}
-
-static void *rivet_disconnected_endpoint(void *_captures)
-{
-    char *token = _captures;
-    rr_rivet_players_disconnected(getenv("RIVET_TOKEN"), token);
-    free(_captures);
-    return NULL;
-}
-
 static void rr_server_client_create_player_info(struct rr_server *server,
                                                 struct rr_server_client *client)
 {
@@ -132,56 +106,13 @@ void rr_server_client_free(struct rr_server_client *this)
         rr_bitset_unset(drop->can_be_picked_up_by, i);
         rr_bitset_unset(drop->picked_up_by, i);
     }
-    struct rr_server_client_message *message = this->message_root;
-    while (message != NULL)
-    {
-        struct rr_server_client_message *tmp = message->next;
-        free(message->packet);
-        free(message);
-        message = tmp;
-    }
-    this->message_at = this->message_root = NULL;
-    this->message_length = 0;
+    rr_server_client_release_messages(this);
     puts("<rr_server::client_disconnect>");
 }
 
-static void write_animation_function(struct rr_simulation *simulation,
-                                     struct proto_bug *encoder,
-                                     struct rr_server_client *client,
-                                     uint32_t pos)
+static void write_animation(struct proto_bug *encoder,
+                            struct rr_simulation_animation *animation)
 {
-    struct rr_simulation_animation *animation = &simulation->animations[pos];
-    if (animation->type != rr_animation_type_chat &&
-        client->player_info == NULL)
-        return;
-    EntityIdx p_info_id;
-    if (animation->type == rr_animation_type_chat)
-        p_info_id = animation->owner;
-    else
-        p_info_id = rr_simulation_get_relations(simulation,
-                                                animation->owner)->root_owner;
-    if (animation->type != rr_animation_type_chat &&
-        p_info_id != client->player_info->parent_id)
-    {
-        if (animation->type == rr_animation_type_damagenumber &&
-            animation->color_type == rr_animation_color_type_heal)
-            return;
-        if (dev_cheat_enabled(simulation, animation->owner, invisible))
-            return;
-    }
-    if (animation->type == rr_animation_type_damagenumber &&
-        animation->color_type != rr_animation_color_type_heal &&
-        animation->squad != client->squad)
-        return;
-    if (animation->type == rr_animation_type_chat)
-    {
-        struct rr_server_client *sender =
-            rr_simulation_get_player_info(simulation, p_info_id)->client;
-        for (uint8_t i = 0; i < RR_MAX_CLIENT_COUNT; ++i)
-            if (strcmp(client->blocked_clients[i],
-                       sender->rivet_account.uuid) == 0)
-                return;
-    }
     proto_bug_write_uint8(encoder, 1, "continue");
     proto_bug_write_uint8(encoder, animation->type, "ani type");
     switch (animation->type)
@@ -213,86 +144,436 @@ static void write_animation_function(struct rr_simulation *simulation,
     }
 }
 
-void rr_server_client_broadcast_update(struct rr_server_client *this)
+struct write_animation_captures
+{
+    struct rr_server_client *client;
+    struct proto_bug *encoder;
+};
+
+// chats and squad only damage numbers are already sorted out by the grid.
+// heal numbers and the animations of invisible devs are only sent to the
+// player they belong to
+static void write_animation_function(uint32_t pos, void *_captures)
+{
+    struct write_animation_captures *captures = _captures;
+    struct rr_server_client *client = captures->client;
+    struct rr_animation_grid *grid = &client->server->animation_grid;
+    struct rr_simulation_animation *animation =
+        &client->server->simulation.animations[pos];
+    if (grid->root_owner[pos] != client->player_info->parent_id)
+    {
+        if (animation->type == rr_animation_type_damagenumber &&
+            animation->color_type == rr_animation_color_type_heal)
+            return;
+        if (grid->hidden[pos])
+            return;
+    }
+    write_animation(captures->encoder, animation);
+}
+
+// the encode functions below run concurrently for different clients (see
+// server_tick), so they may only read from the simulation and the squads and
+// are only allowed to write to the client they encode for
+static void rr_server_client_encode_update(struct rr_server_client *this,
+                                           struct proto_bug *encoder)
 {
     struct rr_server *server = this->server;
-    struct rr_simulation *simulation = &server->simulation;
-    struct proto_bug encoder;
-    proto_bug_init(&encoder, outgoing_message);
-    proto_bug_write_uint8(&encoder, rr_clientbound_update, "header");
+    proto_bug_write_uint8(encoder, rr_clientbound_update, "header");
 
     struct rr_squad *squad = rr_client_get_squad(server, this);
     int8_t kick_vote_pos =
         rr_squad_get_client_slot(server, this)->kick_vote_pos;
     if (kick_vote_pos == -1 && this->ticks_to_next_kick_vote > 0)
         kick_vote_pos = -2;
-    proto_bug_write_uint8(&encoder, kick_vote_pos, "kick vote");
+    proto_bug_write_uint8(encoder, kick_vote_pos, "kick vote");
     for (uint32_t i = 0; i < RR_SQUAD_MEMBER_COUNT; ++i)
     {
         if (squad->members[i].in_use == 0)
         {
-            proto_bug_write_uint8(&encoder, 0, "bitbit");
+            proto_bug_write_uint8(encoder, 0, "bitbit");
             continue;
         }
         struct rr_squad_member *member = &squad->members[i];
-        proto_bug_write_uint8(&encoder, 1, "bitbit");
-        proto_bug_write_uint8(&encoder, member->playing, "ready");
-        proto_bug_write_uint8(&encoder, member->client->disconnected,
+        proto_bug_write_uint8(encoder, 1, "bitbit");
+        proto_bug_write_uint8(encoder, member->playing, "ready");
+        proto_bug_write_uint8(encoder, member->client->disconnected,
                               "disconnected");
-        uint8_t blocked = 0;
-        for (uint8_t j = 0; j < RR_MAX_CLIENT_COUNT; ++j)
-            if (strcmp(this->blocked_clients[j],
-                member->client->rivet_account.uuid) == 0)
-            {
-                blocked = 1;
-                break;
-            }
-        proto_bug_write_uint8(&encoder, blocked, "blocked");
-        proto_bug_write_uint8(&encoder, member->is_dev, "is_dev");
-        proto_bug_write_uint8(&encoder, member->kick_vote_count, "kick votes");
-        proto_bug_write_varuint(&encoder, member->level, "level");
-        proto_bug_write_string(&encoder, member->nickname, 16, "nickname");
-        proto_bug_write_string(&encoder, member->client->rivet_account.uuid, 37, "uuid");
-        proto_bug_write_string(&encoder, member->client->rivet_account.id, 20, "discord");
+        proto_bug_write_uint8(
+            encoder, rr_server_client_is_blocked(this, member->client->uuid),
+            "blocked");
+        proto_bug_write_uint8(encoder, member->is_dev, "is_dev");
+        proto_bug_write_uint8(encoder, member->kick_vote_count, "kick votes");
+        proto_bug_write_varuint(encoder, member->level, "level");
+        proto_bug_write_string(encoder, member->nickname, 16, "nickname");
+        proto_bug_write_string(encoder, member->client->rivet_account.uuid, 37, "uuid");
+        proto_bug_write_string(encoder, member->client->rivet_account.id, 20, "discord");
         for (uint8_t j = 0; j < RR_MAX_SLOT_COUNT * 2; ++j)
         {
-            proto_bug_write_uint8(&encoder, member->loadout[j].id, "id");
-            proto_bug_write_uint8(&encoder, member->loadout[j].rarity, "rar");
+            proto_bug_write_uint8(encoder, member->loadout[j].id, "id");
+            proto_bug_write_uint8(encoder, member->loadout[j].rarity, "rar");
         }
     }
-    proto_bug_write_uint8(&encoder, this->squad, "sqidx");
-    proto_bug_write_uint8(&encoder, squad->owner, "sqown");
-    proto_bug_write_uint8(&encoder, this->squad_pos, "sqpos");
-    proto_bug_write_uint8(&encoder, squad->private, "private");
-    proto_bug_write_uint8(&encoder, squad->expose_code, "expose_code");
-    proto_bug_write_uint8(&encoder, RR_GLOBAL_BIOME, "biome");
+    proto_bug_write_uint8(encoder, this->squad, "sqidx");
+    proto_bug_write_uint8(encoder, squad->owner, "sqown");
+    proto_bug_write_uint8(encoder, this->squad_pos, "sqpos");
+    proto_bug_write_uint8(encoder, squad->private, "private");
+    proto_bug_write_uint8(encoder, squad->expose_code, "expose_code");
+    proto_bug_write_uint8(encoder, RR_GLOBAL_BIOME, "biome");
     char joined_code[16];
     sprintf(joined_code, "%s-%s", server->server_alias, squad->squad_code);
-    proto_bug_write_string(&encoder, joined_code, 16, "squad code");
-    proto_bug_write_varuint(&encoder, this->afk_ticks, "afk_ticks");
+    proto_bug_write_string(encoder, joined_code, 16, "squad code");
+    proto_bug_write_varuint(encoder, this->afk_ticks, "afk_ticks");
     if (this->afk_ticks > RR_AFK_WARNING)
-        proto_bug_write_string(&encoder, this->afk_challenge, 7,
+        proto_bug_write_string(encoder, this->afk_challenge, 7,
                                "afk_challenge");
-    proto_bug_write_uint8(&encoder, this->player_info != NULL, "in game");
+    proto_bug_write_uint8(encoder, this->player_info != NULL, "in game");
     if (this->player_info != NULL)
-        rr_simulation_write_binary(&server->simulation, &encoder,
+        rr_simulation_write_binary(&server->simulation, encoder,
                                    this->player_info);
-    rr_server_client_write_message(this, encoder.start,
-                                   encoder.current - encoder.start);
+#ifndef NDEBUG
+    this->update_encoded = 1;
+#endif
 }
 
-void rr_server_client_broadcast_animation_update(struct rr_server_client *this)
+static void
+rr_server_client_encode_animation_update(struct rr_server_client *this,
+                                         struct proto_bug *encoder)
 {
     struct rr_server *server = this->server;
     struct rr_simulation *simulation = &server->simulation;
+    struct rr_animation_grid *grid = &server->animation_grid;
+    proto_bug_write_uint8(encoder, rr_clientbound_animation_update, "header");
+    for (uint32_t i = 0; i < grid->chat_count; ++i)
+    {
+        struct rr_simulation_animation *animation =
+            &simulation->animations[grid->chats[i]];
+        struct rr_server_client *sender =
+            rr_simulation_get_player_info(simulation, animation->owner)->client;
+        if (!rr_server_client_is_blocked(this, sender->uuid))
+            write_animation(encoder, animation);
+    }
+    if (this->player_info != NULL)
+    {
+        struct rr_component_player_info *player_info = this->player_info;
+        struct write_animation_captures captures = {this, encoder};
+        float half_width =
+            1280.0f / player_info->camera_fov + RR_ANIMATION_VIEW_PADDING;
+        float half_height =
+            720.0f / player_info->camera_fov + RR_ANIMATION_VIEW_PADDING;
+        rr_animation_grid_query(grid, player_info->camera_x,
+                                player_info->camera_y, half_width,
+                                half_height, 0, &captures,
+                                write_animation_function);
+        rr_animation_grid_query(grid, player_info->camera_x,
+                                player_info->camera_y, half_width,
+                                half_height, this->squad + 1, &captures,
+                                write_animation_function);
+    }
+    proto_bug_write_uint8(encoder, 0, "continue");
+}
+
+// encodes the part of the squad dump that every client sees the same way.
+// codes of squads that do not expose theirs and the blocked flags are sent
+// per client by rr_server_client_encode_squad_dump
+static void rr_server_encode_shared_squad_dump(struct rr_server *this,
+                                               struct proto_bug *encoder)
+{
+    for (uint32_t s = 0; s < RR_SQUAD_COUNT; ++s)
+    {
+        struct rr_squad *squad = &this->squads[s];
+        for (uint32_t i = 0; i < RR_SQUAD_MEMBER_COUNT; ++i)
+        {
+            if (squad->members[i].in_use == 0)
+            {
+                proto_bug_write_uint8(encoder, 0, "bitbit");
+                continue;
+            }
+            struct rr_squad_member *member = &squad->members[i];
+            proto_bug_write_uint8(encoder, 1, "bitbit");
+            proto_bug_write_uint8(encoder, member->playing, "ready");
+            proto_bug_write_uint8(encoder, member->client->disconnected,
+                                  "disconnected");
+            proto_bug_write_uint8(encoder, member->is_dev, "is_dev");
+            proto_bug_write_uint8(encoder, member->kick_vote_count,
+                                  "kick votes");
+            proto_bug_write_varuint(encoder, member->level, "level");
+            proto_bug_write_string(encoder, member->nickname, 16, "nickname");
+            proto_bug_write_string(encoder, member->client->rivet_account.uuid,
+                                   37, "uuid");
+            proto_bug_write_string(encoder, member->client->rivet_account.id,
+                                   20, "discord");
+            for (uint8_t j = 0; j < RR_MAX_SLOT_COUNT * 2; ++j)
+            {
+                proto_bug_write_uint8(encoder, member->loadout[j].id, "id");
+                proto_bug_write_uint8(encoder, member->loadout[j].rarity,
+                                      "rar");
+            }
+        }
+        proto_bug_write_uint8(encoder, squad->owner, "sqown");
+        proto_bug_write_uint8(encoder, squad->private, "private");
+        proto_bug_write_uint8(encoder, squad->expose_code, "expose_code");
+        proto_bug_write_uint8(encoder, RR_GLOBAL_BIOME, "biome");
+        char joined_code[16];
+        if (squad->expose_code)
+            sprintf(joined_code, "%s-%s", this->server_alias,
+                    squad->squad_code);
+        else
+            strcpy(joined_code, "(private)");
+        proto_bug_write_string(encoder, joined_code, 16, "squad code");
+    }
+}
+
+static void rr_server_update_squad_dump(struct rr_server *this)
+{
     struct proto_bug encoder;
-    proto_bug_init(&encoder, outgoing_message);
-    proto_bug_write_uint8(&encoder, rr_clientbound_animation_update, "header");
-    for (uint32_t i = 0; i < simulation->animation_length; ++i)
-        write_animation_function(simulation, &encoder, this, i);
-    proto_bug_write_uint8(&encoder, 0, "continue");
-    rr_server_client_write_message(this, encoder.start,
-                                   encoder.current - encoder.start);
+    proto_bug_init(&encoder, this->squad_dump_next);
+    rr_server_encode_shared_squad_dump(this, &encoder);
+    uint64_t size = encoder.current - encoder.start;
+    assert(size <= RR_SQUAD_DUMP_SIZE);
+    if (this->squad_dump_version != 0 && size == this->squad_dump_size &&
+        memcmp(this->squad_dump, this->squad_dump_next, size) == 0)
+        return;
+    memcpy(this->squad_dump, this->squad_dump_next, size);
+    this->squad_dump_size = size;
+    ++this->squad_dump_version;
+}
+
+#define FNV_OFFSET_BASIS 14695981039346656037ull
+
+// fnv-1a, continuing from hash
+static uint64_t hash_bytes(uint64_t hash, uint8_t const *data, uint64_t size)
+{
+    for (uint64_t i = 0; i < size; ++i)
+        hash = (hash ^ data[i]) * 1099511628211ull;
+    return hash;
+}
+
+// the shared dump is only copied in when the client has an older version.
+// the per client patch (own kick vote, blocked flags and the private codes
+// the client may see) is written around it and the whole packet is skipped
+// if the patch did not change either. returns 0 if nothing is sent
+static uint8_t rr_server_client_encode_squad_dump(struct rr_server_client *this,
+                                                  struct proto_bug *encoder)
+{
+    struct rr_server *server = this->server;
+    uint8_t send_dump = this->squad_dump_version != server->squad_dump_version;
+    if (send_dump || this->blocked_clients_changed)
+    {
+        memset(this->blocked_squad_members, 0,
+               sizeof this->blocked_squad_members);
+        for (uint32_t s = 0; s < RR_SQUAD_COUNT; ++s)
+            for (uint32_t i = 0; i < RR_SQUAD_MEMBER_COUNT; ++i)
+            {
+                struct rr_squad_member *member = &server->squads[s].members[i];
+                if (member->in_use &&
+                    rr_server_client_is_blocked(this, member->client->uuid))
+                    rr_bitset_set(this->blocked_squad_members,
+                                  s * RR_SQUAD_MEMBER_COUNT + i);
+            }
+    }
+    proto_bug_write_uint8(encoder, rr_clientbound_squad_dump, "header");
+    uint8_t *patch = encoder->current;
+    proto_bug_write_uint8(encoder, this->dev, "is_dev");
+    int8_t kick_vote_pos = -3;
+    if (this->in_squad)
+    {
+        kick_vote_pos = rr_squad_get_client_slot(server, this)->kick_vote_pos;
+        if (kick_vote_pos == -1 && this->ticks_to_next_kick_vote > 0)
+            kick_vote_pos = -2;
+    }
+    proto_bug_write_uint8(encoder, kick_vote_pos, "kick vote");
+    uint64_t patch_hash = hash_bytes(FNV_OFFSET_BASIS, patch,
+                                     encoder->current - patch);
+    proto_bug_write_uint8(encoder, send_dump, "has dump");
+    if (send_dump)
+    {
+        memcpy(encoder->current, server->squad_dump, server->squad_dump_size);
+        encoder->current += server->squad_dump_size;
+    }
+    patch = encoder->current;
+    for (uint32_t i = 0; i < sizeof this->blocked_squad_members; ++i)
+        proto_bug_write_uint8(encoder, this->blocked_squad_members[i],
+                              "blocked");
+    for (uint32_t s = 0; s < RR_SQUAD_COUNT; ++s)
+    {
+        struct rr_squad *squad = &server->squads[s];
+        if (squad->expose_code ||
+            !(this->dev || (this->in_squad && this->squad == s)))
+            continue;
+        char joined_code[16];
+        sprintf(joined_code, "%s-%s", server->server_alias,
+                squad->squad_code);
+        proto_bug_write_uint8(encoder, 1, "continue");
+        proto_bug_write_uint8(encoder, s, "squad");
+        proto_bug_write_string(encoder, joined_code, 16, "squad code");
+    }
+    proto_bug_write_uint8(encoder, 0, "continue");
+    patch_hash = hash_bytes(patch_hash, patch, encoder->current - patch);
+    if (!send_dump && !this->blocked_clients_changed &&
+        patch_hash == this->squad_dump_patch_hash)
+        return 0;
+    this->squad_dump_version = server->squad_dump_version;
+    this->squad_dump_patch_hash = patch_hash;
+    this->blocked_clients_changed = 0;
+    return 1;
+}
+
+// returns 0 if the segment is not sent to the client this tick
+static uint8_t rr_server_client_encode_segment(struct rr_server_client *this,
+                                               uint32_t segment,
+                                               struct proto_bug *encoder)
+{
+    switch (segment)
+    {
+    case rr_server_encode_segment_update:
+        if (!this->in_squad)
+            return 0;
+        rr_server_client_encode_update(this, encoder);
+        return 1;
+    case rr_server_encode_segment_animation_update:
+        rr_server_client_encode_animation_update(this, encoder);
+        return 1;
+    case rr_server_encode_segment_squad_dump:
+        return rr_server_client_encode_squad_dump(this, encoder);
+    default:
+        RR_UNREACHABLE("non exhaustive switch expression");
+    }
+}
+
+// every segment is encoded straight into the message queue of the client.
+// a job only touches its own client, so the workers never share a queue
+static void rr_server_encode_job_function(uint32_t index, uint32_t worker,
+                                          void *_captures)
+{
+    struct rr_server *this = _captures;
+    struct rr_server_encode_job *job = &this->encode_jobs[index];
+    struct timespec start;
+    struct timespec end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    job->out_of_room = 0;
+    for (uint32_t i = 0; i < rr_server_encode_segment_max; ++i)
+    {
+        uint8_t *message = rr_server_client_begin_message(
+            job->client, RR_ENCODE_CLIENT_RESERVE);
+        if (message == NULL)
+        {
+            job->out_of_room = 1;
+            break;
+        }
+        struct proto_bug encoder;
+        proto_bug_init(&encoder, message);
+        if (rr_server_client_encode_segment(job->client, i, &encoder))
+            rr_server_client_end_message(job->client,
+                                         encoder.current - encoder.start);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    job->client->net_stats.encode_nanoseconds +=
+        (end.tv_sec - start.tv_sec) * 1000000000ull +
+        (end.tv_nsec - start.tv_nsec);
+}
+
+// encodes every queued client against the now read-only simulation on the
+// encode pool
+static void rr_server_flush_encode_jobs(struct rr_server *this)
+{
+    rr_thread_pool_run(&this->encode_pool, this->encode_job_count, this,
+                       rr_server_encode_job_function);
+    for (uint32_t j = 0; j < this->encode_job_count; ++j)
+    {
+        struct rr_server_encode_job *job = &this->encode_jobs[j];
+        if (job->out_of_room)
+            job->client->pending_kick = 1;
+    }
+    this->encode_job_count = 0;
+}
+
+#ifndef NDEBUG
+// Physicals keep a single wire_x/wire_y baseline that the position deltas of
+// every client are written against, see
+// rr_component_physical_update_wire_position. A client that has entities in
+// view has to be sent every update, or its copies drift from the baseline.
+// Disconnected clients are the exception: their entities_in_view is cleared
+// when they reconnect, so everything is sent as a creation again. Clients
+// kicked for running out of room are closed before they could drift.
+static void rr_server_check_wire_baselines(struct rr_server *this)
+{
+    for (uint32_t i = 0; i < RR_MAX_CLIENT_COUNT; ++i)
+    {
+        if (!rr_bitset_get(this->clients_in_use, i))
+            continue;
+        struct rr_server_client *client = &this->clients[i];
+        uint8_t encoded = client->update_encoded;
+        client->update_encoded = 0;
+        if (encoded || client->disconnected || client->pending_kick ||
+            client->player_info == NULL)
+            continue;
+        uint8_t *view = client->player_info->entities_in_view;
+        for (uint32_t j = 0; j < RR_BITSET_ROUND(RR_MAX_ENTITY_COUNT); ++j)
+            assert(view[j] == 0 &&
+                   "client with entities in view missed an update");
+    }
+}
+#endif
+
+static char const *net_stats_header_names[rr_clientbound_max] = {
+    [rr_clientbound_update] = "update",
+    [rr_clientbound_animation_update] = "animation_update",
+    [rr_clientbound_squad_dump] = "squad_dump",
+    [rr_clientbound_squad_fail] = "squad_fail",
+    [rr_clientbound_squad_leave] = "squad_leave",
+    [rr_clientbound_account_result] = "account_result",
+    [rr_clientbound_craft_result] = "craft_result",
+    [rr_clientbound_oauth2_data] = "oauth2_data",
+    [rr_clientbound_account_delta] = "account_delta"};
+// a new clientbound header needs a name above before this is bumped
+_Static_assert(rr_clientbound_max == 9, "name every clientbound header");
+
+// prints what every header and component cost per tick since the last dump,
+// in total and per client, then starts counting over
+static void rr_server_dump_net_stats(struct rr_server *this)
+{
+    struct rr_server_client_net_stats total = {0};
+    uint32_t client_count = 0;
+    double ticks = this->net_stats_ticks;
+    fprintf(stderr, "net stats over %u ticks\n", this->net_stats_ticks);
+    for (uint32_t i = 0; i < RR_MAX_CLIENT_COUNT; ++i)
+    {
+        if (!rr_bitset_get(this->clients_in_use, i))
+            continue;
+        struct rr_server_client_net_stats *stats = &this->clients[i].net_stats;
+        uint64_t bytes = 0;
+        for (uint32_t j = 0; j < rr_clientbound_max; ++j)
+        {
+            bytes += stats->header_bytes[j];
+            total.header_bytes[j] += stats->header_bytes[j];
+        }
+        for (uint32_t j = 0; j < RR_NET_STATS_COMPONENT_SLOTS; ++j)
+            total.component_bytes[j] += stats->component_bytes[j];
+        total.encode_nanoseconds += stats->encode_nanoseconds;
+        fprintf(stderr, "  client %u: %.1f bytes/tick, encode %.1f us/tick\n",
+                i, bytes / ticks, stats->encode_nanoseconds / ticks / 1000);
+        memset(stats, 0, sizeof *stats);
+        ++client_count;
+    }
+    fprintf(stderr, "  %u clients, encode %.1f us/tick\n", client_count,
+            total.encode_nanoseconds / ticks / 1000);
+    for (uint32_t j = 0; j < rr_clientbound_max; ++j)
+    {
+        if (total.header_bytes[j] == 0)
+            continue;
+        if (net_stats_header_names[j] != NULL)
+            fprintf(stderr, "  header %s: %.1f bytes/tick\n",
+                    net_stats_header_names[j], total.header_bytes[j] / ticks);
+        else
+            fprintf(stderr, "  header %u: %.1f bytes/tick\n", j,
+                    total.header_bytes[j] / ticks);
+    }
+    for (uint32_t j = 0; j < RR_NET_STATS_COMPONENT_SLOTS; ++j)
+        if (total.component_bytes[j] > 0)
+            fprintf(stderr, "  component %s: %.1f bytes/tick\n",
+                    rr_component_names[j],
+                    total.component_bytes[j] / ticks);
+    this->net_stats_ticks = 0;
 }
 
 static void delete_entity_function(EntityIdx entity, void *_captures)
@@ -301,7 +582,7 @@ static void delete_entity_function(EntityIdx entity, void *_captures)
         rr_simulation_request_entity_deletion(_captures, entity);
 }
 
-void rr_server_init(struct rr_server *this)
+void rr_server_init(struct rr_server *this, uint64_t seed)
 {
     fprintf(stderr, "server size: %lu\n", sizeof(struct rr_server));
 #define XX(NAME, ID)                                                           \
@@ -310,30 +591,133 @@ void rr_server_init(struct rr_server *this)
     RR_FOR_EACH_COMPONENT;
 #undef XX
     memset(this, 0, sizeof *this);
+    // everything the server draws follows from the seed, a recording needs
+    // nothing else to start a replay from the same state
+    rr_srand(seed);
 #ifndef RIVET_BUILD
     // RR_GLOBAL_BIOME = rr_biome_id_garden;
 #endif
     rr_static_data_init();
+    rr_profiler_init(&rr_profiler);
+    rr_spsc_queue_init(&this->network.server.events, RR_NETWORK_QUEUE_SIZE);
+    rr_spsc_queue_init(&this->network.server.commands, RR_NETWORK_QUEUE_SIZE);
+    rr_spsc_queue_init(&this->network.api.events, RR_NETWORK_QUEUE_SIZE);
+    rr_spsc_queue_init(&this->network.api.commands, RR_NETWORK_QUEUE_SIZE);
+    rr_uuid_table_init(&this->uuids);
     rr_simulation_init(&this->simulation);
     this->simulation.server = this;
     for (uint32_t i = 0; i < RR_SQUAD_COUNT; ++i)
         rr_squad_init(&this->squads[i], this, i);
+    // RR_ENCODE_THREADS=1 keeps the per-client encode on the tick thread
+    char const *encode_threads = getenv("RR_ENCODE_THREADS");
+    long worker_count = encode_threads != NULL ? atol(encode_threads)
+                                               : sysconf(_SC_NPROCESSORS_ONLN);
+    rr_thread_pool_init(&this->encode_pool, worker_count > 0 ? worker_count : 1);
+    fprintf(stderr, "encoding client updates on %u threads\n",
+            this->encode_pool.worker_count);
+    char const *net_stats_interval = getenv("RR_NET_STATS_INTERVAL");
+    if (net_stats_interval != NULL)
+        this->net_stats_interval = atol(net_stats_interval);
+    char const *replay_record = getenv("RR_REPLAY_RECORD");
+    if (replay_record != NULL)
+    {
+        if (rr_replay_open_recording(&this->recording, replay_record, seed))
+            fprintf(stderr, "recording to %s\n", replay_record);
+        else
+            fprintf(stderr, "could not record to %s\n", replay_record);
+    }
 }
 
 void rr_server_free(struct rr_server *this)
 {
-    lws_context_destroy(this->server);
+    rr_spsc_queue_free(&this->network.server.events);
+    rr_spsc_queue_free(&this->network.server.commands);
+    rr_spsc_queue_free(&this->network.api.events);
+    rr_spsc_queue_free(&this->network.api.commands);
+    for (uint32_t i = 0; i < this->free_message_queue_count; ++i)
+        free(this->free_message_queues[i]);
+    free(this->api_backlog);
+    rr_replay_close(&this->recording);
 }
 
-static void rr_simulation_tick_entity_resetter_function(EntityIdx entity,
-                                                        void *captures)
+static void rr_server_backlog_api_message(struct rr_server *this,
+                                          uint8_t const *data, uint32_t size)
 {
-    struct rr_simulation *this = captures;
-#define XX(COMPONENT, ID)                                                      \
-    if (rr_simulation_has_##COMPONENT(this, entity))                           \
-        rr_simulation_get_##COMPONENT(this, entity)->protocol_state = 0;
-    RR_FOR_EACH_COMPONENT
-#undef XX
+    uint32_t needed = this->api_backlog_size + sizeof size + size;
+    if (needed > this->api_backlog_capacity)
+    {
+        uint32_t capacity =
+            this->api_backlog_capacity ? this->api_backlog_capacity : 4096;
+        while (capacity < needed)
+            capacity *= 2;
+        this->api_backlog = realloc(this->api_backlog, capacity);
+        this->api_backlog_capacity = capacity;
+    }
+    memcpy(this->api_backlog + this->api_backlog_size, &size, sizeof size);
+    memcpy(this->api_backlog + this->api_backlog_size + sizeof size, data,
+           size);
+    this->api_backlog_size = needed;
+}
+
+// pushes as much of the backlog as the command queue takes, oldest first
+static void rr_server_flush_api_backlog(struct rr_server *this)
+{
+    uint32_t at = 0;
+    while (at < this->api_backlog_size)
+    {
+        uint32_t size;
+        memcpy(&size, this->api_backlog + at, sizeof size);
+        if (!rr_spsc_queue_push(&this->network.api.commands,
+                                rr_network_command_api_send, 0,
+                                this->api_backlog + at + sizeof size, size))
+            break;
+        at += sizeof size + size;
+    }
+    memmove(this->api_backlog, this->api_backlog + at,
+            this->api_backlog_size - at);
+    this->api_backlog_size -= at;
+}
+
+void rr_server_write_to_api(struct rr_server *this, uint8_t const *data,
+                            uint32_t size)
+{
+    // account writes have to arrive in order, nothing may overtake the
+    // backlog
+    if (this->api_backlog_size == 0 &&
+        rr_spsc_queue_push(&this->network.api.commands,
+                           rr_network_command_api_send, 0, data, size))
+        return;
+    if (this->api_backlog_size == 0)
+        fputs("network thread fell behind, holding api messages\n", stderr);
+    rr_server_backlog_api_message(this, data, size);
+}
+
+// hands the queue back for the next client that needs one
+void rr_server_release_message_queue(struct rr_server *this, uint8_t *queue)
+{
+    if (this->free_message_queue_count ==
+        sizeof this->free_message_queues / sizeof *this->free_message_queues)
+        free(queue);
+    else
+        this->free_message_queues[this->free_message_queue_count++] = queue;
+}
+
+static void rr_server_close_socket(struct rr_server *this, uint32_t socket,
+                                   char const *reason)
+{
+    rr_spsc_queue_push(&this->network.server.commands,
+                       rr_network_command_socket_close, socket, reason,
+                       strlen(reason));
+}
+
+static struct rr_server_client *rr_server_get_socket_client(
+    struct rr_server *this, uint32_t socket)
+{
+    struct rr_server_client *client =
+        this->socket_clients[socket % RR_NETWORK_SOCKET_COUNT];
+    if (client == NULL || client->socket != socket)
+        return NULL;
+    return client;
 }
 
 static void rr_simulation_dev_cheat_kill_mob(EntityIdx entity, void *_captures)
@@ -363,28 +747,17 @@ static void rr_simulation_dev_cheat_set_max_health(EntityIdx entity, void *_capt
         rr_component_health_set_health(health, health->max_health);
 }
 
-static int handle_lws_event(struct rr_server *this, struct lws *ws,
-                            enum lws_callback_reasons reason, uint8_t *packet,
-                            size_t size)
+static void handle_socket_event(struct rr_server *this, uint32_t socket,
+                                uint8_t type, uint8_t *packet, uint32_t size)
 {
-    switch (reason)
+    switch (type)
     {
-    case LWS_CALLBACK_ESTABLISHED:
+    case rr_network_event_socket_established:
     {
         if (!this->api_ws_ready)
         {
-            lws_close_reason(ws, LWS_CLOSE_STATUS_GOINGAWAY,
-                             (uint8_t *)"api ws not ready",
-                             sizeof "api ws not ready" - 1);
-            return -1;
-        }
-        char xff[100];
-        if (lws_hdr_copy(ws, xff, 100, WSI_TOKEN_X_FORWARDED_FOR) <= 0)
-        {
-            lws_close_reason(ws, LWS_CLOSE_STATUS_GOINGAWAY,
-                             (uint8_t *)"could not get xff header",
-                             sizeof "could not get xff header" - 1);
-            return -1;
+            rr_server_close_socket(this, socket, "api ws not ready");
+            return;
         }
         for (uint64_t i = 0; i < RR_MAX_CLIENT_COUNT; i++)
             if (!rr_bitset_get_bit(this->clients_in_use, i))
@@ -392,10 +765,21 @@ static int handle_lws_event(struct rr_server *this, struct lws *ws,
                 rr_bitset_set(this->clients_in_use, i);
                 rr_server_client_init(this->clients + i);
                 this->clients[i].server = this;
-                this->clients[i].socket_handle = ws;
+                this->clients[i].socket = socket;
                 this->clients[i].in_use = 1;
-                strcpy(this->clients[i].ip_address, xff);
-                lws_set_opaque_user_data(ws, this->clients + i);
+                strncpy(this->clients[i].ip_address, (char *)packet,
+                        sizeof this->clients[i].ip_address - 1);
+                this->socket_clients[socket % RR_NETWORK_SOCKET_COUNT] =
+                    this->clients + i;
+                struct rr_replay_client recorded = {
+                    this->clients[i].clientbound_encryption_key,
+                    this->clients[i].serverbound_encryption_key,
+                    this->clients[i].requested_verification,
+                    this->clients[i].nonce};
+                strcpy(recorded.ip_address, this->clients[i].ip_address);
+                rr_replay_record(&this->recording,
+                                 rr_replay_event_socket_established, socket,
+                                 &recorded, sizeof recorded);
                 // send encryption key
                 struct proto_bug encryption_key_encoder;
                 proto_bug_init(&encryption_key_encoder, outgoing_message);
@@ -419,22 +803,24 @@ static int handle_lws_event(struct rr_server *this, struct lws *ws,
                 rr_encrypt(outgoing_message, 1024, 59013169977270713ull);
                 rr_server_client_write_message(this->clients + i,
                                                outgoing_message, 1024);
-                return 0;
+                return;
             }
 
-        lws_close_reason(ws, LWS_CLOSE_STATUS_GOINGAWAY,
-                         (uint8_t *)"too many active clients",
-                         sizeof "to many active clients" - 1);
-        return -1;
+        rr_server_close_socket(this, socket, "too many active clients");
+        return;
     }
-    case LWS_CALLBACK_CLOSED:
+    case rr_network_event_socket_closed:
     {
-        struct rr_server_client *client = lws_get_opaque_user_data(ws);
+        struct rr_server_client *client =
+            rr_server_get_socket_client(this, socket);
         if (client != NULL)
         {
             uint64_t i = (client - this->clients);
+            rr_replay_record(&this->recording, rr_replay_event_socket_closed,
+                             socket, NULL, 0);
+            this->socket_clients[socket % RR_NETWORK_SOCKET_COUNT] = NULL;
             client->disconnected = 1;
-            client->socket_handle = NULL;
+            client->socket = 0;
             client->player_accel_x = 0;
             client->player_accel_y = 0;
             if (client->player_info != NULL)
@@ -446,13 +832,12 @@ static int handle_lws_event(struct rr_server *this, struct lws *ws,
                 rr_server_client_free(client);
             }
             if (client->received_first_packet == 0)
-                return 0;
+                return;
+            // the api saves the account once it hears of the disconnect
+            if (client->account_changed)
+                rr_server_client_sync_account(client);
 #ifdef RIVET_BUILD
-            char *token = malloc(500);
-            strncpy(token, client->rivet_account.token, 500);
-            pthread_t thread;
-            pthread_create(&thread, NULL, rivet_disconnected_endpoint, token);
-            pthread_detach(thread);
+            rr_log_rivet_disconnected(client->rivet_account.token);
 #endif
             struct rr_binary_encoder encoder;
             rr_binary_encoder_init(&encoder, outgoing_message);
@@ -460,55 +845,22 @@ static int handle_lws_event(struct rr_server *this, struct lws *ws,
             rr_binary_encoder_write_nt_string(
                 &encoder, this->clients[i].rivet_account.uuid);
             rr_binary_encoder_write_uint8(&encoder, i);
-            lws_write(this->api_client, encoder.start,
-                      encoder.at - encoder.start, LWS_WRITE_BINARY);
-            return 0;
+            rr_server_write_to_api(this, encoder.start,
+                                   encoder.at - encoder.start);
+            return;
         }
         puts("client joined but instakicked");
         break;
     }
-    case LWS_CALLBACK_SERVER_WRITEABLE:
+    case rr_network_event_socket_receive:
     {
-        struct rr_server_client *client = lws_get_opaque_user_data(ws);
+        struct rr_server_client *client =
+            rr_server_get_socket_client(this, socket);
         if (client == NULL)
-            return -1;
-        if (client->pending_kick)
-        {
-            struct rr_server_client_message *message = client->message_root;
-            while (message != NULL)
-            {
-                struct rr_server_client_message *tmp = message->next;
-                free(message->packet);
-                free(message);
-                message = tmp;
-            }
-            client->message_at = client->message_root = NULL;
-            client->message_length = 0;
-            lws_close_reason(ws, LWS_CLOSE_STATUS_GOINGAWAY,
-                             (uint8_t *)"kicked for unspecified reason",
-                             sizeof "kicked for unspecified reason" - 1);
-            return -1;
-        }
-        struct rr_server_client_message *message = client->message_root;
-        while (message != NULL)
-        {
-            lws_write(ws, message->packet + LWS_PRE, message->len,
-                      LWS_WRITE_BINARY);
-            struct rr_server_client_message *tmp = message->next;
-            free(message->packet);
-            free(message);
-            message = tmp;
-        }
-        client->message_at = client->message_root = NULL;
-        client->message_length = 0;
-        break;
-    }
-    case LWS_CALLBACK_RECEIVE:
-    {
-        struct rr_server_client *client = lws_get_opaque_user_data(ws);
-        if (client == NULL)
-            return -1;
+            return;
         uint64_t i = (client - this->clients);
+        rr_replay_record(&this->recording, rr_replay_event_socket_receive,
+                         socket, packet, size);
         rr_decrypt(packet, size, client->serverbound_encryption_key);
         client->serverbound_encryption_key =
             rr_get_hash(rr_get_hash(client->serverbound_encryption_key));
@@ -527,11 +879,9 @@ static int handle_lws_event(struct rr_server *this, struct lws *ws,
                 printf("%lu %lu\n", client->requested_verification,
                        received_verification);
                 fputs("invalid verification\n", stderr);
-                lws_close_reason(ws, LWS_CLOSE_STATUS_GOINGAWAY,
-                                 (uint8_t *)"invalid v",
-                                 sizeof "invalid v" - 1);
+                rr_server_close_socket(this, socket, "invalid v");
                 client->pending_kick = 1;
-                return -1;
+                return;
             }
 
             memset(&client->rivet_account, 0, sizeof(struct rr_rivet_account));
@@ -550,13 +900,7 @@ static int handle_lws_event(struct rr_server *this, struct lws *ws,
                 client->dev = 1;
 
 #ifdef RIVET_BUILD
-            struct connected_captures *captures = malloc(sizeof *captures);
-            captures->client = client;
-            captures->token = malloc(500);
-            strncpy(captures->token, client->rivet_account.token, 500);
-            pthread_t thread;
-            pthread_create(&thread, NULL, rivet_connected_endpoint, captures);
-            pthread_detach(thread);
+            rr_log_rivet_connected(i, client->rivet_account.token);
 #endif
             printf("<rr_server::socket_verified::%s>\n",
                    client->rivet_account.uuid);
@@ -571,9 +915,9 @@ static int handle_lws_event(struct rr_server *this, struct lws *ws,
                                               client->rivet_account.code);
             rr_binary_encoder_write_varuint(&encoder, client->nonce);
             rr_binary_encoder_write_uint8(&encoder, i);
-            lws_write(this->api_client, encoder.start,
-                      encoder.at - encoder.start, LWS_WRITE_BINARY);
-            return 0;
+            rr_server_write_to_api(this, encoder.start,
+                                   encoder.at - encoder.start);
+            return;
         }
         if (!client->verified)
             break;
@@ -583,11 +927,9 @@ static int handle_lws_event(struct rr_server *this, struct lws *ws,
         {
             printf("%u %u\n", client->quick_verification, qv);
             fputs("invalid quick verification\n", stderr);
-            lws_close_reason(ws, LWS_CLOSE_STATUS_GOINGAWAY,
-                             (uint8_t *)"invalid qv",
-                             sizeof "invalid qv" - 1);
+            rr_server_close_socket(this, socket, "invalid qv");
             client->pending_kick = 1;
-            return -1;
+            return;
         }
         uint8_t header = proto_bug_read_uint8(&encoder, "header");
         switch (header)
@@ -895,7 +1237,7 @@ static int handle_lws_event(struct rr_server *this, struct lws *ws,
                     squad->expose_code = !squad->private;
                     if (squad->private)
                     {
-                        uint8_t seed = rand() % squad->member_count;
+                        uint8_t seed = rr_rand() % squad->member_count;
                         for (uint8_t i = 0; i < RR_SQUAD_MEMBER_COUNT; ++i)
                         {
                             struct rr_squad_member *member = &squad->members[i];
@@ -1094,27 +1436,8 @@ static int handle_lws_event(struct rr_server *this, struct lws *ws,
                 client->squad == index && client->squad_pos == pos)
                 break;
             struct rr_server_client *to_block = block_member->client;
-            uint8_t j = 0;
-            for (; j < RR_MAX_CLIENT_COUNT; ++j)
-            {
-                if (strcmp(client->blocked_clients[j],
-                    to_block->rivet_account.uuid) == 0)
-                {
-                    client->blocked_clients[j][0] = 0;
-                    break;
-                }
-            }
-            if (j < RR_MAX_CLIENT_COUNT)
-                break;
-            for (j = 0; j < RR_MAX_CLIENT_COUNT; ++j)
-            {
-                if (client->blocked_clients[j][0] == 0)
-                {
-                    strcpy(client->blocked_clients[j],
-                           to_block->rivet_account.uuid);
-                    break;
-                }
-            }
+            client->blocked_clients_changed = 1;
+            rr_server_client_toggle_blocked(client, to_block->uuid);
             break;
         }
         case rr_serverbound_dev_cheat:
@@ -1242,24 +1565,22 @@ static int handle_lws_event(struct rr_server *this, struct lws *ws,
         default:
             break;
         }
-        return 0;
+        return;
     }
     default:
-        return 0;
+        return;
     }
-
-    return 0;
 }
 
-static int api_lws_callback(struct lws *ws, enum lws_callback_reasons reason,
-                            void *user, void *packet, size_t size)
+static void handle_api_event(struct rr_server *this, uint8_t type,
+                             uint8_t *packet, uint32_t size)
 {
-    struct rr_server *this =
-        (struct rr_server *)lws_context_user(lws_get_context(ws));
-    switch (reason)
+    switch (type)
     {
-    case LWS_CALLBACK_CLIENT_ESTABLISHED:
+    case rr_network_event_api_established:
     {
+        rr_replay_record(&this->recording, rr_replay_event_api_established, 0,
+                         NULL, 0);
         puts("connected to api server");
         this->api_ws_ready = 1;
         char *lobby_id =
@@ -1272,12 +1593,14 @@ static int api_lws_callback(struct lws *ws, enum lws_callback_reasons reason,
         rr_binary_encoder_init(&encoder, outgoing_message);
         rr_binary_encoder_write_uint8(&encoder, 101);
         rr_binary_encoder_write_nt_string(&encoder, lobby_id);
-        lws_write(this->api_client, encoder.start, encoder.at - encoder.start,
-                  LWS_WRITE_BINARY);
+        rr_server_write_to_api(this, encoder.start,
+                               encoder.at - encoder.start);
     }
     break;
-    case LWS_CALLBACK_CLIENT_RECEIVE:
+    case rr_network_event_api_receive:
     {
+        rr_replay_record(&this->recording, rr_replay_event_api_receive, 0,
+                         packet, size);
         // parse incoming client data
         struct rr_binary_encoder decoder;
         rr_binary_encoder_init(&decoder, packet);
@@ -1313,6 +1636,8 @@ static int api_lws_callback(struct lws *ws, enum lws_callback_reasons reason,
                 break;
             }
             client->verified = 1;
+            client->uuid =
+                rr_uuid_table_intern(&this->uuids, client->rivet_account.uuid);
             uint8_t i = client - this->clients;
             for (uint32_t j = 0; j < RR_MAX_CLIENT_COUNT; ++j)
             {
@@ -1329,8 +1654,7 @@ static int api_lws_callback(struct lws *ws, enum lws_callback_reasons reason,
                 if (client->rivet_account.name[0] != 0 ||
                     this->clients[j].rivet_account.name[0] != 0)
                     continue;
-                if (strcmp(client->rivet_account.uuid,
-                           this->clients[j].rivet_account.uuid) == 0)
+                if (client->uuid == this->clients[j].uuid)
                     continue;
                 if (strcmp(client->ip_address,
                            this->clients[j].ip_address) != 0)
@@ -1360,8 +1684,7 @@ static int api_lws_callback(struct lws *ws, enum lws_callback_reasons reason,
                     continue;
                 if (client->dev && this->clients[j].disconnected == 0)
                     continue;
-                if (strcmp(client->rivet_account.uuid,
-                           this->clients[j].rivet_account.uuid) != 0)
+                if (client->uuid != this->clients[j].uuid)
                     continue;
                 client->player_info = this->clients[j].player_info;
                 client->dev_cheats = this->clients[j].dev_cheats;
@@ -1377,6 +1700,8 @@ static int api_lws_callback(struct lws *ws, enum lws_callback_reasons reason,
                 memcpy(client->blocked_clients,
                        this->clients[j].blocked_clients,
                        sizeof this->clients[j].blocked_clients);
+                client->blocked_client_count =
+                    this->clients[j].blocked_client_count;
                 for (uint32_t k = 0; k < this->simulation.drop_count; ++k)
                 {
                     EntityIdx drop_id = this->simulation.drop_vector[k];
@@ -1449,62 +1774,77 @@ static int api_lws_callback(struct lws *ws, enum lws_callback_reasons reason,
         }
         break;
     }
-    case LWS_CALLBACK_CLIENT_CLOSED:
-        // uh oh
-        fprintf(stderr, "api ws disconnected\n");
-        abort();
-        break;
-    case LWS_CALLBACK_CLIENT_CONNECTION_ERROR:
-        fprintf(stderr, "api ws refused to connect\n");
-        abort();
-        break;
     default:
-        return 0;
+        break;
     }
-    return 0;
 }
 
-static int lws_callback(struct lws *ws, enum lws_callback_reasons reason,
-                        void *user, void *packet, size_t size)
+// everything that reached the network thread since the last tick
+static void rr_server_handle_network_events(struct rr_server *this)
 {
-    switch (reason)
+    struct rr_spsc_queue_record *event;
+    while ((event = rr_spsc_queue_peek(&this->network.api.events)) != NULL)
     {
-    case LWS_CALLBACK_ESTABLISHED:
-    case LWS_CALLBACK_SERVER_WRITEABLE:
-    case LWS_CALLBACK_RECEIVE:
-    case LWS_CALLBACK_CLOSED:
-        break;
-    default:
-        return 0;
+        handle_api_event(this, event->type, (uint8_t *)(event + 1),
+                         event->size);
+        rr_spsc_queue_pop(&this->network.api.events);
+    }
+    while ((event = rr_spsc_queue_peek(&this->network.server.events)) != NULL)
+    {
+        uint8_t *data = (uint8_t *)(event + 1);
+        if (event->type == rr_network_event_message_queue_released)
+        {
+            struct rr_network_message_queue queue;
+            memcpy(&queue, data, sizeof queue);
+            rr_server_release_message_queue(this, queue.data);
+        }
+        else
+            handle_socket_event(this, event->socket, event->type, data,
+                                event->size);
+        rr_spsc_queue_pop(&this->network.server.events);
     }
-    // assert(pthread_mutex_lock(&mutex) == 0);
-
-    struct rr_server *this =
-        (struct rr_server *)lws_context_user(lws_get_context(ws));
-    int close = handle_lws_event(this, ws, reason, packet, size);
-    if (close)
-        return close;
-    // assert(pthread_mutex_unlock(&mutex) == 0);
-    return 0;
 }
 
-void *thread_func(void *arg)
+// hands what every client was sent this tick over to the network thread.
+// a queue the network thread has no room for stays with the client and
+// keeps filling until it does. api messages held back go out first
+static void rr_server_flush_messages(struct rr_server *this)
 {
-    struct rr_server *this = (struct rr_server *)arg;
-    while (1)
+    rr_server_flush_api_backlog(this);
+    for (uint64_t i = 0; i < RR_MAX_CLIENT_COUNT; ++i)
     {
-        lws_service(this->server, 0);
+        struct rr_server_client *client = &this->clients[i];
+        if (!rr_bitset_get(this->clients_in_use, i) || client->socket == 0 ||
+            client->message_queue_size == 0)
+            continue;
+        struct rr_network_message_queue queue = {client->message_queue,
+                                                 client->message_queue_size};
+        if (!rr_spsc_queue_push(&this->network.server.commands,
+                                rr_network_command_socket_send,
+                                client->socket, &queue, sizeof queue))
+            continue;
+        client->message_queue = NULL;
+        client->message_queue_size = 0;
     }
-    return 0;
 }
 
-static void lws_log(int level, char const *log) { printf("%d %s", level, log); }
+// the token is compared since the client may have been reused meanwhile
+static void rr_server_kick_rivet_rejected(struct rr_server *this)
+{
+    uint32_t i;
+    char token[sizeof this->clients[0].rivet_account.token];
+    while (rr_log_poll_rivet_rejected(&i, token))
+        if (strcmp(token, this->clients[i].rivet_account.token) == 0)
+            this->clients[i].pending_kick = 1;
+}
 
 static void server_tick(struct rr_server *this)
 {
     if (!this->api_ws_ready)
         return;
-    rr_simulation_tick(&this->simulation);
+    rr_server_kick_rivet_rejected(this);
+    RR_TIME_BLOCK(simulation, rr_simulation_tick(&this->simulation));
+    uint64_t clients_start = rr_profiler_now();
     for (uint64_t i = 0; i < RR_MAX_CLIENT_COUNT; ++i)
     {
         if (rr_bitset_get(this->clients_in_use, i))
@@ -1532,6 +1872,8 @@ static void server_tick(struct rr_server *this)
                     client->in_use = 0;
                     rr_server_client_free(client);
                 }
+                // not encoded anymore, so the wire baselines move on
+                // without it. reconnecting clears entities_in_view
                 continue;
             }
             if (!client->dev && client->player_info != NULL &&
@@ -1561,11 +1903,14 @@ static void server_tick(struct rr_server *this)
                 client->afk_ticks = 0;
             if (client->afk_ticks == RR_AFK_WARNING) {
                 for (uint32_t i = 0; i < 6; ++i)
-                    client->afk_challenge[i] = (char)(97 + rand() % 26);
+                    client->afk_challenge[i] = (char)(97 + rr_rand() % 26);
                 client->afk_challenge[6] = 0;
             }
             if (client->pending_kick)
-                lws_callback_on_writable(client->socket_handle);
+                rr_server_close_socket(this, client->socket,
+                                       "kicked for unspecified reason");
+            // no player_info before verification, so nothing in view that
+            // the wire baselines could leave behind
             if (!client->verified)
                 continue;
             if (client->player_info != NULL)
@@ -1591,174 +1936,165 @@ static void server_tick(struct rr_server *this)
                         uint8_t rarity =
                             client->player_info->drops_this_tick[i].rarity;
                         ++client->inventory[id][rarity];
+                        rr_server_client_change_inventory(client, id, rarity);
                     }
-                    rr_server_client_write_to_api(client);
-                    rr_server_client_write_account(client);
                     client->player_info->drops_this_tick_size = 0;
                 }
             }
-            if (client->in_squad)
-                rr_server_client_broadcast_update(client);
-            rr_server_client_broadcast_animation_update(client);
-            // if (!client->dev)
-            //     continue;
-            struct proto_bug encoder;
-            proto_bug_init(&encoder, outgoing_message);
-            proto_bug_write_uint8(&encoder, rr_clientbound_squad_dump,
-                                  "header");
-            proto_bug_write_uint8(&encoder, client->dev, "is_dev");
-            int8_t kick_vote_pos = -3;
-            if (client->in_squad)
-            {
-                kick_vote_pos =
-                    rr_squad_get_client_slot(this, client)->kick_vote_pos;
-                if (kick_vote_pos == -1 && client->ticks_to_next_kick_vote > 0)
-                    kick_vote_pos = -2;
-            }
-            proto_bug_write_uint8(&encoder, kick_vote_pos, "kick vote");
-            for (uint32_t s = 0; s < RR_SQUAD_COUNT; ++s)
-            {
-                struct rr_squad *squad = &this->squads[s];
-                for (uint32_t i = 0; i < RR_SQUAD_MEMBER_COUNT; ++i)
-                {
-                    if (squad->members[i].in_use == 0)
-                    {
-                        proto_bug_write_uint8(&encoder, 0, "bitbit");
-                        continue;
-                    }
-                    struct rr_squad_member *member = &squad->members[i];
-                    proto_bug_write_uint8(&encoder, 1, "bitbit");
-                    proto_bug_write_uint8(&encoder, member->playing, "ready");
-                    proto_bug_write_uint8(&encoder,
-                                          member->client->disconnected,
-                                          "disconnected");
-                    uint8_t blocked = 0;
-                    for (uint8_t j = 0; j < RR_MAX_CLIENT_COUNT; ++j)
-                        if (strcmp(client->blocked_clients[j],
-                            member->client->rivet_account.uuid) == 0)
-                        {
-                            blocked = 1;
-                            break;
-                        }
-                    proto_bug_write_uint8(&encoder, blocked, "blocked");
-                    proto_bug_write_uint8(&encoder, member->is_dev, "is_dev");
-                    proto_bug_write_uint8(&encoder, member->kick_vote_count,
-                                          "kick votes");
-                    proto_bug_write_varuint(&encoder, member->level, "level");
-                    proto_bug_write_string(&encoder, member->nickname, 16,
-                                           "nickname");
-                    proto_bug_write_string(&encoder, member->client->rivet_account.uuid, 37,
-                                           "uuid");
-                    proto_bug_write_string(&encoder, member->client->rivet_account.id, 20,
-                                           "discord");
-                    for (uint8_t j = 0; j < RR_MAX_SLOT_COUNT * 2; ++j)
-                    {
-                        proto_bug_write_uint8(&encoder, member->loadout[j].id,
-                                              "id");
-                        proto_bug_write_uint8(&encoder,
-                                              member->loadout[j].rarity, "rar");
-                    }
-                }
-                proto_bug_write_uint8(&encoder, squad->owner, "sqown");
-                proto_bug_write_uint8(&encoder, squad->private, "private");
-                proto_bug_write_uint8(&encoder, squad->expose_code,
-                                      "expose_code");
-                proto_bug_write_uint8(&encoder, RR_GLOBAL_BIOME, "biome");
-                char joined_code[16];
-                if (client->dev || squad->expose_code ||
-                    (client->in_squad && client->squad == s))
-                    sprintf(joined_code, "%s-%s", this->server_alias,
-                            squad->squad_code);
-                else
-                    strcpy(joined_code, "(private)");
-                proto_bug_write_string(&encoder, joined_code, 16, "squad code");
-            }
-            rr_server_client_write_message(client, encoder.start,
-                                           encoder.current - encoder.start);
+            if (client->ticks_to_account_sync > 0)
+                --client->ticks_to_account_sync;
+            else if (client->account_changed)
+                rr_server_client_sync_account(client);
+            if (client->ticks_to_account_checkpoint > 0 &&
+                --client->ticks_to_account_checkpoint == 0)
+                rr_server_client_write_to_api(client);
+            // the view query treats the simulation as read-only, so the
+            // arena of the player info is fixed up here instead
+            if (client->player_info != NULL &&
+                (!rr_simulation_has_entity(&this->simulation,
+                                           client->player_info->arena) ||
+                 rr_bitset_get(this->simulation.deleted_last_tick,
+                               client->player_info->arena)))
+                rr_component_player_info_set_arena(client->player_info, 1);
+            rr_server_client_acquire_messages(client);
+            this->encode_jobs[this->encode_job_count++].client = client;
         }
     }
-    rr_simulation_for_each_entity(&this->simulation, &this->simulation,
-                                  rr_simulation_tick_entity_resetter_function);
+    rr_profiler_record(&rr_profiler, rr_profiler_scope_clients, clients_start);
+    RR_TIME_BLOCK(encode, {
+        rr_server_update_squad_dump(this);
+        rr_animation_grid_build(&this->animation_grid, &this->simulation);
+        rr_server_flush_encode_jobs(this);
+    });
+#ifndef NDEBUG
+    rr_server_check_wire_baselines(this);
+#endif
+    if (this->net_stats_interval > 0 &&
+        ++this->net_stats_ticks >= this->net_stats_interval)
+        rr_server_dump_net_stats(this);
+    rr_simulation_reset_protocol_state(&this->simulation);
+}
+
+static void profile_network_service(struct rr_network_service *service,
+                                    enum rr_profiler_scope scope)
+{
+    uint64_t cpu_nanoseconds =
+        __atomic_load_n(&service->cpu_nanoseconds, __ATOMIC_RELAXED);
+    rr_profiler_add(&rr_profiler, scope,
+                    cpu_nanoseconds - service->cpu_nanoseconds_profiled);
+    service->cpu_nanoseconds_profiled = cpu_nanoseconds;
 }
 
 void rr_server_run(struct rr_server *this)
 {
+    while (1)
     {
-        struct lws_context_creation_info info = {0};
-
-        info.protocols =
-            (struct lws_protocols[]){{"g", lws_callback, sizeof(uint8_t),
-                                      MESSAGE_BUFFER_SIZE, 0, NULL, 0},
-                                     {0}};
-
-        info.port = 1234;
-        info.user = this;
-        info.pt_serv_buf_size = MESSAGE_BUFFER_SIZE;
+        uint64_t start = rr_profiler_now();
+        RR_TIME_BLOCK(network_events, rr_server_handle_network_events(this));
+        RR_TIME_BLOCK(tick, server_tick(this));
+        rr_server_flush_messages(this);
+        this->network.wake(&this->network);
+        // what the network threads spent since the last tick
+        profile_network_service(&this->network.server,
+                                rr_profiler_scope_server_network);
+        profile_network_service(&this->network.api,
+                                rr_profiler_scope_api_network);
+        this->simulation.animation_length = 0;
+        rr_profiler_end_tick(&rr_profiler, &this->simulation);
+        rr_replay_end_tick(&this->recording);
 
-        this->server = lws_create_context(&info);
-        assert(this->server);
+        uint64_t elapsed_time = (rr_profiler_now() - start) / 1000;
+        if (elapsed_time > 25000)
+            fprintf(stderr, "tick took %lu microseconds\n", elapsed_time);
+        int64_t to_sleep = 40000 - elapsed_time;
+        if (to_sleep > 0)
+            usleep(to_sleep);
     }
+}
+
+static void replay_event(struct rr_server *this, struct rr_replay_event *event)
+{
+    switch (event->type)
+    {
+    case rr_replay_event_socket_established:
     {
-        struct lws_context_creation_info info = {0};
-        struct lws_client_connect_info client_info = {0};
+        struct rr_replay_client recorded;
+        memcpy(&recorded, event->data, sizeof recorded);
+        handle_socket_event(this, event->socket,
+                            rr_network_event_socket_established,
+                            (uint8_t *)recorded.ip_address,
+                            strlen(recorded.ip_address) + 1);
+        struct rr_server_client *client =
+            rr_server_get_socket_client(this, event->socket);
+        if (client == NULL)
+            break;
+        client->clientbound_encryption_key =
+            recorded.clientbound_encryption_key;
+        client->serverbound_encryption_key =
+            recorded.serverbound_encryption_key;
+        client->requested_verification = recorded.requested_verification;
+        client->nonce = recorded.nonce;
+        break;
+    }
+    case rr_replay_event_socket_receive:
+        handle_socket_event(this, event->socket,
+                            rr_network_event_socket_receive, event->data,
+                            event->size);
+        break;
+    case rr_replay_event_socket_closed:
+        handle_socket_event(this, event->socket,
+                            rr_network_event_socket_closed, NULL, 0);
+        break;
+    case rr_replay_event_api_established:
+        handle_api_event(this, rr_network_event_api_established, NULL, 0);
+        break;
+    case rr_replay_event_api_receive:
+        handle_api_event(this, rr_network_event_api_receive, event->data,
+                         event->size);
+        break;
+    default:
+        break;
+    }
+}
 
-        struct lws_protocols protocols[] = {
-            {
-                "g",
-                api_lws_callback,
-                0,
-                128 * 1024,
-            },
-            {NULL, NULL, 0, 0} // terminator
-        };
-        info.port = CONTEXT_PORT_NO_LISTEN;
-        info.protocols = protocols;
-        info.gid = -1;
-        info.uid = -1;
-        info.user = this;
-
-        this->api_client_context = lws_create_context(&info);
-        if (!this->api_client_context)
-        {
-            puts("couldn't create api server context");
-            exit(1);
-        }
-        client_info.context = this->api_client_context;
-        client_info.address =
-#ifndef RIVET_BUILD
-            "localhost";
-#else
-            "45.79.197.197";
-#endif
-        client_info.port = 55554;
-        client_info.path = "/api/" RR_API_SECRET;
-        client_info.host = client_info.address;
-        client_info.origin = client_info.address;
-        client_info.protocol = protocols[0].name;
-        this->api_client = lws_client_connect_via_info(&client_info);
-        if (!this->api_client)
+// stands in for the network thread, which would have sent all of it
+static void replay_commands(struct rr_server *this)
+{
+    struct rr_spsc_queue_record *command;
+    while ((command = rr_spsc_queue_peek(&this->network.server.commands)) !=
+           NULL)
+    {
+        if (command->type == rr_network_command_socket_send)
         {
-            puts("couldn't create api client");
-            exit(1);
+            struct rr_network_message_queue queue;
+            memcpy(&queue, command + 1, sizeof queue);
+            rr_server_release_message_queue(this, queue.data);
         }
+        rr_spsc_queue_pop(&this->network.server.commands);
     }
-    struct timeval start;
-    struct timeval end;
-    while (1)
+    while (rr_spsc_queue_peek(&this->network.api.commands) != NULL)
+        rr_spsc_queue_pop(&this->network.api.commands);
+}
+
+void rr_server_replay(struct rr_server *this, struct rr_replay *replay,
+                      uint32_t last_tick)
+{
+    struct rr_replay_event event;
+    int more = rr_replay_read(replay, &event);
+    for (uint32_t tick = 0; more && tick <= last_tick; ++tick)
     {
-        gettimeofday(&start, NULL);
-        lws_service(this->server, -1);
-        lws_service(this->api_client_context, -1);
-        server_tick(this);
+        for (; more && event.tick == tick;
+             more = rr_replay_read(replay, &event))
+            replay_event(this, &event);
+        uint64_t start = rr_profiler_now();
+        RR_TIME_BLOCK(tick, server_tick(this));
+        rr_server_flush_messages(this);
+        replay_commands(this);
         this->simulation.animation_length = 0;
-        gettimeofday(&end, NULL);
-
-        uint64_t elapsed_time = (end.tv_sec - start.tv_sec) * 1000000 +
-                                (end.tv_usec - start.tv_usec);
+        rr_profiler_end_tick(&rr_profiler, &this->simulation);
+        uint64_t elapsed_time = (rr_profiler_now() - start) / 1000;
         if (elapsed_time > 25000)
-            fprintf(stderr, "tick took %lu microseconds\n", elapsed_time);
-        int64_t to_sleep = 40000 - elapsed_time;
-        if (to_sleep > 0)
-            usleep(to_sleep);
+            fprintf(stderr, "tick %u took %lu microseconds\n", tick,
+                    elapsed_time);
     }
 }
@@ -16,9 +16,14 @@
 
 #pragma once
 
+#include <Server/AnimationGrid.h>
 #include <Server/Client.h>
+#include <Server/Network.h>
+#include <Server/Replay.h>
 #include <Server/Simulation.h>
 #include <Server/Squad.h>
+#include <Server/ThreadPool.h>
+#include <Server/Uuid.h>
 
 #ifndef NDEBUG
 #define MESSAGE_BUFFER_SIZE (32 * 1024 * 1024)
@@ -26,30 +31,81 @@
 #define MESSAGE_BUFFER_SIZE (1024 * 1024)
 #endif
 
+// an encode worker only starts on a client with at least this much room
+// left in its message queue, the client is kicked otherwise
+#define RR_ENCODE_CLIENT_RESERVE (RR_MESSAGE_QUEUE_SIZE / 4)
+// animations this far outside of the view are still sent, damage numbers
+// drift a little on the client
+#define RR_ANIMATION_VIEW_PADDING (256)
+// room for the shared part of a squad dump, proto_bug debug headers included
+#define RR_SQUAD_DUMP_SIZE (RR_SQUAD_COUNT * RR_SQUAD_MEMBER_COUNT * 1024)
+
 extern uint8_t lws_message_data[MESSAGE_BUFFER_SIZE];
 extern uint8_t *outgoing_message;
 
-struct lws_context;
-struct lws;
 struct rr_server;
 struct rr_squad_member;
 
+enum rr_server_encode_segment_type
+{
+    rr_server_encode_segment_update,
+    rr_server_encode_segment_animation_update,
+    rr_server_encode_segment_squad_dump,
+    rr_server_encode_segment_max
+};
+
+struct rr_server_encode_job
+{
+    struct rr_server_client *client;
+    uint8_t out_of_room;
+};
+
 struct rr_server
 {
     struct rr_simulation simulation;
     uint8_t clients_in_use[RR_BITSET_ROUND(RR_MAX_CLIENT_COUNT)];
     struct rr_server_client clients[RR_MAX_CLIENT_COUNT];
-    struct lws_context *server;
-    struct lws_context *api_client_context;
-    struct lws *api_client;
+    // the client of every socket, by the slot of its id
+    struct rr_server_client *socket_clients[RR_NETWORK_SOCKET_COUNT];
+    struct rr_network network;
     struct rr_squad squads[RR_MAX_CLIENT_COUNT];
+    struct rr_uuid_table uuids;
+    struct rr_thread_pool encode_pool;
+    struct rr_server_encode_job encode_jobs[RR_MAX_CLIENT_COUNT];
+    struct rr_animation_grid animation_grid;
+    // every client has one queue filling and at most one waiting on the
+    // network thread. queues released while this is full are freed
+    uint8_t *free_message_queues[RR_MAX_CLIENT_COUNT * 2];
+    uint32_t free_message_queue_count;
+    // api messages the command queue had no room for, each a uint32_t size
+    // followed by the message. retried in order before anything newer
+    uint8_t *api_backlog;
+    uint32_t api_backlog_size;
+    uint32_t api_backlog_capacity;
+    uint32_t encode_job_count;
+    // the part of the squad dump that is the same for every client. it is
+    // encoded once per tick into squad_dump_next and only replaces
+    // squad_dump, under a new version, when the two differ
+    uint8_t squad_dump[RR_SQUAD_DUMP_SIZE];
+    uint8_t squad_dump_next[RR_SQUAD_DUMP_SIZE];
+    uint64_t squad_dump_size;
+    uint32_t squad_dump_version;
+    // RR_NET_STATS_INTERVAL, ticks between net stats dumps. 0 disables them
+    uint32_t net_stats_interval;
+    uint32_t net_stats_ticks;
+    struct rr_replay recording;
     uint8_t api_ws_ready;
     char server_alias[16];
 };
 
-void rr_server_init(struct rr_server *);
+void rr_server_init(struct rr_server *, uint64_t);
 void rr_server_free(struct rr_server *);
 
+// Both only queue up work for the network thread. Api messages are never
+// dropped, they wait on the tick thread while the network thread is behind.
+void rr_server_write_to_api(struct rr_server *, uint8_t const *, uint32_t);
+void rr_server_release_message_queue(struct rr_server *, uint8_t *);
+
 uint8_t rr_client_create_squad(struct rr_server *, struct rr_server_client *);
 uint8_t rr_client_find_squad(struct rr_server *, struct rr_server_client *);
 uint8_t rr_client_join_squad_with_code(struct rr_server *,
@@ -63,5 +119,9 @@ struct rr_squad *rr_client_get_squad(struct rr_server *,
                                      struct rr_server_client *);
 
 // Blocking function. The only time this function will never end unless the
-// server crashes
+// server crashes. Expects rr_network_start to have been called
 void rr_server_run(struct rr_server *);
+// Runs the ticks of a recording as fast as possible, through the last one or
+// the given one, whichever comes first. Everything the server sends is
+// dropped, so the network thread must not be running
+void rr_server_replay(struct rr_server *, struct rr_replay *, uint32_t);
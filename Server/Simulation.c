@@ -21,12 +21,13 @@
 #include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
-#include <sys/time.h>
 
 #include <Server/Client.h>
 #include <Server/EntityAllocation.h>
 #include <Server/EntityDetection.h>
+#include <Server/FlowField.h>
 #include <Server/MobAi/Ai.h>
+#include <Server/Profiler.h>
 #include <Server/SpatialHash.h>
 #include <Server/System/System.h>
 #include <Server/Waves.h>
@@ -160,12 +161,20 @@ static void set_spawn_zones()
 void rr_simulation_init(struct rr_simulation *this)
 {
     memset(this, 0, sizeof *this);
+    rr_rng_seed(&this->rng, rr_rand());
     EntityIdx id = rr_simulation_alloc_entity(this);
     struct rr_component_arena *arena = rr_simulation_add_arena(this, id);
     arena->biome = RR_GLOBAL_BIOME;
     rr_component_arena_spatial_hash_init(arena, this);
+    rr_flow_field_init(&arena->zone_flow_field, arena->maze);
+    rr_flow_field_build_difficulty(&arena->zone_flow_field,
+                                   RR_FLOW_FIELD_HIGHER_ZONE_DIFFICULTY);
+    arena->active_blocks = malloc(arena->maze->maze_dim *
+                                  arena->maze->maze_dim / 4 *
+                                  sizeof *arena->active_blocks);
     set_respawn_zone(arena, SPAWN_ZONE_X, SPAWN_ZONE_Y);
     set_spawn_zones();
+    rr_waves_init();
 }
 
 struct too_close_captures
@@ -238,8 +247,7 @@ static void spawn_mob(struct rr_simulation *this, uint32_t grid_x,
     }
     else
         id = get_spawn_id(RR_GLOBAL_BIOME, grid);
-    uint8_t rarity =
-        get_spawn_rarity(grid->difficulty + grid->local_difficulty * 0);
+    uint8_t rarity = get_spawn_rarity(grid);
     if (!should_spawn_at(id, rarity))
         return;
     for (uint32_t n = 0; n < 10; ++n)
@@ -262,46 +270,142 @@ static void spawn_mob(struct rr_simulation *this, uint32_t grid_x,
 
 #define PLAYER_COUNT_CAP (12)
 
-static void count_flower_vicinity(EntityIdx entity, void *_simulation)
+static struct rr_maze_grid *get_block_grid(struct rr_component_arena *arena,
+                                           uint32_t block, uint32_t i)
+{
+    return rr_component_arena_get_grid(
+        arena, block % arena->maze->maze_dim + (i & 1),
+        block / arena->maze->maze_dim + (i >> 1));
+}
+
+static void tick_block(struct rr_simulation *, uint32_t);
+
+// The block's grids have had no flowers around and no overload since it was
+// last ticked, so a single tick brings their spawn timers to where ticking
+// them all along would have
+static void activate_block(struct rr_simulation *this, uint32_t block)
 {
-    struct rr_simulation *this = _simulation;
     struct rr_component_arena *arena = rr_simulation_get_arena(this, 1);
-    struct rr_component_physical *physical =
-        rr_simulation_get_physical(this, entity);
-    struct rr_component_relations *relations =
-        rr_simulation_get_relations(this, entity);
-    if (!rr_simulation_entity_alive(this, relations->owner))
+    struct rr_maze_grid *grid = get_block_grid(arena, block, 0);
+    if (grid->active)
         return;
-    struct rr_component_player_info *player_info =
-        rr_simulation_get_player_info(this, relations->owner);
-    if (is_dead_flower(this, entity))
-        return;
-    if (physical->bubbling_to_death)
-        return;
-    if (player_info->client->disconnected)
+    grid->active = 1;
+    arena->active_blocks[arena->active_block_count++] = block;
+    tick_block(this, block);
+}
+
+static uint8_t vicinity_contains(struct rr_flower_vicinity *vicinity,
+                                 uint32_t x, uint32_t y)
+{
+    return vicinity->counted && x >= vicinity->start_x &&
+           x <= vicinity->end_x && y >= vicinity->start_y &&
+           y <= vicinity->end_y;
+}
+
+static float vicinity_difficulty(struct rr_maze_grid *grid, uint32_t level)
+{
+    return rr_fclamp((level - (grid->difficulty - 1) * 2.1) / 10, -1, 1);
+}
+
+// Moves the flower's counts from its old vicinity to the new one, grids in
+// both are only touched when the level changed
+static void move_flower_vicinity(struct rr_simulation *this,
+                                 struct rr_component_flower *flower,
+                                 struct rr_flower_vicinity *next)
+{
+    struct rr_component_arena *arena = rr_simulation_get_arena(this, 1);
+    struct rr_flower_vicinity *last = &flower->vicinity;
+    if (!last->counted && !next->counted)
         return;
-    if (dev_cheat_enabled(this, entity, no_grid_influence))
+    if (last->counted && next->counted && last->level == next->level &&
+        last->start_x == next->start_x && last->start_y == next->start_y &&
+        last->end_x == next->end_x && last->end_y == next->end_y)
         return;
-#define FOV 3072
-    uint32_t sx = rr_fclamp((physical->x - FOV) / arena->maze->grid_size, 0,
-                            arena->maze->maze_dim - 1);
-    uint32_t sy = rr_fclamp((physical->y - FOV) / arena->maze->grid_size, 0,
-                            arena->maze->maze_dim - 1);
-    uint32_t ex = rr_fclamp((physical->x + FOV) / arena->maze->grid_size, 0,
-                            arena->maze->maze_dim - 1);
-    uint32_t ey = rr_fclamp((physical->y + FOV) / arena->maze->grid_size, 0,
-                            arena->maze->maze_dim - 1);
-#undef FOV
-    uint32_t level = rr_simulation_get_flower(_simulation, entity)->level;
+    uint32_t sx = last->counted ? last->start_x : next->start_x;
+    uint32_t sy = last->counted ? last->start_y : next->start_y;
+    uint32_t ex = last->counted ? last->end_x : next->end_x;
+    uint32_t ey = last->counted ? last->end_y : next->end_y;
+    if (last->counted && next->counted)
+    {
+        sx = sx < next->start_x ? sx : next->start_x;
+        sy = sy < next->start_y ? sy : next->start_y;
+        ex = ex > next->end_x ? ex : next->end_x;
+        ey = ey > next->end_y ? ey : next->end_y;
+    }
     for (uint32_t x = sx; x <= ex; ++x)
         for (uint32_t y = sy; y <= ey; ++y)
         {
+            uint8_t was_in = vicinity_contains(last, x, y);
+            uint8_t is_in = vicinity_contains(next, x, y);
+            if (was_in == is_in && (!is_in || last->level == next->level))
+                continue;
             struct rr_maze_grid *grid =
                 rr_component_arena_get_grid(arena, x, y);
-            grid->player_count += grid->player_count < PLAYER_COUNT_CAP;
-            grid->local_difficulty +=
-                rr_fclamp((level - (grid->difficulty - 1) * 2.1) / 10, -1, 1);
+            if (was_in)
+            {
+                --grid->flower_count;
+                grid->local_difficulty -=
+                    vicinity_difficulty(grid, last->level);
+            }
+            if (is_in)
+            {
+                if (grid->flower_count == 0)
+                    activate_block(this, (y & ~1) * arena->maze->maze_dim +
+                                             (x & ~1));
+                ++grid->flower_count;
+                grid->local_difficulty +=
+                    vicinity_difficulty(grid, next->level);
+            }
+            // no rounding left behind once the last flower is gone
+            if (grid->flower_count == 0)
+                grid->local_difficulty = 0;
+            grid->player_count = grid->flower_count < PLAYER_COUNT_CAP
+                                     ? grid->flower_count
+                                     : PLAYER_COUNT_CAP;
         }
+    *last = *next;
+}
+
+void rr_simulation_remove_flower_vicinity(struct rr_simulation *this,
+                                          struct rr_component_flower *flower)
+{
+    struct rr_flower_vicinity next = {0};
+    move_flower_vicinity(this, flower, &next);
+}
+
+static void update_flower_vicinity(EntityIdx entity, void *_simulation)
+{
+    struct rr_simulation *this = _simulation;
+    struct rr_component_arena *arena = rr_simulation_get_arena(this, 1);
+    struct rr_component_physical *physical =
+        rr_simulation_get_physical(this, entity);
+    struct rr_component_relations *relations =
+        rr_simulation_get_relations(this, entity);
+    struct rr_component_flower *flower =
+        rr_simulation_get_flower(this, entity);
+    struct rr_flower_vicinity next = {0};
+    if (!rr_simulation_entity_alive(this, relations->owner) ||
+        is_dead_flower(this, entity) || physical->bubbling_to_death ||
+        rr_simulation_get_player_info(this, relations->owner)
+            ->client->disconnected ||
+        dev_cheat_enabled(this, entity, no_grid_influence))
+    {
+        move_flower_vicinity(this, flower, &next);
+        return;
+    }
+#define FOV 3072
+    next.start_x = rr_fclamp((physical->x - FOV) / arena->maze->grid_size, 0,
+                             arena->maze->maze_dim - 1);
+    next.start_y = rr_fclamp((physical->y - FOV) / arena->maze->grid_size, 0,
+                             arena->maze->maze_dim - 1);
+    next.end_x = rr_fclamp((physical->x + FOV) / arena->maze->grid_size, 0,
+                           arena->maze->maze_dim - 1);
+    next.end_y = rr_fclamp((physical->y + FOV) / arena->maze->grid_size, 0,
+                           arena->maze->maze_dim - 1);
+#undef FOV
+    next.level = flower->level;
+    next.counted = 1;
+    move_flower_vicinity(this, flower, &next);
 }
 
 static void despawn_mob(EntityIdx entity, void *_simulation)
@@ -349,13 +453,14 @@ static int tick_grid(struct rr_simulation *this, struct rr_maze_grid *grid,
 {
     if (grid->value == 0 || (grid->value & 8))
         return 0;
-    grid->local_difficulty =
+    // local_difficulty is kept as a running sum, clamp a copy
+    float local_difficulty =
         rr_fclamp(grid->local_difficulty, -0.5, PLAYER_COUNT_CAP);
-    if (grid->local_difficulty > 0)
+    if (local_difficulty > 0)
     {
-        grid->overload_factor = rr_fclamp(
-            grid->overload_factor + 0.005 * grid->local_difficulty / 25, 0,
-            1.5 * grid->local_difficulty);
+        grid->overload_factor =
+            rr_fclamp(grid->overload_factor + 0.005 * local_difficulty / 25, 0,
+                      1.5 * local_difficulty);
     }
     else
     {
@@ -365,7 +470,7 @@ static int tick_grid(struct rr_simulation *this, struct rr_maze_grid *grid,
     float player_modifier = 1 + grid->player_count * 4.0 / 3;
     float difficulty_modifier = 150 + 3 * grid->difficulty;
     float overload_modifier =
-        powf(1.2, grid->local_difficulty + grid->overload_factor);
+        powf(1.2, local_difficulty + grid->overload_factor);
     float max_points = get_max_points(this, grid);
     if (grid->grid_points >= max_points)
         return 0;
@@ -388,101 +493,113 @@ static int tick_grid(struct rr_simulation *this, struct rr_maze_grid *grid,
     return 0;
 }
 
-static void tick_maze(struct rr_simulation *this)
+static void tick_block(struct rr_simulation *this, uint32_t block)
 {
     struct rr_component_arena *arena = rr_simulation_get_arena(this, 1);
-    for (uint32_t i = 0; i < arena->maze->maze_dim * arena->maze->maze_dim; ++i)
-        arena->maze->maze[i].local_difficulty =
-            arena->maze->maze[i].player_count = 0;
+    float max_overall = 0;
+    uint32_t grid_points = 0;
+    for (uint32_t i = 0; i < 4; ++i)
+    {
+        struct rr_maze_grid *grid = get_block_grid(arena, block, i);
+        max_overall += get_max_points(this, grid);
+        grid_points += grid->grid_points;
+    }
+    if (grid_points > max_overall)
+        return;
+    for (uint32_t i = 0; i < 4; ++i)
+        if (tick_grid(this, get_block_grid(arena, block, i),
+                      block % arena->maze->maze_dim + (i & 1),
+                      block / arena->maze->maze_dim + (i >> 1)))
+            return;
+}
 
-    rr_simulation_for_each_flower(this, this, count_flower_vicinity);
+// Blocks no flower has been near for long enough settle into a state that
+// ticking does not change, so only the active ones are visited
+static void tick_maze(struct rr_simulation *this)
+{
+    struct rr_component_arena *arena = rr_simulation_get_arena(this, 1);
+    rr_simulation_for_each_flower(this, this, update_flower_vicinity);
     rr_simulation_for_each_mob(this, this, despawn_mob);
-    for (uint32_t grid_x = 0; grid_x < arena->maze->maze_dim; grid_x += 2)
+    for (uint32_t i = 0; i < arena->active_block_count;)
     {
-        for (uint32_t grid_y = 0; grid_y < arena->maze->maze_dim; grid_y += 2)
+        uint32_t block = arena->active_blocks[i];
+        tick_block(this, block);
+        uint8_t settled = 1;
+        for (uint32_t j = 0; j < 4; ++j)
         {
-            struct rr_maze_grid *nw =
-                rr_component_arena_get_grid(arena, grid_x, grid_y);
-            struct rr_maze_grid *ne =
-                rr_component_arena_get_grid(arena, grid_x + 1, grid_y);
-            struct rr_maze_grid *sw =
-                rr_component_arena_get_grid(arena, grid_x, grid_y + 1);
-            struct rr_maze_grid *se =
-                rr_component_arena_get_grid(arena, grid_x + 1, grid_y + 1);
-            float max_overall =
-                get_max_points(this, nw) + get_max_points(this, ne) +
-                get_max_points(this, sw) + get_max_points(this, se);
-            if (nw->grid_points + ne->grid_points + sw->grid_points +
-                    se->grid_points >
-                max_overall)
-                continue;
-            if (tick_grid(this, nw, grid_x, grid_y))
-                continue;
-            if (tick_grid(this, ne, grid_x + 1, grid_y))
-                continue;
-            if (tick_grid(this, sw, grid_x, grid_y + 1))
-                continue;
-            if (tick_grid(this, se, grid_x + 1, grid_y + 1))
-                continue;
+            struct rr_maze_grid *grid = get_block_grid(arena, block, j);
+            settled &= grid->flower_count == 0 && grid->overload_factor == 0;
         }
+        if (!settled)
+        {
+            ++i;
+            continue;
+        }
+        get_block_grid(arena, block, 0)->active = 0;
+        arena->active_blocks[i] =
+            arena->active_blocks[--arena->active_block_count];
     }
 }
 
-#define RR_TIME_BLOCK_(_, CODE)                                                \
-    {                                                                          \
-        struct timeval start;                                                  \
-        struct timeval end;                                                    \
-        gettimeofday(&start, NULL);                                            \
-        CODE;                                                                  \
-        gettimeofday(&end, NULL);                                              \
-        uint64_t elapsed_time = (end.tv_sec - start.tv_sec) * 1000000 +        \
-                                (end.tv_usec - start.tv_usec);                 \
-        if (elapsed_time > 3000)                                               \
-        {                                                                      \
-            printf(_ " took %lu microseconds with %d entities\n",              \
-                   elapsed_time, this->physical_count);                        \
-        }                                                                      \
-    };
-
-#define RR_TIME_BLOCK(_, CODE)                                                 \
-    {                                                                          \
-        CODE;                                                                  \
-    };
-
 static int64_t last_zone_epoch = -1;
 
 void rr_simulation_tick(struct rr_simulation *this)
 {
-    rr_simulation_create_component_vectors(this);
-    RR_TIME_BLOCK("collision_detection",
+    struct rr_rng *previous_rng = rr_rng_bind(&this->rng);
+    RR_TIME_BLOCK(collision_detection,
                   { rr_system_collision_detection_tick(this); });
-    RR_TIME_BLOCK("ai", { rr_system_ai_tick(this); });
-    RR_TIME_BLOCK("drops", { rr_system_drops_tick(this); });
-    RR_TIME_BLOCK("petal_behavior", { rr_system_petal_behavior_tick(this); });
-    RR_TIME_BLOCK("collision_resolution",
+    RR_TIME_BLOCK(ai, { rr_system_ai_tick(this); });
+    RR_TIME_BLOCK(drops, { rr_system_drops_tick(this); });
+    RR_TIME_BLOCK(petal_behavior, { rr_system_petal_behavior_tick(this); });
+    RR_TIME_BLOCK(collision_resolution,
                   { rr_system_collision_resolution_tick(this); });
-    RR_TIME_BLOCK("web", { rr_system_web_tick(this); });
-    RR_TIME_BLOCK("velocity", { rr_system_velocity_tick(this); });
-    RR_TIME_BLOCK("centipede", { rr_system_centipede_tick(this); });
-    RR_TIME_BLOCK("health", { rr_system_health_tick(this); });
-    RR_TIME_BLOCK("camera", { rr_system_camera_tick(this); });
-    RR_TIME_BLOCK("checkpoints", { rr_system_checkpoints_tick(this); });
-    RR_TIME_BLOCK("spawn_tick", { tick_maze(this); });
+    RR_TIME_BLOCK(web, { rr_system_web_tick(this); });
+    RR_TIME_BLOCK(velocity, { rr_system_velocity_tick(this); });
+    RR_TIME_BLOCK(centipede, { rr_system_centipede_tick(this); });
+    RR_TIME_BLOCK(health, { rr_system_health_tick(this); });
+    RR_TIME_BLOCK(camera, { rr_system_camera_tick(this); });
+    RR_TIME_BLOCK(checkpoints, { rr_system_checkpoints_tick(this); });
+    RR_TIME_BLOCK(spawn_tick, { tick_maze(this); });
+    // every client was told about last tick's deletions, their ids can be
+    // reused from the next tick on
+    rr_bitset_for_each_bit(
+        this->deleted_last_tick,
+        this->deleted_last_tick + RR_BITSET_ROUND(RR_MAX_ENTITY_COUNT), this,
+        __rr_simulation_release_entity);
     memcpy(this->deleted_last_tick, this->pending_deletions,
            sizeof this->pending_deletions);
     memset(this->pending_deletions, 0, sizeof this->pending_deletions);
-    RR_TIME_BLOCK("free_component", {
+    RR_TIME_BLOCK(free_component, {
         rr_bitset_for_each_bit(
             this->deleted_last_tick,
             this->deleted_last_tick + (RR_BITSET_ROUND(RR_MAX_ENTITY_COUNT)),
             this, __rr_simulation_pending_deletion_free_components);
     });
-    RR_TIME_BLOCK("unset_entity", {
+    RR_TIME_BLOCK(unset_entity, {
         rr_bitset_for_each_bit(
             this->deleted_last_tick,
             this->deleted_last_tick + RR_BITSET_ROUND(RR_MAX_ENTITY_COUNT),
             this, __rr_simulation_pending_deletion_unset_entity);
     });
+    rr_rng_bind(previous_rng);
+}
+
+static void reset_protocol_state_function(EntityIdx entity, void *captures)
+{
+    struct rr_simulation *this = captures;
+    if (rr_simulation_has_physical(this, entity))
+        rr_component_physical_update_wire_position(
+            rr_simulation_get_physical(this, entity));
+#define XX(COMPONENT, ID)                                                      \
+    if (rr_simulation_has_##COMPONENT(this, entity))                           \
+        rr_simulation_get_##COMPONENT(this, entity)->protocol_state = 0;
+    RR_FOR_EACH_COMPONENT
+#undef XX
+}
+
+void rr_simulation_reset_protocol_state(struct rr_simulation *this)
+{
+    rr_simulation_for_each_entity(this, this, reset_protocol_state_function);
 }
 
 int rr_simulation_entity_alive(struct rr_simulation *this, EntityHash hash)
@@ -19,6 +19,12 @@
 #include <Shared/SimulationCommon.h>
 
 void rr_simulation_tick(struct rr_simulation *);
+// Called once every client was sent this tick's update. Moves the wire
+// positions on to what was sent and clears what changed
+void rr_simulation_reset_protocol_state(struct rr_simulation *);
+// Takes the flower's grids out of the maze's player counts
+void rr_simulation_remove_flower_vicinity(struct rr_simulation *,
+                                          struct rr_component_flower *);
 
 int rr_simulation_entity_alive(struct rr_simulation *,
                                EntityHash); // stricter version
@@ -16,132 +16,298 @@
 
 #include <Server/SpatialHash.h>
 
+#include <assert.h>
 #include <math.h>
+#if defined(__SSE2__)
+#include <immintrin.h>
+#endif
 #include <stdlib.h>
 #include <string.h>
 
-#include <Shared/Bitset.h>
-#include <Shared/SimulationCommon.h>
+#include <Shared/Utilities.h>
 
-#define spatial_hash_get(x, y) &this->cells[(x) * this->size + (y)]
+#define spatial_hash_cell(x, y) ((x) * this->size + (y))
 void rr_spatial_hash_init(struct rr_spatial_hash *this,
-                          struct rr_simulation *simulation, float size)
+                          struct rr_simulation *simulation, float size,
+                          float cell_size)
 {
     memset(this, 0, sizeof *this);
-    this->size = (size + SPATIAL_HASH_GRID_SIZE - 0.1) / SPATIAL_HASH_GRID_SIZE;
+    this->cell_size = cell_size;
+    this->size = (size + cell_size - 0.1) / cell_size;
     this->simulation = simulation;
-    this->cells =
-        calloc(sizeof(struct rr_spatial_hash_cell), this->size * this->size);
+    this->cell_starts =
+        calloc(sizeof *this->cell_starts, this->size * this->size + 1);
+    this->cell_max_radius =
+        calloc(sizeof *this->cell_max_radius, this->size * this->size);
 }
 
-void rr_spatial_hash_insert(struct rr_spatial_hash *this, EntityIdx entity)
+void rr_spatial_hash_free(struct rr_spatial_hash *this)
 {
-    struct rr_component_physical *physical =
-        rr_simulation_get_physical(this->simulation, entity);
+    free(this->cell_starts);
+    free(this->cell_max_radius);
+    free(this->inserted);
+    free(this->entities);
+    free(this->x);
+    free(this->y);
+    free(this->radius);
+    memset(this, 0, sizeof *this);
+}
 
+void rr_spatial_hash_insert(struct rr_spatial_hash *this, EntityIdx entity,
+                            float x, float y, float radius)
+{
+    float extent = this->size * this->cell_size;
     // force positions unsigned for a significantly better hash function
-    uint32_t x =
-        rr_fclamp(physical->x, physical->radius,
-                  this->size * SPATIAL_HASH_GRID_SIZE - physical->radius) /
-        SPATIAL_HASH_GRID_SIZE;
-    uint32_t y =
-        rr_fclamp(physical->y, physical->radius,
-                  this->size * SPATIAL_HASH_GRID_SIZE - physical->radius) /
-        SPATIAL_HASH_GRID_SIZE;
-    struct rr_spatial_hash_cell *cell = spatial_hash_get(x, y);
-    cell->entities[cell->entities_in_use++] = entity;
+    uint32_t cell_x = rr_fclamp(x, radius, extent - radius) / this->cell_size;
+    uint32_t cell_y = rr_fclamp(y, radius, extent - radius) / this->cell_size;
+    if (cell_x >= this->size)
+        cell_x = this->size - 1;
+    if (cell_y >= this->size)
+        cell_y = this->size - 1;
+    if (this->entity_count == this->entity_capacity)
+    {
+        this->entity_capacity =
+            this->entity_capacity == 0 ? 256 : this->entity_capacity * 2;
+        uint32_t capacity = this->entity_capacity;
+        this->inserted =
+            realloc(this->inserted, capacity * sizeof *this->inserted);
+        this->entities =
+            realloc(this->entities, capacity * sizeof *this->entities);
+        this->x = realloc(this->x, capacity * sizeof *this->x);
+        this->y = realloc(this->y, capacity * sizeof *this->y);
+        this->radius = realloc(this->radius, capacity * sizeof *this->radius);
+        assert(this->inserted && this->entities && this->x && this->y &&
+               this->radius);
+    }
+    struct rr_spatial_hash_entry *entry = &this->inserted[this->entity_count++];
+    entry->x = x;
+    entry->y = y;
+    entry->radius = radius;
+    entry->cell = spatial_hash_cell(cell_x, cell_y);
+    entry->entity = entity;
 }
 
-void rr_spatial_hash_update(struct rr_spatial_hash *this, EntityIdx entity) {}
+void rr_spatial_hash_build(struct rr_spatial_hash *this)
+{
+    uint32_t cell_count = this->size * this->size;
+    uint32_t *cell_starts = this->cell_starts;
+    memset(cell_starts, 0, (cell_count + 1) * sizeof *cell_starts);
+    memset(this->cell_max_radius, 0, cell_count * sizeof *this->cell_max_radius);
+    this->max_radius = 0;
+    for (uint32_t i = 0; i < this->entity_count; ++i)
+    {
+        struct rr_spatial_hash_entry *entry = &this->inserted[i];
+        ++cell_starts[entry->cell];
+        if (entry->radius > this->cell_max_radius[entry->cell])
+            this->cell_max_radius[entry->cell] = entry->radius;
+        if (entry->radius > this->max_radius)
+            this->max_radius = entry->radius;
+    }
+    // inclusive prefix sum leaves every cell pointing at its end, the scatter
+    // walks back to front so the cells end up pointing at their start while
+    // keeping insertion order within each cell
+    uint32_t total = 0;
+    for (uint32_t c = 0; c < cell_count; ++c)
+    {
+        total += cell_starts[c];
+        cell_starts[c] = total;
+    }
+    cell_starts[cell_count] = total;
+    for (uint32_t i = this->entity_count; i > 0; --i)
+    {
+        struct rr_spatial_hash_entry *entry = &this->inserted[i - 1];
+        uint32_t at = --cell_starts[entry->cell];
+        this->entities[at] = entry->entity;
+        this->x[at] = entry->x;
+        this->y[at] = entry->y;
+        this->radius[at] = entry->radius;
+    }
+}
 
 void rr_spatial_hash_query(struct rr_spatial_hash *this, float fx, float fy,
                            float fw, float fh, void *user_captures,
                            void (*cb)(EntityIdx, void *))
 {
-    float x = fmaxf(fx - fw, 0);
-    float y = fmaxf(fy - fh, 0);
     // should not take in an entity id like insert does. the reason is so stuff
     // like ai can query a large radius without a viewing entity
+    float min_x = fx - fw;
+    float min_y = fy - fh;
+    float max_x = fx + fw;
+    float max_y = fy + fh;
+    // entities are bucketed by their center, so the query only has to grow by
+    // the largest radius that was inserted instead of a whole cell
+    float pad = this->max_radius;
     uint32_t s_x =
-        rr_fclamp((fx - fw - SPATIAL_HASH_GRID_SIZE) / SPATIAL_HASH_GRID_SIZE,
-                  0, this->size - 1);
-
+        rr_fclamp((min_x - pad) / this->cell_size, 0, this->size - 1);
     uint32_t s_y =
-        rr_fclamp((fy - fh - SPATIAL_HASH_GRID_SIZE) / SPATIAL_HASH_GRID_SIZE,
-                  0, this->size - 1);
-
+        rr_fclamp((min_y - pad) / this->cell_size, 0, this->size - 1);
     uint32_t e_x =
-        rr_fclamp((fx + fw + SPATIAL_HASH_GRID_SIZE) / SPATIAL_HASH_GRID_SIZE,
-                  0, this->size - 1);
-
+        rr_fclamp((max_x + pad) / this->cell_size, 0, this->size - 1);
     uint32_t e_y =
-        rr_fclamp((fy + fh + SPATIAL_HASH_GRID_SIZE) / SPATIAL_HASH_GRID_SIZE,
-                  0, this->size - 1);
+        rr_fclamp((max_y + pad) / this->cell_size, 0, this->size - 1);
 
     for (uint32_t y = s_y; y <= e_y; y++)
         for (uint32_t x = s_x; x <= e_x; x++)
         {
-            struct rr_spatial_hash_cell *cell = spatial_hash_get(x, y);
-            for (uint64_t i = 0; i < cell->entities_in_use; i++)
-                cb(cell->entities[i], user_captures);
+            uint32_t cell = spatial_hash_cell(x, y);
+            // skip border cells whose own largest entity can't reach the
+            // query rect
+            float cell_pad = this->cell_max_radius[cell];
+            if (cell_pad < pad &&
+                (x * this->cell_size > max_x + cell_pad ||
+                 (x + 1) * this->cell_size < min_x - cell_pad ||
+                 y * this->cell_size > max_y + cell_pad ||
+                 (y + 1) * this->cell_size < min_y - cell_pad))
+                continue;
+            for (uint32_t i = this->cell_starts[cell];
+                 i < this->cell_starts[cell + 1]; i++)
+                cb(this->entities[i], user_captures);
         }
 }
 
-void rr_spatial_hash_find_possible_collisions(
-    struct rr_spatial_hash *this, void *user_captures,
-    void (*cb)(struct rr_simulation *, EntityIdx, EntityIdx, void *))
+typedef void (*rr_spatial_hash_pair_cb)(struct rr_simulation *, EntityIdx,
+                                        EntityIdx, void *);
+
+static void pair_with_range(struct rr_spatial_hash *this, uint32_t i,
+                            uint32_t start, uint32_t end, void *user_captures,
+                            rr_spatial_hash_pair_cb cb)
 {
-    for (uint64_t x = 0; x < this->size; ++x)
+    EntityIdx entity = this->entities[i];
+    for (uint32_t j = start; j < end; ++j)
+        cb(this->simulation, entity, this->entities[j], user_captures);
+}
+
+// same as pair_with_range but only passes on the pairs whose circles
+// overlap. the test runs on several candidates at once straight from the
+// dense x, y and radius arrays
+static void overlap_with_range(struct rr_spatial_hash *this, uint32_t i,
+                               uint32_t start, uint32_t end,
+                               void *user_captures, rr_spatial_hash_pair_cb cb)
+{
+    EntityIdx entity = this->entities[i];
+    float x = this->x[i];
+    float y = this->y[i];
+    float radius = this->radius[i];
+    uint32_t j = start;
+#if defined(__AVX__)
+    __m256 vx = _mm256_set1_ps(x);
+    __m256 vy = _mm256_set1_ps(y);
+    __m256 vr = _mm256_set1_ps(radius);
+    for (; j + 8 <= end; j += 8)
     {
-        for (uint64_t y = 0; y < this->size; ++y)
+        __m256 dx = _mm256_sub_ps(_mm256_loadu_ps(&this->x[j]), vx);
+        __m256 dy = _mm256_sub_ps(_mm256_loadu_ps(&this->y[j]), vy);
+        __m256 r = _mm256_add_ps(_mm256_loadu_ps(&this->radius[j]), vr);
+        __m256 distance =
+            _mm256_add_ps(_mm256_mul_ps(dx, dx), _mm256_mul_ps(dy, dy));
+        uint32_t mask = _mm256_movemask_ps(
+            _mm256_cmp_ps(distance, _mm256_mul_ps(r, r), _CMP_LT_OQ));
+        for (; mask; mask &= mask - 1)
+            cb(this->simulation, entity,
+               this->entities[j + __builtin_ctz(mask)], user_captures);
+    }
+#endif
+#if defined(__SSE2__)
+    __m128 sx = _mm_set1_ps(x);
+    __m128 sy = _mm_set1_ps(y);
+    __m128 sr = _mm_set1_ps(radius);
+    for (; j + 4 <= end; j += 4)
+    {
+        __m128 dx = _mm_sub_ps(_mm_loadu_ps(&this->x[j]), sx);
+        __m128 dy = _mm_sub_ps(_mm_loadu_ps(&this->y[j]), sy);
+        __m128 r = _mm_add_ps(_mm_loadu_ps(&this->radius[j]), sr);
+        __m128 distance = _mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy));
+        uint32_t mask =
+            _mm_movemask_ps(_mm_cmplt_ps(distance, _mm_mul_ps(r, r)));
+        for (; mask; mask &= mask - 1)
+            cb(this->simulation, entity,
+               this->entities[j + __builtin_ctz(mask)], user_captures);
+    }
+#endif
+    for (; j < end; ++j)
+    {
+        float dx = this->x[j] - x;
+        float dy = this->y[j] - y;
+        float r = this->radius[j] + radius;
+        if (dx * dx + dy * dy < r * r)
+            cb(this->simulation, entity, this->entities[j], user_captures);
+    }
+}
+
+// inlined into both callers so the range function is resolved at compile time
+static inline void find_pairs(struct rr_spatial_hash *this,
+                              void *user_captures, rr_spatial_hash_pair_cb cb,
+                              void (*range)(struct rr_spatial_hash *, uint32_t,
+                                            uint32_t, uint32_t, void *,
+                                            rr_spatial_hash_pair_cb))
+{
+    uint32_t *cell_starts = this->cell_starts;
+    // two circles can only touch if their centers are less than two maximum
+    // radii apart, so that is how many cells out the neighbours are checked.
+    // only half of the neighbourhood is visited so every pair comes up once:
+    // the columns to the left including this row, the columns to the right
+    // excluding it. cells of a column are contiguous, so every column is one
+    // range of the dense arrays
+    int32_t reach = ceilf(2 * this->max_radius / this->cell_size);
+    if (reach < 1)
+        reach = 1;
+    int32_t size = this->size;
+    for (int32_t x = 0; x < size; ++x)
+    {
+        int32_t s_x = x - reach < 0 ? 0 : x - reach;
+        int32_t e_x = x + reach >= size ? size - 1 : x + reach;
+        for (int32_t y = 0; y < size; ++y)
         {
-            struct rr_spatial_hash_cell *cell = spatial_hash_get(x, y);
-            for (uint64_t i = 0; i < cell->entities_in_use; ++i)
+            uint32_t cell = spatial_hash_cell(x, y);
+            uint32_t end = cell_starts[cell + 1];
+            if (cell_starts[cell] == end)
+                continue;
+            int32_t s_y = y - reach < 0 ? 0 : y - reach;
+            for (uint32_t i = cell_starts[cell]; i < end; ++i)
             {
-                for (uint64_t j = i + 1; j < cell->entities_in_use; ++j)
-                    cb(this->simulation, cell->entities[i], cell->entities[j],
-                       user_captures);
-                if (x > 0)
+                range(this, i, i + 1, end, user_captures, cb);
+                for (int32_t n_x = s_x; n_x <= e_x; ++n_x)
                 {
-                    struct rr_spatial_hash_cell *adj =
-                        spatial_hash_get(x - 1, y);
-                    for (uint64_t j = 0; j < adj->entities_in_use; ++j)
-                        cb(this->simulation, cell->entities[i],
-                           adj->entities[j], user_captures);
-                    if (y > 0)
-                    {
-                        struct rr_spatial_hash_cell *adj =
-                            spatial_hash_get(x - 1, y - 1);
-                        for (uint64_t j = 0; j < adj->entities_in_use; ++j)
-                            cb(this->simulation, cell->entities[i],
-                               adj->entities[j], user_captures);
-                    }
-                }
-                if (y > 0)
-                {
-                    struct rr_spatial_hash_cell *adj =
-                        spatial_hash_get(x, y - 1);
-                    for (uint64_t j = 0; j < adj->entities_in_use; ++j)
-                        cb(this->simulation, cell->entities[i],
-                           adj->entities[j], user_captures);
-                    if (x + 1 < this->size)
-                    {
-                        struct rr_spatial_hash_cell *adj =
-                            spatial_hash_get(x + 1, y - 1);
-                        for (uint64_t j = 0; j < adj->entities_in_use; ++j)
-                            cb(this->simulation, cell->entities[i],
-                               adj->entities[j], user_captures);
-                    }
+                    int32_t e_y = n_x < x ? y : y - 1;
+                    if (e_y < s_y)
+                        continue;
+                    range(this, i, cell_starts[spatial_hash_cell(n_x, s_y)],
+                          cell_starts[spatial_hash_cell(n_x, e_y) + 1],
+                          user_captures, cb);
                 }
             }
         }
     }
 }
 
+void rr_spatial_hash_find_possible_collisions(
+    struct rr_spatial_hash *this, void *user_captures,
+    void (*cb)(struct rr_simulation *, EntityIdx, EntityIdx, void *))
+{
+    find_pairs(this, user_captures, cb, pair_with_range);
+}
+
+void rr_spatial_hash_find_overlapping_pairs(
+    struct rr_spatial_hash *this, void *user_captures,
+    void (*cb)(struct rr_simulation *, EntityIdx, EntityIdx, void *))
+{
+    find_pairs(this, user_captures, cb, overlap_with_range);
+}
+
 void rr_spatial_hash_reset(struct rr_spatial_hash *this)
 {
-    for (uint64_t i = 0; i < this->size; i++)
-        for (uint64_t j = 0; j < this->size; j++)
-            this->cells[i * this->size + j].entities_in_use = 0;
-    // memset(&this->cells, 0, sizeof this->cells);
-}
\ No newline at end of file
+    // the dense cell ranges stay valid for queries until the next build
+    this->entity_count = 0;
+}
+
+void rr_spatial_hash_record(struct rr_spatial_hash *this, FILE *file)
+{
+    float extent = this->size * this->cell_size;
+    fwrite(&extent, sizeof extent, 1, file);
+    fwrite(&this->entity_count, sizeof this->entity_count, 1, file);
+    for (uint32_t i = 0; i < this->entity_count; ++i)
+    {
+        float position[3] = {this->x[i], this->y[i], this->radius[i]};
+        fwrite(position, sizeof position, 1, file);
+    }
+}
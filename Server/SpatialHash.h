@@ -16,37 +16,68 @@
 
 #pragma once
 
+#include <stdio.h>
+
 #include <Shared/Entity.h>
 #include <Shared/StaticData.h>
 
-#define SPATIAL_HASH_GRID_SIZE (1024)
-#define RR_SPATIAL_HASH_GRID_LENGTH                                            \
-    (((RR_ARENA_LENGTH + SPATIAL_HASH_GRID_SIZE - 1) / SPATIAL_HASH_GRID_SIZE))
-#define RR_SPATIAL_HASH_CELL_MAX_ENTITY_COUNT (2048)
+// lower bound for per-arena cell sizes, smaller cells make the per-cell
+// bookkeeping cost more than the pairs they save
+#define RR_SPATIAL_HASH_MIN_CELL_SIZE (128)
 
 struct rr_simulation;
 
-struct rr_spatial_hash_cell
+struct rr_spatial_hash_entry
 {
-    uint32_t entities_in_use;
-    EntityIdx entities[RR_SPATIAL_HASH_CELL_MAX_ENTITY_COUNT];
+    float x;
+    float y;
+    float radius;
+    uint32_t cell;
+    EntityIdx entity;
 };
 
+// Uniform grid that is rebuilt every tick. Inserts only queue the entity,
+// rr_spatial_hash_build then counting sorts everything by cell into dense
+// arrays so that a cell is the range [cell_starts[c], cell_starts[c + 1]).
+// x, y and radius are stored next to the entity so the narrowphase and
+// queries do not need to touch the physical components.
 struct rr_spatial_hash
 {
-    struct rr_spatial_hash_cell *cells;
+    uint32_t *cell_starts;
+    float *cell_max_radius;
+    struct rr_spatial_hash_entry *inserted;
+    EntityIdx *entities;
+    float *x;
+    float *y;
+    float *radius;
     struct rr_simulation *simulation;
+    float cell_size;
+    float max_radius;
     uint32_t size;
+    uint32_t entity_count;
+    uint32_t entity_capacity;
 };
 
 void rr_spatial_hash_init(struct rr_spatial_hash *, struct rr_simulation *,
-                          float);
-void rr_spatial_hash_insert(struct rr_spatial_hash *, EntityIdx);
-void rr_spatial_hash_update(struct rr_spatial_hash *, EntityIdx);
+                          float, float);
+void rr_spatial_hash_free(struct rr_spatial_hash *);
+void rr_spatial_hash_insert(struct rr_spatial_hash *, EntityIdx, float, float,
+                            float);
+// Must be called after the last insert and before any query
+void rr_spatial_hash_build(struct rr_spatial_hash *);
 void rr_spatial_hash_query(struct rr_spatial_hash *, float, float, float, float,
                            void *, void (*)(EntityIdx, void *));
 void rr_spatial_hash_find_possible_collisions(struct rr_spatial_hash *, void *,
                                               void (*)(struct rr_simulation *,
                                                        EntityIdx, EntityIdx,
                                                        void *));
-void rr_spatial_hash_reset(struct rr_spatial_hash *);
\ No newline at end of file
+// Like find_possible_collisions, but only calls back for pairs whose circles
+// overlap. The overlap test is batched over the dense cell arrays.
+void rr_spatial_hash_find_overlapping_pairs(struct rr_spatial_hash *, void *,
+                                            void (*)(struct rr_simulation *,
+                                                     EntityIdx, EntityIdx,
+                                                     void *));
+void rr_spatial_hash_reset(struct rr_spatial_hash *);
+// Appends the entities of the last build as one frame that
+// rrolf-spatial-hash-bench can replay
+void rr_spatial_hash_record(struct rr_spatial_hash *, FILE *);
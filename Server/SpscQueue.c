@@ -0,0 +1,96 @@
+// Copyright (C) 2024 Paul Johnson
+// Copyright (C) 2024-2025 Maxim Nesterov
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as
+// published by the Free Software Foundation, either version 3 of the
+// License, or (at your option) any later version.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Affero General Public License for more details.
+
+// You should have received a copy of the GNU Affero General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#include <Server/SpscQueue.h>
+
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+// records start 16 byte aligned, so whatever is left before the end of the
+// ring always fits the header of a skip record
+#define RECORD_SPACE(size)                                                     \
+    ((sizeof(struct rr_spsc_queue_record) + (size) + 15) & ~15ull)
+#define SKIP_RECORD (255)
+
+void rr_spsc_queue_init(struct rr_spsc_queue *this, uint64_t capacity)
+{
+    assert((capacity & (capacity - 1)) == 0);
+    memset(this, 0, sizeof *this);
+    this->data = aligned_alloc(16, capacity);
+    assert(this->data);
+    this->capacity = capacity;
+}
+
+void rr_spsc_queue_free(struct rr_spsc_queue *this) { free(this->data); }
+
+int rr_spsc_queue_push(struct rr_spsc_queue *this, uint8_t type,
+                       uint32_t socket, void const *data, uint32_t size)
+{
+    assert(type != SKIP_RECORD);
+    assert(size <= RR_SPSC_QUEUE_MAX_SIZE(this->capacity));
+    uint64_t tail = this->tail;
+    uint64_t head = __atomic_load_n(&this->head, __ATOMIC_ACQUIRE);
+    uint64_t space = RECORD_SPACE(size);
+    uint64_t offset = tail & (this->capacity - 1);
+    uint64_t skip =
+        this->capacity - offset < space ? this->capacity - offset : 0;
+    if (tail + skip + space - head > this->capacity)
+        return 0;
+    if (skip > 0)
+    {
+        struct rr_spsc_queue_record *record =
+            (struct rr_spsc_queue_record *)(this->data + offset);
+        record->type = SKIP_RECORD;
+        record->size = skip - sizeof *record;
+        tail += skip;
+        offset = 0;
+    }
+    struct rr_spsc_queue_record *record =
+        (struct rr_spsc_queue_record *)(this->data + offset);
+    record->type = type;
+    record->socket = socket;
+    record->size = size;
+    memcpy(record + 1, data, size);
+    __atomic_store_n(&this->tail, tail + space, __ATOMIC_RELEASE);
+    return 1;
+}
+
+struct rr_spsc_queue_record *rr_spsc_queue_peek(struct rr_spsc_queue *this)
+{
+    while (1)
+    {
+        uint64_t head = this->head;
+        if (head == __atomic_load_n(&this->tail, __ATOMIC_ACQUIRE))
+            return NULL;
+        struct rr_spsc_queue_record *record =
+            (struct rr_spsc_queue_record *)(this->data +
+                                            (head & (this->capacity - 1)));
+        if (record->type != SKIP_RECORD)
+            return record;
+        __atomic_store_n(&this->head, head + RECORD_SPACE(record->size),
+                         __ATOMIC_RELEASE);
+    }
+}
+
+void rr_spsc_queue_pop(struct rr_spsc_queue *this)
+{
+    struct rr_spsc_queue_record *record =
+        (struct rr_spsc_queue_record *)(this->data +
+                                        (this->head & (this->capacity - 1)));
+    __atomic_store_n(&this->head, this->head + RECORD_SPACE(record->size),
+                     __ATOMIC_RELEASE);
+}
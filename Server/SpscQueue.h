@@ -0,0 +1,56 @@
+// Copyright (C) 2024 Paul Johnson
+// Copyright (C) 2024-2025 Maxim Nesterov
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as
+// published by the Free Software Foundation, either version 3 of the
+// License, or (at your option) any later version.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Affero General Public License for more details.
+
+// You should have received a copy of the GNU Affero General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <stdint.h>
+
+// Bounded queue of variable size records between exactly one producer and
+// one consumer thread. Neither side ever waits, a push that does not fit
+// fails instead. Records are never split, one that would run past the end
+// of the ring leaves the rest of it to a skip record.
+struct rr_spsc_queue
+{
+    uint8_t *data;
+    uint64_t capacity; // power of two
+    uint64_t head;     // only written by the consumer
+    uint64_t tail;     // only written by the producer
+};
+
+// the payload follows the record
+struct rr_spsc_queue_record
+{
+    uint32_t size;
+    uint32_t socket;
+    uint8_t type;
+};
+
+// the largest payload that always fits once the consumer caught up. a
+// bigger one may never fit, depending on where in the ring it would start
+#define RR_SPSC_QUEUE_MAX_SIZE(capacity) ((capacity) / 2 - 32)
+
+void rr_spsc_queue_init(struct rr_spsc_queue *, uint64_t);
+void rr_spsc_queue_free(struct rr_spsc_queue *);
+
+// Producer side. Copies the payload in, returns 0 if there is no room. The
+// payload may be at most RR_SPSC_QUEUE_MAX_SIZE of the capacity
+int rr_spsc_queue_push(struct rr_spsc_queue *, uint8_t, uint32_t, void const *,
+                       uint32_t);
+
+// Consumer side. The oldest record or NULL if there is none, valid until it
+// is popped.
+struct rr_spsc_queue_record *rr_spsc_queue_peek(struct rr_spsc_queue *);
+void rr_spsc_queue_pop(struct rr_spsc_queue *);
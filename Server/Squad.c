@@ -26,7 +26,7 @@ void rr_squad_init(struct rr_squad *this, struct rr_server *server, uint8_t pos)
     memset(this, 0, sizeof *this);
     this->expose_code = 1;
     for (uint32_t i = 0; i < 6; ++i)
-        this->squad_code[i] = (char)(97 + rand() % 26);
+        this->squad_code[i] = (char)(97 + rr_rand() % 26);
     this->squad_code[6] = 0;
     for (uint32_t i = 0; i < RR_MAX_CLIENT_COUNT; ++i)
         rr_bitset_unset(server->clients[i].joined_squad_before, pos);
@@ -74,7 +74,7 @@ void rr_squad_remove_client(struct rr_squad *this,
         rr_squad_init(this, client->server, client->squad);
     else if (this->private && this->owner == client->squad_pos)
     {
-        uint8_t seed = rand() % this->member_count;
+        uint8_t seed = rr_rand() % this->member_count;
         for (uint8_t i = 0; i < RR_SQUAD_MEMBER_COUNT; ++i)
         {
             member = &this->members[i];
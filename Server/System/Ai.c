@@ -23,6 +23,7 @@
 #include <Server/Client.h>
 #include <Server/EntityAllocation.h>
 #include <Server/EntityDetection.h>
+#include <Server/FlowField.h>
 #include <Server/MobAi/Ai.h>
 #include <Server/Simulation.h>
 #include <Shared/Entity.h>
@@ -126,7 +127,40 @@ static void system_for_each(EntityIdx entity, void *simulation)
     --ai->ticks_until_next_action;
 }
 
+// the fields only move with the flower every few ticks, which is plenty for
+// mobs that steer by whole grids
+static void refresh_flow_fields(struct rr_simulation *this)
+{
+    for (EntityIdx i = 0; i < this->player_info_count; ++i)
+    {
+        struct rr_component_player_info *player_info =
+            rr_simulation_get_player_info(this, this->player_info_vector[i]);
+        if (player_info->flow_field_ticks > 0)
+        {
+            --player_info->flow_field_ticks;
+            continue;
+        }
+        if (player_info->flower_id == RR_NULL_ENTITY ||
+            is_dead_flower(this, player_info->flower_id))
+            continue;
+        struct rr_component_physical *physical =
+            rr_simulation_get_physical(this, player_info->flower_id);
+        struct rr_maze_declaration *maze =
+            rr_simulation_get_arena(this, physical->arena)->maze;
+        if (player_info->flow_field.maze != maze)
+        {
+            rr_flow_field_free(&player_info->flow_field);
+            rr_flow_field_init(&player_info->flow_field, maze);
+        }
+        rr_flow_field_build_position(&player_info->flow_field, physical->x,
+                                     physical->y,
+                                     RR_FLOW_FIELD_CHASE_DISTANCE);
+        player_info->flow_field_ticks = RR_FLOW_FIELD_REFRESH_TICKS;
+    }
+}
+
 void rr_system_ai_tick(struct rr_simulation *simulation)
 {
+    refresh_flow_fields(simulation);
     rr_simulation_for_each_ai(simulation, simulation, system_for_each);
 }
@@ -81,7 +81,7 @@ void rr_system_camera_tick(struct rr_simulation *this)
                 else
                 {
                     rr_component_player_info_set_spectate_target(
-                        player_info, target_vector[rand() % target_count]);
+                        player_info, target_vector[rr_rand() % target_count]);
                     if (is_dead_flower(this, player_info->spectate_target))
                         player_info->spectate_ticks = 62;
                     else
@@ -16,7 +16,9 @@
 
 #include <Server/System/System.h>
 
+#include <assert.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 
 #include <Server/Client.h>
@@ -36,29 +38,29 @@ static void system_reset_colliding_with(EntityIdx entity, void *captures)
     if (!rr_simulation_has_physical(this, entity))
         return;
 
-    struct rr_component_physical *physical =
-        rr_simulation_get_physical(this, entity);
-    physical->colliding_with_size = 0;
+    rr_simulation_get_physical(this, entity)->colliding_with_size = 0;
     EntityIdx owner = rr_simulation_get_relations(this, entity)->owner;
     if (rr_simulation_entity_alive(this, owner) &&
         rr_simulation_has_physical(this, owner))
-        if (physical->arena != rr_simulation_get_physical(this, owner)->arena)
+        if (rr_simulation_get_physical_arena(this, entity) !=
+            rr_simulation_get_physical_arena(this, owner))
             rr_simulation_request_entity_deletion(this, entity);
 }
 
 static void system_insert_entities(EntityIdx entity, void *_captures)
 {
     struct rr_simulation *this = _captures;
-    struct rr_component_physical *physical =
-        rr_simulation_get_physical(this, entity);
     if (rr_simulation_has_health(this, entity))
     {
         struct rr_component_health *health =
             rr_simulation_get_health(this, entity);
         rr_component_health_set_flags(health, health->flags & (~2));
     }
-    rr_spatial_hash_insert(
-        &rr_simulation_get_arena(this, physical->arena)->spatial_hash, entity);
+    EntityIdx arena = rr_simulation_get_physical_arena(this, entity);
+    rr_spatial_hash_insert(&rr_simulation_get_arena(this, arena)->spatial_hash,
+                           entity, rr_simulation_get_physical_x(this, entity),
+                           rr_simulation_get_physical_y(this, entity),
+                           rr_simulation_get_physical_radius(this, entity));
 }
 static uint8_t should_entities_collide(struct rr_simulation *this, EntityIdx a,
                                        EntityIdx b)
@@ -89,6 +91,9 @@ static uint8_t should_entities_collide(struct rr_simulation *this, EntityIdx a,
 
     return 1;
 }
+// only called for pairs that already overlap, so the component and team
+// filters below never run for the far more common pairs that merely share a
+// cell
 static void grid_filter_candidates(struct rr_simulation *this,
                                    EntityIdx entity1, EntityIdx entity2,
                                    void *_captures)
@@ -97,13 +102,13 @@ static void grid_filter_candidates(struct rr_simulation *this,
         rr_simulation_get_physical(this, entity1);
     struct rr_component_physical *physical2 =
         rr_simulation_get_physical(this, entity2);
+    if (physical1->bubbling || physical2->bubbling)
+        return;
     if (!should_entities_collide(this, entity1, entity2))
         return;
     if (is_dead_flower(this, entity1) ||
         is_dead_flower(this, entity2))
         return;
-    if (physical1->bubbling || physical2->bubbling)
-        return;
     if (rr_simulation_has_petal(this, entity1) &&
         rr_simulation_get_petal(this, entity1)->detached == 0 &&
         rr_simulation_get_physical(this,
@@ -125,16 +130,51 @@ static void grid_filter_candidates(struct rr_simulation *this,
     if (dev_cheat_enabled(this, entity1, no_collision) ||
         dev_cheat_enabled(this, entity2, no_collision))
         return;
-    struct rr_vector delta = {physical1->x - physical2->x,
-                              physical1->y - physical2->y};
-    float collision_radius = physical1->radius + physical2->radius;
-    if (rr_vector_magnitude_cmp(&delta, collision_radius) == -1)
+    if (physical1->colliding_with_size >= RR_MAX_COLLISION_COUNT)
     {
 #ifndef RIVET_BUILD
-        if (physical1->colliding_with_size >= RR_MAX_COLLISION_COUNT)
-            puts("entity cram limit exceeded");
+        puts("entity cram limit exceeded");
 #endif
-        physical1->colliding_with[physical1->colliding_with_size++] = entity2;
+        return;
+    }
+    ++physical1->colliding_with_size;
+    if (this->collision_pair_count == this->collision_pair_capacity)
+    {
+        uint32_t capacity = this->collision_pair_capacity == 0
+                                ? RR_MAX_ENTITY_COUNT
+                                : this->collision_pair_capacity * 2;
+        this->collision_pairs = realloc(
+            this->collision_pairs, capacity * sizeof *this->collision_pairs);
+        this->collision_pool = realloc(
+            this->collision_pool, capacity * sizeof *this->collision_pool);
+        assert(this->collision_pairs && this->collision_pool);
+        this->collision_pair_capacity = capacity;
+    }
+    this->collision_pairs[this->collision_pair_count][0] = entity1;
+    this->collision_pairs[this->collision_pair_count][1] = entity2;
+    ++this->collision_pair_count;
+}
+
+// lays every colliding_with list out back to back in collision_pool. pairs
+// keep the order the broadphase found them in
+static void pack_colliding_with(struct rr_simulation *this)
+{
+    uint32_t start = 0;
+    for (EntityIdx i = 0; i < this->physical_count; ++i)
+    {
+        struct rr_component_physical *physical =
+            rr_simulation_get_physical(this, this->physical_vector[i]);
+        physical->colliding_with_start = start;
+        start += physical->colliding_with_size;
+        physical->colliding_with_size = 0;
+    }
+    for (uint32_t i = 0; i < this->collision_pair_count; ++i)
+    {
+        struct rr_component_physical *physical =
+            rr_simulation_get_physical(this, this->collision_pairs[i][0]);
+        this->collision_pool[physical->colliding_with_start +
+                             physical->colliding_with_size++] =
+            this->collision_pairs[i][1];
     }
 }
 
@@ -158,18 +198,39 @@ static void collapse_arena(EntityIdx entity, void *_captures)
         rr_simulation_request_entity_deletion(this, entity);
 }
 
+static FILE *spatial_hash_record_file(void)
+{
+    // RR_SPATIAL_HASH_RECORD=<path> appends every broadphase frame of every
+    // arena to <path> for rrolf-spatial-hash-bench to replay
+    static FILE *file = NULL;
+    static uint8_t checked = 0;
+    if (checked)
+        return file;
+    checked = 1;
+    char const *path = getenv("RR_SPATIAL_HASH_RECORD");
+    if (path != NULL && (file = fopen(path, "ab")) == NULL)
+        fprintf(stderr, "could not open spatial hash record %s\n", path);
+    return file;
+}
+
 static void find_collisions(EntityIdx entity, void *_captures)
 {
     struct rr_simulation *this = _captures;
     struct rr_component_arena *arena = rr_simulation_get_arena(this, entity);
-    rr_spatial_hash_find_possible_collisions(&arena->spatial_hash, NULL,
-                                             grid_filter_candidates);
+    rr_spatial_hash_build(&arena->spatial_hash);
+    FILE *record = spatial_hash_record_file();
+    if (record != NULL)
+        rr_spatial_hash_record(&arena->spatial_hash, record);
+    rr_spatial_hash_find_overlapping_pairs(&arena->spatial_hash, NULL,
+                                           grid_filter_candidates);
 }
 
 void rr_system_collision_detection_tick(struct rr_simulation *this)
 {
     rr_simulation_for_each_arena(this, this, collapse_arena);
+    this->collision_pair_count = 0;
     rr_simulation_for_each_physical(this, this, system_reset_colliding_with);
     rr_simulation_for_each_physical(this, this, system_insert_entities);
     rr_simulation_for_each_arena(this, this, find_collisions);
+    pack_colliding_with(this);
 }
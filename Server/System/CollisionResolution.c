@@ -81,7 +81,7 @@ static void enter_arena(struct rr_simulation *this, EntityIdx arena,
     struct rr_component_player_info *player_info =
         rr_simulation_get_player_info(
             this, rr_simulation_get_relations(this, enterer)->root_owner);
-    physical->arena = arena;
+    rr_component_physical_set_arena(physical, arena);
     struct rr_component_arena *a = rr_simulation_get_arena(this, arena);
     struct rr_spawn_zone *respawn_zone = &a->respawn_zone;
     rr_component_physical_set_x(
@@ -238,8 +238,10 @@ static void system_for_each_function(EntityIdx entity, void *_captures)
     captures.physical = physical;
     captures.simulation = this;
 
+    EntityIdx *colliding_with =
+        rr_simulation_get_colliding_with(this, physical);
     for (uint64_t i = 0; i < physical->colliding_with_size; ++i)
-        colliding_with_function(physical->colliding_with[i], &captures);
+        colliding_with_function(colliding_with[i], &captures);
 }
 
 static void system_reset_collision_velocity(EntityIdx entity, void *_captures)
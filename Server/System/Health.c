@@ -395,8 +395,10 @@ static void system_for_each_function(EntityIdx entity, void *_captures)
     captures.health = health;
     captures.simulation = this;
 
+    EntityIdx *colliding_with =
+        rr_simulation_get_colliding_with(this, physical);
     for (uint32_t i = 0; i < physical->colliding_with_size; ++i)
-        colliding_with_function(physical->colliding_with[i], &captures);
+        colliding_with_function(colliding_with[i], &captures);
 }
 
 void rr_system_health_tick(struct rr_simulation *this)
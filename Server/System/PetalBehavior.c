@@ -811,7 +811,7 @@ system_nest_egg_choosing_logic(struct rr_simulation *simulation,
     if (nest_count > 0)
         relations->nest =
             rr_simulation_get_entity_hash(simulation,
-                                          nest_vector[rand() % nest_count]);
+                                          nest_vector[rr_rand() % nest_count]);
 }
 
 static void system_nest_egg_movement_logic(struct rr_simulation *simulation,
@@ -1071,7 +1071,7 @@ static void system_petal_misc_logic(EntityIdx id, void *_simulation)
                 rr_component_physical_set_radius(nest_physical, 250);
                 rr_component_physical_set_angle(nest_physical, rr_frand() * 2 * M_PI);
                 nest_physical->friction = 0.75;
-                nest_physical->arena = physical->arena;
+                rr_component_physical_set_arena(nest_physical, physical->arena);
                 struct rr_component_relations *nest_relations =
                     rr_simulation_add_relations(simulation, nest_id);
                 rr_component_relations_set_team(nest_relations, relations->team);
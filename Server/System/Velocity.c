@@ -26,7 +26,7 @@
 
 static void perform_internal_bound_check_custom_grid(
     struct rr_component_arena *arena, float test_x, float test_y, int32_t x,
-    int32_t y, struct rr_component_physical *physical)
+    int32_t y, float radius, struct rr_component_physical *physical)
 {
     // add a check for in-wall
     uint32_t size = arena->maze->maze_dim;
@@ -39,21 +39,21 @@ static void perform_internal_bound_check_custom_grid(
 #define curve_check                                                            \
     {                                                                          \
         struct rr_vector dist = {test_x - cx, test_y - cy};                    \
-        if (rr_vector_magnitude_cmp(&dist, maze_dim - physical->radius) ==     \
+        if (rr_vector_magnitude_cmp(&dist, maze_dim - radius) ==     \
                 1 &&                                                           \
             inverse == 0)                                                      \
         {                                                                      \
-            rr_vector_set_magnitude(&dist, maze_dim - physical->radius);       \
+            rr_vector_set_magnitude(&dist, maze_dim - radius);       \
             rr_component_physical_set_x(physical, cx + dist.x);                \
             rr_component_physical_set_y(physical, cy + dist.y);                \
             rr_vector_set(&physical->wall_collision, -dist.x, -dist.y);        \
             return;                                                            \
         }                                                                      \
-        if (rr_vector_magnitude_cmp(&dist, maze_dim + physical->radius) ==     \
+        if (rr_vector_magnitude_cmp(&dist, maze_dim + radius) ==     \
                 -1 &&                                                          \
             inverse == 1)                                                      \
         {                                                                      \
-            rr_vector_set_magnitude(&dist, maze_dim + physical->radius);       \
+            rr_vector_set_magnitude(&dist, maze_dim + radius);       \
             rr_component_physical_set_x(physical, cx + dist.x);                \
             rr_component_physical_set_y(physical, cy + dist.y);                \
             rr_vector_set(&physical->wall_collision, dist.x, dist.y);          \
@@ -74,12 +74,12 @@ static void perform_internal_bound_check_custom_grid(
         float cy = (y + top) * maze_dim;
         curve_check;
     }
-    if (offset(-1, 0) != 1 && test_x - x * maze_dim < physical->radius)
+    if (offset(-1, 0) != 1 && test_x - x * maze_dim < radius)
     {
         uint8_t tile = offset(-1, 0);
         if (tile == 0)
         {
-            test_x = x * maze_dim + physical->radius;
+            test_x = x * maze_dim + radius;
             rr_component_physical_set_x(physical, test_x);
             rr_component_physical_set_y(physical, test_y);
             rr_vector_set(&physical->wall_collision, 1, 0);
@@ -95,12 +95,12 @@ static void perform_internal_bound_check_custom_grid(
             curve_check;
         }
     }
-    if (offset(0, -1) != 1 && test_y - y * maze_dim < physical->radius)
+    if (offset(0, -1) != 1 && test_y - y * maze_dim < radius)
     {
         uint8_t tile = offset(0, -1);
         if (tile == 0)
         {
-            test_y = y * maze_dim + physical->radius;
+            test_y = y * maze_dim + radius;
             rr_component_physical_set_x(physical, test_x);
             rr_component_physical_set_y(physical, test_y);
             rr_vector_set(&physical->wall_collision, 0, 1);
@@ -116,12 +116,12 @@ static void perform_internal_bound_check_custom_grid(
             curve_check;
         }
     }
-    if (offset(1, 0) != 1 && (x + 1) * maze_dim - test_x < physical->radius)
+    if (offset(1, 0) != 1 && (x + 1) * maze_dim - test_x < radius)
     {
         uint8_t tile = offset(1, 0);
         if (tile == 0)
         {
-            test_x = (x + 1) * maze_dim - physical->radius;
+            test_x = (x + 1) * maze_dim - radius;
             rr_component_physical_set_x(physical, test_x);
             rr_component_physical_set_y(physical, test_y);
             rr_vector_set(&physical->wall_collision, -1, 0);
@@ -137,12 +137,12 @@ static void perform_internal_bound_check_custom_grid(
             curve_check;
         }
     }
-    if (offset(0, 1) != 1 && (y + 1) * maze_dim - test_y < physical->radius)
+    if (offset(0, 1) != 1 && (y + 1) * maze_dim - test_y < radius)
     {
         uint8_t tile = offset(0, 1);
         if (tile == 0)
         {
-            test_y = (y + 1) * maze_dim - physical->radius;
+            test_y = (y + 1) * maze_dim - radius;
             rr_component_physical_set_x(physical, test_x);
             rr_component_physical_set_y(physical, test_y);
             rr_vector_set(&physical->wall_collision, 0, -1);
@@ -166,12 +166,13 @@ static void perform_internal_bound_check_custom_grid(
 
 static void perform_internal_bound_check(struct rr_component_arena *arena,
                                          float test_x, float test_y,
+                                         float radius,
                                          struct rr_component_physical *physical)
 {
     int32_t x = test_x / arena->maze->grid_size;
     int32_t y = test_y / arena->maze->grid_size;
     perform_internal_bound_check_custom_grid(arena, test_x, test_y, x, y,
-                                             physical);
+                                             radius, physical);
 }
 
 static float reverse_lerp(float test, float start, float end)
@@ -254,19 +255,20 @@ static void system_velocity(EntityIdx id, void *simulation)
     }
     rr_vector_set(&physical->acceleration, 0, 0);
     rr_vector_set(&physical->wall_collision, 0, 0);
-    struct rr_component_arena *arena =
-        rr_simulation_get_arena(simulation, physical->arena);
+    struct rr_component_arena *arena = rr_simulation_get_arena(
+        simulation, rr_simulation_get_physical_arena(simulation, id));
     if (rr_vector_magnitude_cmp(&vel, arena->maze->grid_size) == 1)
         rr_vector_set_magnitude(&vel, arena->maze->grid_size);
-    float before_x = physical->x;
-    float before_y = physical->y;
+    float before_x = rr_simulation_get_physical_x(simulation, id);
+    float before_y = rr_simulation_get_physical_y(simulation, id);
+    float radius = rr_simulation_get_physical_radius(simulation, id);
     int32_t extra = 3;
-    float now_x = rr_fclamp(before_x + vel.x, physical->radius - extra * arena->maze->grid_size,
+    float now_x = rr_fclamp(before_x + vel.x, radius - extra * arena->maze->grid_size,
                             (arena->maze->maze_dim + extra) * arena->maze->grid_size -
-                                physical->radius);
-    float now_y = rr_fclamp(before_y + vel.y, physical->radius - extra * arena->maze->grid_size,
+                                radius);
+    float now_y = rr_fclamp(before_y + vel.y, radius - extra * arena->maze->grid_size,
                             (arena->maze->maze_dim + extra) * arena->maze->grid_size -
-                                physical->radius);
+                                radius);
 
     if (physical->bubbling_to_death &&
         (now_x < 0 || now_x > arena->maze->maze_dim * arena->maze->grid_size ||
@@ -304,7 +306,7 @@ static void system_velocity(EntityIdx id, void *simulation)
                                        before_grid_y + b)                      \
                ->value)
     if (before_grid_x == now_grid_x && before_grid_y == now_grid_y)
-        perform_internal_bound_check(arena, now_x, now_y, physical);
+        perform_internal_bound_check(arena, now_x, now_y, radius, physical);
     else
     {
         float border_phase[4];
@@ -334,7 +336,7 @@ static void system_velocity(EntityIdx id, void *simulation)
                 now_y = rr_fclamp(now_y, before_grid_y * arena->maze->grid_size,
                                   (before_grid_y + 1) * arena->maze->grid_size);
                 perform_internal_bound_check_custom_grid(
-                    arena, now_x, now_y, before_grid_x, before_grid_y,
+                    arena, now_x, now_y, before_grid_x, before_grid_y, radius,
                     physical);
             }
             else
@@ -347,22 +349,22 @@ static void system_velocity(EntityIdx id, void *simulation)
                         now_x = rr_fclamp(
                             now_x,
                             before_grid_x * arena->maze->grid_size +
-                                physical->radius,
+                                radius,
                             (before_grid_x + 1) * arena->maze->grid_size -
-                                physical->radius);
+                                radius);
                     else
                         now_y = rr_fclamp(
                             now_y,
                             before_grid_y * arena->maze->grid_size +
-                                physical->radius,
+                                radius,
                             (before_grid_y + 1) * arena->maze->grid_size -
-                                physical->radius);
+                                radius);
                     rr_component_physical_set_x(physical, now_x);
                     rr_component_physical_set_y(physical, now_y);
                 }
                 perform_internal_bound_check_custom_grid(
                     arena, now_x, now_y, before_grid_x + hor,
-                    before_grid_y + ver, physical);
+                    before_grid_y + ver, radius, physical);
             }
         }
         else
@@ -375,22 +377,22 @@ static void system_velocity(EntityIdx id, void *simulation)
                     now_x =
                         rr_fclamp(now_x,
                                   before_grid_x * arena->maze->grid_size +
-                                      physical->radius,
+                                      radius,
                                   (before_grid_x + 1) * arena->maze->grid_size -
-                                      physical->radius);
+                                      radius);
                 else
                     now_y =
                         rr_fclamp(now_y,
                                   before_grid_y * arena->maze->grid_size +
-                                      physical->radius,
+                                      radius,
                                   (before_grid_y + 1) * arena->maze->grid_size -
-                                      physical->radius);
+                                      radius);
                 rr_component_physical_set_x(physical, now_x);
                 rr_component_physical_set_y(physical, now_y);
             }
             perform_internal_bound_check_custom_grid(
                 arena, now_x, now_y, before_grid_x + hor, before_grid_y + ver,
-                physical);
+                radius, physical);
         }
     }
 }
@@ -49,7 +49,7 @@ static uint8_t has_new_target(struct rr_component_ai *ai,
         {
             ai->target_entity = RR_NULL_ENTITY;
             ai->ai_state = rr_ai_state_idle;
-            ai->ticks_until_next_action = rand() % 25 + 25;
+            ai->ticks_until_next_action = rr_rand() % 25 + 25;
         }
         struct rr_component_relations *relations =
             rr_simulation_get_relations(simulation, ai->parent_id);
@@ -74,7 +74,7 @@ static void tick_idle(EntityIdx entity, struct rr_simulation *simulation)
 
     if (ai->ticks_until_next_action == 0)
     {
-        ai->ticks_until_next_action = rand() % 33 + 25;
+        ai->ticks_until_next_action = rr_rand() % 33 + 25;
         ai->ai_state = rr_ai_state_idle_moving;
         rr_component_physical_set_angle(
             physical, physical->angle + (rr_frand() - 0.5) * M_PI);
@@ -112,7 +112,7 @@ static void tick_idle_moving(EntityIdx entity, struct rr_simulation *simulation)
 
     if (ai->ticks_until_next_action == 0)
     {
-        ai->ticks_until_next_action = rand() % 50 + 25;
+        ai->ticks_until_next_action = rr_rand() % 50 + 25;
         ai->ai_state = rr_ai_state_idle;
     }
     struct rr_vector accel;
@@ -208,7 +208,7 @@ static void tick_ai_aggro_triceratops(EntityIdx entity,
         if (ai->ticks_until_next_action == 0)
         {
             ai->ai_state = rr_ai_state_attacking;
-            ai->ticks_until_next_action = rand() % 25 + 33;
+            ai->ticks_until_next_action = rr_rand() % 25 + 33;
             break;
         }
 
@@ -228,7 +228,7 @@ static void tick_ai_aggro_triceratops(EntityIdx entity,
         if (ai->ticks_until_next_action == 0)
         {
             ai->ai_state = rr_ai_state_waiting_to_attack;
-            ai->ticks_until_next_action = rand() % 25 + 25;
+            ai->ticks_until_next_action = rr_rand() % 25 + 25;
             break;
         }
 
@@ -367,7 +367,7 @@ static void tick_ai_aggro_pteranodon(EntityIdx entity,
         if (ai->ticks_until_next_action == 0)
         {
             ai->ai_state = rr_ai_state_attacking;
-            ai->ticks_until_next_action = rand() % 25 + 38;
+            ai->ticks_until_next_action = rr_rand() % 25 + 38;
 
             struct rr_component_mob *mob =
                 rr_simulation_get_mob(simulation, entity);
@@ -434,7 +434,7 @@ static void tick_ai_aggro_pachycephalosaurus(EntityIdx entity,
         if (ai->ticks_until_next_action == 0)
         {
             ai->ai_state = rr_ai_state_attacking;
-            ai->ticks_until_next_action = rand() % 25 + 33;
+            ai->ticks_until_next_action = rr_rand() % 25 + 33;
             break;
         }
 
@@ -454,7 +454,7 @@ static void tick_ai_aggro_pachycephalosaurus(EntityIdx entity,
         if (ai->ticks_until_next_action == 0)
         {
             ai->ai_state = rr_ai_state_waiting_to_attack;
-            ai->ticks_until_next_action = rand() % 25 + 25;
+            ai->ticks_until_next_action = rr_rand() % 25 + 25;
             break;
         }
 
@@ -530,7 +530,7 @@ static void tick_ai_aggro_ankylosaurus(EntityIdx entity,
         if (ai->ticks_until_next_action == 0)
         {
             ai->ai_state = rr_ai_state_attacking;
-            ai->ticks_until_next_action = rand() % 25 + 33;
+            ai->ticks_until_next_action = rr_rand() % 25 + 33;
             break;
         }
 
@@ -552,7 +552,7 @@ static void tick_ai_aggro_ankylosaurus(EntityIdx entity,
         if (ai->ticks_until_next_action == 0)
         {
             ai->ai_state = rr_ai_state_waiting_to_attack;
-            ai->ticks_until_next_action = rand() % 25 + 25;
+            ai->ticks_until_next_action = rr_rand() % 25 + 25;
             break;
         }
 
@@ -663,7 +663,7 @@ static void tick_ai_aggro_quetzalcoatlus(EntityIdx entity,
         if (ai->ticks_until_next_action == 0)
         {
             ai->ai_state = rr_ai_state_waiting_to_attack;
-            ai->ticks_until_next_action = rand() % 12 + 18;
+            ai->ticks_until_next_action = rr_rand() % 12 + 18;
             break;
         }
 
@@ -898,7 +898,7 @@ static void system_for_each(EntityIdx entity, void *simulation)
         else if (ai->ai_state == rr_ai_state_returning_to_owner)
         {
             ai->ai_state = rr_ai_state_idle;
-            ai->ticks_until_next_action = rand() % 25 + 25;
+            ai->ticks_until_next_action = rr_rand() % 25 + 25;
         }
     }
 
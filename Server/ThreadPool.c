@@ -0,0 +1,107 @@
+// Copyright (C) 2024 Paul Johnson
+// Copyright (C) 2024-2025 Maxim Nesterov
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as
+// published by the Free Software Foundation, either version 3 of the
+// License, or (at your option) any later version.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Affero General Public License for more details.
+
+// You should have received a copy of the GNU Affero General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#include <Server/ThreadPool.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static void rr_thread_pool_drain(struct rr_thread_pool *this, uint32_t worker)
+{
+    while (1)
+    {
+        uint32_t job = __atomic_fetch_add(&this->next_job, 1, __ATOMIC_RELAXED);
+        if (job >= this->job_count)
+            return;
+        this->cb(job, worker, this->captures);
+    }
+}
+
+static void *rr_thread_pool_worker_main(void *_worker)
+{
+    struct rr_thread_pool_worker *worker = _worker;
+    struct rr_thread_pool *this = worker->pool;
+    uint32_t generation = 0;
+    while (1)
+    {
+        pthread_mutex_lock(&this->mutex);
+        while (this->generation == generation)
+            pthread_cond_wait(&this->work_ready, &this->mutex);
+        generation = this->generation;
+        pthread_mutex_unlock(&this->mutex);
+
+        rr_thread_pool_drain(this, worker->index);
+
+        pthread_mutex_lock(&this->mutex);
+        if (--this->workers_busy == 0)
+            pthread_cond_signal(&this->work_done);
+        pthread_mutex_unlock(&this->mutex);
+    }
+    return NULL;
+}
+
+void rr_thread_pool_init(struct rr_thread_pool *this, uint32_t worker_count)
+{
+    memset(this, 0, sizeof *this);
+    if (worker_count < 1)
+        worker_count = 1;
+    if (worker_count > RR_THREAD_POOL_MAX_WORKER_COUNT)
+        worker_count = RR_THREAD_POOL_MAX_WORKER_COUNT;
+    this->worker_count = worker_count;
+    pthread_mutex_init(&this->mutex, NULL);
+    pthread_cond_init(&this->work_ready, NULL);
+    pthread_cond_init(&this->work_done, NULL);
+    for (uint32_t i = 1; i < worker_count; ++i)
+    {
+        struct rr_thread_pool_worker *worker = &this->workers[i];
+        worker->pool = this;
+        worker->index = i;
+        if (pthread_create(&worker->thread, NULL, rr_thread_pool_worker_main,
+                           worker) != 0)
+        {
+            fprintf(stderr, "thread pool: could not spawn worker %u\n", i);
+            exit(1);
+        }
+        pthread_detach(worker->thread);
+    }
+}
+
+void rr_thread_pool_run(struct rr_thread_pool *this, uint32_t job_count,
+                        void *captures, void (*cb)(uint32_t, uint32_t, void *))
+{
+    this->cb = cb;
+    this->captures = captures;
+    this->job_count = job_count;
+    this->next_job = 0;
+    if (this->worker_count == 1)
+    {
+        rr_thread_pool_drain(this, 0);
+        return;
+    }
+    pthread_mutex_lock(&this->mutex);
+    this->workers_busy = this->worker_count - 1;
+    ++this->generation;
+    pthread_cond_broadcast(&this->work_ready);
+    pthread_mutex_unlock(&this->mutex);
+
+    rr_thread_pool_drain(this, 0);
+
+    pthread_mutex_lock(&this->mutex);
+    while (this->workers_busy > 0)
+        pthread_cond_wait(&this->work_done, &this->mutex);
+    pthread_mutex_unlock(&this->mutex);
+}
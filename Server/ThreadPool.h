@@ -0,0 +1,55 @@
+// Copyright (C) 2024 Paul Johnson
+// Copyright (C) 2024-2025 Maxim Nesterov
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as
+// published by the Free Software Foundation, either version 3 of the
+// License, or (at your option) any later version.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Affero General Public License for more details.
+
+// You should have received a copy of the GNU Affero General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <pthread.h>
+#include <stdint.h>
+
+#define RR_THREAD_POOL_MAX_WORKER_COUNT (16)
+
+struct rr_thread_pool;
+
+struct rr_thread_pool_worker
+{
+    struct rr_thread_pool *pool;
+    pthread_t thread;
+    uint32_t index;
+};
+
+// Fork-join pool. The calling thread acts as worker 0, so a pool with a
+// worker count of 1 never spawns a thread and runs every job inline.
+struct rr_thread_pool
+{
+    struct rr_thread_pool_worker workers[RR_THREAD_POOL_MAX_WORKER_COUNT];
+    pthread_mutex_t mutex;
+    pthread_cond_t work_ready;
+    pthread_cond_t work_done;
+    void (*cb)(uint32_t, uint32_t, void *);
+    void *captures;
+    uint32_t worker_count;
+    uint32_t generation;
+    uint32_t job_count;
+    uint32_t next_job;
+    uint32_t workers_busy;
+};
+
+void rr_thread_pool_init(struct rr_thread_pool *, uint32_t);
+// Calls cb(job, worker, captures) once for every job in [0, job_count) and
+// returns after all of them finished. Jobs are claimed dynamically so there
+// is no guarantee about which worker runs which job.
+void rr_thread_pool_run(struct rr_thread_pool *, uint32_t, void *,
+                        void (*)(uint32_t, uint32_t, void *));
@@ -62,11 +62,16 @@ static void rr_simulation_write_entity_function(uint64_t _id, void *_captures)
     uint32_t component_flags = simulation->entity_tracker[id];
     proto_bug_write_uint8(encoder, is_creation, "upcreate");
     proto_bug_write_varuint(encoder, component_flags, "entity component flags");
+    uint64_t *component_bytes = player_info->client->net_stats.component_bytes;
 #define XX(COMPONENT, ID)                                                      \
     if (component_flags & (1 << ID))                                           \
+    {                                                                          \
+        uint8_t *start = encoder->current;                                     \
         rr_component_##COMPONENT##_write(                                      \
             rr_simulation_get_##COMPONENT(simulation, id), encoder,            \
-            is_creation, player_info);
+            is_creation, player_info);                                         \
+        component_bytes[ID] += encoder->current - start;                       \
+    }
     RR_FOR_EACH_COMPONENT;
 #undef XX
 }
@@ -96,16 +101,13 @@ rr_simulation_find_entities_in_view_for_each_function(EntityIdx entity,
             rr_simulation_get_entity_hash(simulation, captures->player_info->parent_id))
         return;
 
-    struct rr_component_physical *physical =
-        rr_simulation_get_physical(simulation, entity);
-    if (physical->x + physical->radius <
-            captures->view_x - captures->view_width ||
-        physical->x - physical->radius >
-            captures->view_x + captures->view_width ||
-        physical->y + physical->radius <
-            captures->view_y - captures->view_height ||
-        physical->y - physical->radius >
-            captures->view_y + captures->view_height)
+    float x = rr_simulation_get_physical_x(simulation, entity);
+    float y = rr_simulation_get_physical_y(simulation, entity);
+    float radius = rr_simulation_get_physical_radius(simulation, entity);
+    if (x + radius < captures->view_x - captures->view_width ||
+        x - radius > captures->view_x + captures->view_width ||
+        y + radius < captures->view_y - captures->view_height ||
+        y - radius > captures->view_y + captures->view_height)
         return;
     uint8_t i = captures->player_info->client - simulation->server->clients;
     if (rr_simulation_has_drop(simulation, entity) &&
@@ -137,8 +139,6 @@ static void rr_simulation_find_entities_in_view(
     if (entity_alive(this, (EntityIdx)player_info->flower_id))
         rr_bitset_set(entities_in_view, (EntityIdx)player_info->flower_id);
 
-    if (!entity_alive(this, player_info->arena))
-        rr_component_player_info_set_arena(player_info, 1);
     rr_bitset_set(captures.entities_in_view, player_info->arena);
     rr_bitset_set(captures.entities_in_view, 1);
     struct rr_spatial_hash *shg =
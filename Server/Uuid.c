@@ -0,0 +1,85 @@
+// Copyright (C) 2024 Paul Johnson
+// Copyright (C) 2024-2025 Maxim Nesterov
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as
+// published by the Free Software Foundation, either version 3 of the
+// License, or (at your option) any later version.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Affero General Public License for more details.
+
+// You should have received a copy of the GNU Affero General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#include <Server/Uuid.h>
+
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+static uint32_t hash_uuid(char const *uuid)
+{
+    // fnv-1a
+    uint32_t hash = 2166136261u;
+    for (; *uuid != 0; ++uuid)
+        hash = (hash ^ (uint8_t)*uuid) * 16777619u;
+    return hash;
+}
+
+static void insert_slot(struct rr_uuid_table *this, uint32_t id)
+{
+    uint32_t mask = this->slot_capacity - 1;
+    uint32_t slot = hash_uuid(this->uuids[id]) & mask;
+    while (this->slots[slot] != 0)
+        slot = (slot + 1) & mask;
+    this->slots[slot] = id;
+}
+
+void rr_uuid_table_init(struct rr_uuid_table *this)
+{
+    memset(this, 0, sizeof *this);
+    this->uuid_capacity = 256;
+    this->slot_capacity = 512;
+    this->uuids = malloc(this->uuid_capacity * sizeof *this->uuids);
+    this->slots = calloc(this->slot_capacity, sizeof *this->slots);
+    assert(this->uuids && this->slots);
+    this->uuids[0] = "";
+    this->count = 1;
+}
+
+uint32_t rr_uuid_table_intern(struct rr_uuid_table *this, char const *uuid)
+{
+    if (uuid[0] == 0)
+        return 0;
+    uint32_t mask = this->slot_capacity - 1;
+    for (uint32_t slot = hash_uuid(uuid) & mask; this->slots[slot] != 0;
+         slot = (slot + 1) & mask)
+        if (strcmp(this->uuids[this->slots[slot]], uuid) == 0)
+            return this->slots[slot];
+    if (this->count == this->uuid_capacity)
+    {
+        this->uuid_capacity *= 2;
+        this->uuids =
+            realloc(this->uuids, this->uuid_capacity * sizeof *this->uuids);
+        assert(this->uuids);
+    }
+    uint32_t id = this->count++;
+    this->uuids[id] = strdup(uuid);
+    assert(this->uuids[id]);
+    // keep the load factor at or below one half
+    if (this->count * 2 > this->slot_capacity)
+    {
+        free(this->slots);
+        this->slot_capacity *= 2;
+        this->slots = calloc(this->slot_capacity, sizeof *this->slots);
+        assert(this->slots);
+        for (uint32_t i = 1; i < this->count; ++i)
+            insert_slot(this, i);
+    }
+    else
+        insert_slot(this, id);
+    return id;
+}
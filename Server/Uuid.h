@@ -0,0 +1,34 @@
+// Copyright (C) 2024 Paul Johnson
+// Copyright (C) 2024-2025 Maxim Nesterov
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as
+// published by the Free Software Foundation, either version 3 of the
+// License, or (at your option) any later version.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Affero General Public License for more details.
+
+// You should have received a copy of the GNU Affero General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <stdint.h>
+
+// Interns account uuids to small ids so they can be compared and stored as
+// integers. Ids are never reused while the server runs, id 0 is the empty
+// uuid.
+struct rr_uuid_table
+{
+    char const **uuids;
+    uint32_t *slots; // open addressed, 0 is an empty slot
+    uint32_t count;
+    uint32_t uuid_capacity;
+    uint32_t slot_capacity;
+};
+
+void rr_uuid_table_init(struct rr_uuid_table *);
+uint32_t rr_uuid_table_intern(struct rr_uuid_table *, char const *);
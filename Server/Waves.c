@@ -23,32 +23,115 @@
 #include <Shared/StaticData.h>
 #include <Shared/Utilities.h>
 
-uint32_t get_spawn_rarity(float difficulty)
+// Walker's alias method: one column per mob id, a spawn picks a column
+// uniformly and then either the column's own id or its alias
+struct spawn_alias_table
 {
-    if (difficulty < 1)
-        difficulty = 1;
-    double rarity_seed = rr_frand();
+    double probability[rr_mob_id_max];
+    uint8_t alias[rr_mob_id_max];
+};
+
+static struct spawn_alias_table spawn_alias_tables[rr_biome_id_max];
+
+static double spawn_rarity_threshold(uint32_t rarity, float difficulty)
+{
+    return pow(1 - (1 - RR_MOB_WAVE_RARITY_COEFFICIENTS[rarity + 1]) * 0.3,
+               pow(1.5, difficulty));
+}
+
+// Vose's construction from the cumulative id table
+static void init_spawn_alias_table(struct spawn_alias_table *this,
+                                   double *table)
+{
+    double scaled[rr_mob_id_max];
+    uint8_t small[rr_mob_id_max];
+    uint8_t large[rr_mob_id_max];
+    uint32_t small_count = 0;
+    uint32_t large_count = 0;
+    for (uint8_t id = 0; id < rr_mob_id_max; ++id)
+    {
+        scaled[id] = (table[id] - (id == 0 ? 0 : table[id - 1])) *
+                     rr_mob_id_max;
+        if (scaled[id] < 1)
+            small[small_count++] = id;
+        else
+            large[large_count++] = id;
+    }
+    while (small_count > 0 && large_count > 0)
+    {
+        uint8_t less = small[--small_count];
+        uint8_t more = large[--large_count];
+        this->probability[less] = scaled[less];
+        this->alias[less] = more;
+        scaled[more] -= 1 - scaled[less];
+        if (scaled[more] < 1)
+            small[small_count++] = more;
+        else
+            large[large_count++] = more;
+    }
+    // whatever is left is 1 up to rounding
+    while (large_count > 0)
+    {
+        uint8_t id = large[--large_count];
+        this->probability[id] = 1;
+        this->alias[id] = id;
+    }
+    while (small_count > 0)
+    {
+        uint8_t id = small[--small_count];
+        this->probability[id] = 1;
+        this->alias[id] = id;
+    }
+}
+
+// Caches the thresholds get_spawn_rarity compares against. Grids never
+// change difficulty, so these stay valid for the lifetime of the maze.
+static void init_spawn_rarity(struct rr_maze_grid *grid)
+{
+    float difficulty = grid->difficulty < 1 ? 1 : grid->difficulty;
     uint32_t rarity_cap = rr_rarity_id_common + (difficulty + 7) / 8;
     if (rarity_cap > rr_rarity_id_ultimate)
         rarity_cap = rr_rarity_id_ultimate;
     uint32_t rarity = rarity_cap >= 2 ? rarity_cap - 2 : 0;
-    for (; rarity < rarity_cap; ++rarity)
-        if (pow(1 - (1 - RR_MOB_WAVE_RARITY_COEFFICIENTS[rarity + 1]) * 0.3,
-                pow(1.5, difficulty)) >= rarity_seed)
-            break;
-    return rarity;
+    grid->spawn_rarity = rarity;
+    for (uint8_t i = 0; i < 2; ++i, ++rarity)
+        grid->spawn_rarity_thresholds[i] =
+            rarity < rarity_cap ? spawn_rarity_threshold(rarity, difficulty)
+                                : 1;
+}
+
+void rr_waves_init()
+{
+    for (uint8_t biome = 0; biome < rr_biome_id_max; ++biome)
+    {
+        init_spawn_alias_table(&spawn_alias_tables[biome],
+                               biome == 0
+                                   ? RR_HELL_CREEK_MOB_ID_RARITY_COEFFICIENTS
+                                   : RR_GARDEN_MOB_ID_RARITY_COEFFICIENTS);
+        struct rr_maze_declaration *maze = &RR_MAZES[biome];
+        for (uint32_t i = 0; i < maze->maze_dim * maze->maze_dim; ++i)
+            init_spawn_rarity(&maze->maze[i]);
+    }
+}
+
+uint32_t get_spawn_rarity(struct rr_maze_grid *zone)
+{
+    double rarity_seed = rr_frand();
+    return zone->spawn_rarity +
+           (rarity_seed > zone->spawn_rarity_thresholds[0]) +
+           (rarity_seed > zone->spawn_rarity_thresholds[1]);
 }
 
 uint8_t get_spawn_id(uint8_t biome, struct rr_maze_grid *zone)
 {
-    double *table = biome == 0 ? RR_HELL_CREEK_MOB_ID_RARITY_COEFFICIENTS
-                               : RR_GARDEN_MOB_ID_RARITY_COEFFICIENTS;
-    double seed = rr_frand();
-    uint8_t id = 0;
-    for (; id < rr_mob_id_max - 1; ++id)
-        if (seed <= table[id])
-            break;
-    return id;
+    struct spawn_alias_table *table = &spawn_alias_tables[biome];
+    // the high half of the product picks the column, the low half is a
+    // uniform fraction on its own and decides between the id and its alias
+    uint64_t seed = (uint64_t)rr_rand() * rr_mob_id_max;
+    uint8_t id = seed >> 32;
+    if ((uint32_t)seed * 0x1p-32 < table->probability[id])
+        return id;
+    return table->alias[id];
 }
 
 int should_spawn_at(uint8_t id, uint8_t rarity)
@@ -20,7 +20,11 @@
 
 struct rr_maze_grid;
 
-uint32_t get_spawn_rarity(float);
+// Builds the spawn tables of every biome and the rarity thresholds of every
+// maze grid, must run before the first spawn
+void rr_waves_init();
+
+uint32_t get_spawn_rarity(struct rr_maze_grid *);
 uint8_t get_spawn_id(uint8_t, struct rr_maze_grid *);
 
 int should_spawn_at(uint8_t, uint8_t);
@@ -58,7 +58,6 @@ struct rr_component_ai
     RR_SERVER_ONLY(uint8_t protocol_state;)
     RR_SERVER_ONLY(uint8_t has_prediction;)
     RR_SERVER_ONLY(float aggro_range;)
-    RR_SERVER_ONLY(struct rr_vector return_pos;)
 };
 
 void rr_component_ai_init(struct rr_component_ai *, struct rr_simulation *);
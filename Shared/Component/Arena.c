@@ -61,7 +61,7 @@ void rr_component_arena_free(struct rr_component_arena *this,
                 simulation, simulation->physical_vector[i]);
             if (physical->arena != this->parent_id)
                 continue;
-            physical->arena = 1;
+            rr_component_physical_set_arena(physical, 1);
             rr_component_physical_set_x(physical, this_physical->x);
             rr_component_physical_set_y(physical, this_physical->y);
             float angle = rr_frand() * M_PI * 2;
@@ -70,19 +70,59 @@ void rr_component_arena_free(struct rr_component_arena *this,
             physical->velocity.y = sinf(angle) * v;
         }
     }
-    free(this->spatial_hash.cells);
+    rr_spatial_hash_free(&this->spatial_hash);
+    rr_flow_field_free(&this->zone_flow_field);
+    free(this->active_blocks);
 #endif
 }
 
 #ifdef RR_SERVER
 #include <Shared/StaticData.h>
 
+// expected radius of a mob spawned in the maze, weighted by how often each
+// mob id is rolled and by the rarity cap of every walkable grid
+static float arena_expected_mob_radius(uint8_t biome,
+                                       struct rr_maze_declaration *maze)
+{
+    double *id_table = biome == rr_biome_id_hell_creek
+                           ? RR_HELL_CREEK_MOB_ID_RARITY_COEFFICIENTS
+                           : RR_GARDEN_MOB_ID_RARITY_COEFFICIENTS;
+    double radius = 0;
+    for (uint8_t id = 0; id < rr_mob_id_max; ++id)
+        radius += (id_table[id] - (id == 0 ? 0 : id_table[id - 1])) *
+                  RR_MOB_DATA[id].radius;
+    double rarity_scale = 0;
+    uint32_t grid_count = 0;
+    for (uint32_t i = 0; i < maze->maze_dim * maze->maze_dim; ++i)
+    {
+        uint8_t difficulty = maze->maze[i].difficulty;
+        if (difficulty == 0)
+            continue;
+        uint32_t rarity = rr_rarity_id_common + (difficulty + 7) / 8;
+        if (rarity > rr_rarity_id_ultimate)
+            rarity = rr_rarity_id_ultimate;
+        rarity_scale += RR_MOB_RARITY_SCALING[rarity].radius;
+        ++grid_count;
+    }
+    if (grid_count == 0)
+        return radius;
+    return radius * rarity_scale / grid_count;
+}
+
 void rr_component_arena_spatial_hash_init(struct rr_component_arena *this,
                                           struct rr_simulation *simulation)
 {
     this->maze = &RR_MAZES[this->biome];
+    // cells stay aligned to the maze grid and are halved for as long as a
+    // cell still spans two typical mobs across
+    float cell_size = this->maze->grid_size;
+    float mob_radius = arena_expected_mob_radius(this->biome, this->maze);
+    while (cell_size / 2 >= 4 * mob_radius &&
+           cell_size / 2 >= RR_SPATIAL_HASH_MIN_CELL_SIZE)
+        cell_size /= 2;
     rr_spatial_hash_init(&this->spatial_hash, simulation,
-                         this->maze->maze_dim * this->maze->grid_size);
+                         this->maze->maze_dim * this->maze->grid_size,
+                         cell_size);
 }
 
 struct rr_maze_grid *
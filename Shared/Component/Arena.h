@@ -27,6 +27,7 @@ RR_SERVER_ONLY(struct rr_component_player_info;)
 RR_SERVER_ONLY(struct rr_maze_declaration;)
 
 #ifdef RR_SERVER
+#include <Server/FlowField.h>
 #include <Server/SpatialHash.h>
 #include <Shared/StaticData.h>
 #endif
@@ -42,6 +43,11 @@ struct rr_component_arena
     RR_SERVER_ONLY(EntityIdx mob_count;)
     RR_SERVER_ONLY(struct rr_maze_declaration *maze;)
     RR_SERVER_ONLY(struct rr_spatial_hash spatial_hash;)
+    RR_SERVER_ONLY(struct rr_flow_field zone_flow_field;)
+    // top left grids of the 2x2 blocks tick_maze has to visit, the ones with
+    // flowers nearby or an overload that has yet to wear off
+    RR_SERVER_ONLY(uint32_t *active_blocks;)
+    RR_SERVER_ONLY(uint32_t active_block_count;)
     RR_SERVER_ONLY(uint8_t pvp;)
 };
 
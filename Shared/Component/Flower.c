@@ -62,6 +62,7 @@ void rr_component_flower_free(struct rr_component_flower *this,
                               struct rr_simulation *simulation)
 {
 #ifdef RR_SERVER
+    rr_simulation_remove_flower_vicinity(simulation, this);
     if (rr_simulation_entity_alive(
             simulation,
             rr_simulation_get_relations(simulation, this->parent_id)->owner))
@@ -109,7 +110,8 @@ void rr_component_flower_set_dead(struct rr_component_flower *this,
         {
             for (uint8_t squad = 0; squad < RR_SQUAD_COUNT; ++squad)
             {
-                if (health->squad_damage_counter[squad] <=
+                if (rr_component_health_get_squad_damage(simulation, health,
+                                                         squad) <=
                     health->max_health * 0.2)
                     continue;
                 EntityIdx drop_id = rr_simulation_alloc_entity(simulation);
@@ -132,7 +134,7 @@ void rr_component_flower_set_dead(struct rr_component_flower *this,
                 rr_component_physical_set_x(drop_physical, physical->x);
                 rr_component_physical_set_y(drop_physical, physical->y);
                 rr_component_physical_set_radius(drop_physical, 20);
-                drop_physical->arena = physical->arena;
+                rr_component_physical_set_arena(drop_physical, physical->arena);
                 struct rr_component_relations *drop_relations =
                     rr_simulation_add_relations(simulation, drop_id);
                 rr_component_relations_set_team(drop_relations,
@@ -29,6 +29,20 @@ struct proto_bug;
 RR_CLIENT_ONLY(struct rr_renderer;)
 RR_SERVER_ONLY(struct rr_component_player_info;)
 
+#ifdef RR_SERVER
+// Grids of the maze a flower currently counts towards, tick_maze only
+// updates the grids that enter or leave it. Inclusive on both ends.
+struct rr_flower_vicinity
+{
+    uint32_t start_x;
+    uint32_t start_y;
+    uint32_t end_x;
+    uint32_t end_y;
+    uint32_t level;
+    uint8_t counted;
+};
+#endif
+
 struct rr_component_flower
 {
     EntityIdx parent_id;
@@ -38,6 +52,7 @@ struct rr_component_flower
     uint8_t third_eye_count;
     RR_SERVER_ONLY(uint8_t protocol_state;)
     RR_SERVER_ONLY(float saved_angle;)
+    RR_SERVER_ONLY(struct rr_flower_vicinity vicinity;)
     float eye_angle;
     uint32_t level;
     RR_CLIENT_ONLY(float eye_x;)
@@ -37,9 +37,23 @@ enum
     state_flags_all = 0b111
 };
 
+#ifdef RR_SERVER
+static void release_squad_damage_block(struct rr_component_health *this,
+                                       struct rr_simulation *simulation)
+{
+    if (this->squad_damage_block == 0)
+        return;
+    simulation->free_squad_damage_blocks
+        [simulation->free_squad_damage_block_count++] =
+        this->squad_damage_block - 1;
+    this->squad_damage_block = 0;
+}
+#endif
+
 void rr_component_health_init(struct rr_component_health *this,
                               struct rr_simulation *simulation)
 {
+    RR_SERVER_ONLY(release_squad_damage_block(this, simulation);)
     memset(this, 0, sizeof *this);
     this->health = 1;
     this->max_health = 1;
@@ -48,6 +62,7 @@ void rr_component_health_init(struct rr_component_health *this,
 void rr_component_health_free(struct rr_component_health *this,
                               struct rr_simulation *simulation)
 {
+    RR_SERVER_ONLY(release_squad_damage_block(this, simulation);)
 }
 
 #ifdef RR_SERVER
@@ -62,17 +77,86 @@ void rr_component_health_write(struct rr_component_health *this,
 {
     uint64_t state = this->protocol_state | (state_flags_all * is_creation);
     proto_bug_write_varuint(encoder, state, "health component state");
-    float tmp_health = this->health;
-    float tmp_max = this->max_health;
+    // clients are encoded concurrently so the hidden health is written from
+    // a copy instead of patching the component in place
+    struct rr_component_health hidden;
     if (this->flags & 1)
     {
-        this->health = this->max_health = 0;
+        hidden = *this;
+        hidden.health = hidden.max_health = 0;
+        this = &hidden;
     }
 #define X(NAME, TYPE) RR_ENCODE_PUBLIC_FIELD(NAME, TYPE);
     FOR_EACH_PUBLIC_FIELD
 #undef X
-    this->health = tmp_health;
-    this->max_health = tmp_max;
+}
+
+static float *squad_damage_block(struct rr_component_health *this,
+                                 struct rr_simulation *simulation)
+{
+    return simulation->squad_damage_blocks[this->squad_damage_block - 1];
+}
+
+static void add_squad_damage(struct rr_component_health *this,
+                             struct rr_simulation *simulation, uint8_t squad,
+                             float damage)
+{
+    if (this->squad_damage_block != 0)
+    {
+        squad_damage_block(this, simulation)[squad] += damage;
+        return;
+    }
+    uint8_t smallest = 0;
+    for (uint8_t i = 0; i < this->squad_damage_count; ++i)
+    {
+        if (this->squad_damage_squads[i] == squad)
+        {
+            this->squad_damage[i] += damage;
+            return;
+        }
+        if (this->squad_damage[i] < this->squad_damage[smallest])
+            smallest = i;
+    }
+    if (this->squad_damage_count < RR_SQUAD_DAMAGE_INLINE_COUNT)
+    {
+        this->squad_damage_squads[this->squad_damage_count] = squad;
+        this->squad_damage[this->squad_damage_count++] = damage;
+        return;
+    }
+    uint16_t block;
+    if (simulation->free_squad_damage_block_count > 0)
+        block = simulation->free_squad_damage_blocks
+                    [--simulation->free_squad_damage_block_count];
+    else if (simulation->squad_damage_blocks_used < RR_SQUAD_DAMAGE_BLOCK_COUNT)
+        block = simulation->squad_damage_blocks_used++;
+    else
+    {
+        // out of blocks, keep the squads that did the most damage
+        if (damage > this->squad_damage[smallest])
+        {
+            this->squad_damage_squads[smallest] = squad;
+            this->squad_damage[smallest] = damage;
+        }
+        return;
+    }
+    this->squad_damage_block = block + 1;
+    float *damages = squad_damage_block(this, simulation);
+    memset(damages, 0, sizeof simulation->squad_damage_blocks[block]);
+    for (uint8_t i = 0; i < this->squad_damage_count; ++i)
+        damages[this->squad_damage_squads[i]] = this->squad_damage[i];
+    damages[squad] += damage;
+}
+
+float rr_component_health_get_squad_damage(struct rr_simulation *simulation,
+                                           struct rr_component_health *this,
+                                           uint8_t squad)
+{
+    if (this->squad_damage_block != 0)
+        return squad_damage_block(this, simulation)[squad];
+    for (uint8_t i = 0; i < this->squad_damage_count; ++i)
+        if (this->squad_damage_squads[i] == squad)
+            return this->squad_damage[i];
+    return 0;
 }
 
 void rr_component_health_do_damage(struct rr_simulation *simulation,
@@ -130,7 +214,7 @@ void rr_component_health_do_damage(struct rr_simulation *simulation,
         return;
     struct rr_component_player_info *player_info =
         rr_simulation_get_player_info(simulation, p_info_id);
-    this->squad_damage_counter[player_info->squad] += damage;
+    add_squad_damage(this, simulation, player_info->squad, damage);
     struct rr_component_physical *physical =
         rr_simulation_get_physical(simulation, this->parent_id);
     struct rr_simulation_animation *animation =
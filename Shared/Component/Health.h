@@ -25,6 +25,9 @@ struct proto_bug;
 RR_CLIENT_ONLY(struct rr_renderer;)
 RR_SERVER_ONLY(struct rr_component_player_info;)
 
+#define RR_SQUAD_DAMAGE_INLINE_COUNT (4)
+#define RR_SQUAD_DAMAGE_BLOCK_COUNT (512)
+
 struct rr_component_health
 {
     float health;
@@ -45,7 +48,13 @@ struct rr_component_health
     RR_SERVER_ONLY(uint8_t protocol_state;)
     RR_CLIENT_ONLY(uint8_t prev_flags;)
     RR_SERVER_ONLY(uint8_t damage_paused;)
-    RR_SERVER_ONLY(float squad_damage_counter[RR_SQUAD_COUNT];)
+    // damage dealt by each squad. up to RR_SQUAD_DAMAGE_INLINE_COUNT squads
+    // are kept here, once more squads hit the entity all of them move to a
+    // block of the simulation's squad damage pool
+    RR_SERVER_ONLY(float squad_damage[RR_SQUAD_DAMAGE_INLINE_COUNT];)
+    RR_SERVER_ONLY(uint8_t squad_damage_squads[RR_SQUAD_DAMAGE_INLINE_COUNT];)
+    RR_SERVER_ONLY(uint8_t squad_damage_count;)
+    RR_SERVER_ONLY(uint16_t squad_damage_block;) // block + 1, 0 if inline
     RR_SERVER_ONLY(float gradually_healed;)
     RR_SERVER_ONLY(uint8_t gradually_healed_ticks;)
 };
@@ -67,3 +76,6 @@ RR_DECLARE_PUBLIC_FIELD(health, uint8_t, flags)
 RR_SERVER_ONLY(void rr_component_health_do_damage(struct rr_simulation *,
                                                   struct rr_component_health *,
                                                   EntityIdx, float, uint8_t);)
+RR_SERVER_ONLY(float rr_component_health_get_squad_damage(
+                   struct rr_simulation *, struct rr_component_health *,
+                   uint8_t);)
@@ -94,7 +94,8 @@ void rr_component_mob_free(struct rr_component_mob *this,
                 continue;
         }
         else if (this->id != rr_mob_id_meteor &&
-                 health->squad_damage_counter[squad] <=
+                 rr_component_health_get_squad_damage(simulation, health,
+                                                      squad) <=
                      health->max_health * 0.2)
             continue;
 
@@ -120,8 +121,8 @@ void rr_component_mob_free(struct rr_component_mob *this,
             if (rr_vector_magnitude_cmp(&delta, 2000) == 1)
                 continue;
             ++member->client->mob_gallery[this->id][this->rarity];
-            rr_server_client_write_to_api(member->client);
-            rr_server_client_write_account(member->client);
+            rr_server_client_change_mob_gallery(member->client, this->id,
+                                                this->rarity);
         }
 
         uint8_t spawn_ids[4] = {};
@@ -185,7 +186,7 @@ void rr_component_mob_free(struct rr_component_mob *this,
                 uint8_t j = member->client - simulation->server->clients;
                 rr_bitset_set(drop->can_be_picked_up_by, j);
             }
-            drop_physical->arena = physical->arena;
+            rr_component_physical_set_arena(drop_physical, physical->arena);
             if (count != 1)
             {
                 float angle = M_PI * 2 * (i + 0.65 * rr_frand()) / count;
@@ -48,7 +48,7 @@ void rr_component_petal_init(struct rr_component_petal *this,
                              struct rr_simulation *simulation)
 {
     memset(this, 0, sizeof *this);
-    RR_SERVER_ONLY(this->spin_ccw = 1 - 2 * (rand() & 1);)
+    RR_SERVER_ONLY(this->spin_ccw = 1 - 2 * (rr_rand() & 1);)
 }
 
 void rr_component_petal_free(struct rr_component_petal *this,
@@ -74,7 +74,7 @@ void rr_component_petal_free(struct rr_component_petal *this,
     rr_component_physical_set_angle(physical, rr_frand() * 2 * M_PI);
     physical->mass = 1;
     physical->friction = 0;
-    physical->arena = petal_phys->arena;
+    rr_component_physical_set_arena(physical, petal_phys->arena);
     web->ticks_until_death = 125;
     web->slow_factor = powf(0.56, this->rarity);
     rr_component_relations_set_team(relations, petal_rel->team);
@@ -16,8 +16,10 @@
 
 #include <Shared/Component/Physical.h>
 
+#include <math.h>
 #include <string.h>
 
+#include <Shared/SimulationCommon.h>
 #include <Shared/pb.h>
 
 enum
@@ -29,11 +31,7 @@ enum
     state_flags_all = 0b01111
 };
 
-#define FOR_EACH_PUBLIC_FIELD                                                  \
-    X(angle, float32)                                                          \
-    X(radius, float32)                                                         \
-    X(x, float32)                                                              \
-    X(y, float32)
+#define ANGLE_STEPS (1 << RR_PHYSICAL_ANGLE_BITS)
 
 void rr_component_physical_init(struct rr_component_physical *this,
                                 struct rr_simulation *simulation)
@@ -44,6 +42,15 @@ void rr_component_physical_init(struct rr_component_physical *this,
     RR_SERVER_ONLY(this->knockback_scale = 1;)
     RR_SERVER_ONLY(this->aggro_range_multiplier = 1;)
     RR_SERVER_ONLY(this->shell_ignore_ticks = 5 * 25;)
+#ifdef RR_SERVER
+    this->simulation = simulation;
+    EntityIdx entity = this - simulation->physical_components;
+#define X(TYPE, NAME)                                                          \
+    memset(&simulation->physical_##NAME[entity], 0,                            \
+           sizeof simulation->physical_##NAME[entity]);
+    RR_FOR_EACH_PHYSICAL_HOT_FIELD
+#undef X
+#endif
 }
 
 void rr_component_physical_free(struct rr_component_physical *this,
@@ -52,31 +59,106 @@ void rr_component_physical_free(struct rr_component_physical *this,
 }
 
 #ifdef RR_SERVER
+static int32_t quantize_position(float position)
+{
+    return floorf(position * RR_PHYSICAL_POSITION_SCALE + 0.5f);
+}
+
+// zigzag so small negative deltas stay small varuints
+static void write_position_delta(struct proto_bug *encoder, int32_t delta,
+                                 char const *name)
+{
+    proto_bug_write_varuint(
+        encoder, ((uint32_t)delta << 1) ^ (uint32_t)(delta >> 31), name);
+}
+
 void rr_component_physical_write(struct rr_component_physical *this,
                                  struct proto_bug *encoder, int is_creation,
                                  struct rr_component_player_info *client)
 {
     uint64_t state = this->protocol_state | (state_flags_all * is_creation);
     proto_bug_write_varuint(encoder, state, "physical component state");
-#define X(NAME, TYPE) RR_ENCODE_PUBLIC_FIELD(NAME, TYPE);
-    FOR_EACH_PUBLIC_FIELD
-#undef X
+    if (state & state_flags_angle)
+    {
+        int32_t angle = floorf(fmodf(this->angle, 2 * M_PI) *
+                                   (ANGLE_STEPS / (2 * M_PI)) +
+                               0.5f);
+        proto_bug_write_uint16(encoder, angle & (ANGLE_STEPS - 1),
+                               "field angle");
+    }
+    RR_ENCODE_PUBLIC_FIELD(radius, float32);
+    if (state & state_flags_x)
+        write_position_delta(encoder,
+                             quantize_position(this->x) -
+                                 (is_creation ? 0 : this->wire_x),
+                             "field x");
+    if (state & state_flags_y)
+        write_position_delta(encoder,
+                             quantize_position(this->y) -
+                                 (is_creation ? 0 : this->wire_y),
+                             "field y");
 }
 
-RR_DEFINE_PUBLIC_FIELD(physical, float, x)
-RR_DEFINE_PUBLIC_FIELD(physical, float, y)
-RR_DEFINE_PUBLIC_FIELD(physical, float, angle)
-RR_DEFINE_PUBLIC_FIELD(physical, float, radius)
+// called once every client got this tick's update, before protocol_state is
+// cleared. rr_server_check_wire_baselines makes sure none was skipped
+void rr_component_physical_update_wire_position(
+    struct rr_component_physical *this)
+{
+    if (this->protocol_state & state_flags_x)
+        this->wire_x = quantize_position(this->x);
+    if (this->protocol_state & state_flags_y)
+        this->wire_y = quantize_position(this->y);
+}
+
+// RR_DEFINE_PUBLIC_FIELD that also updates the dense copy in the simulation
+#define RR_DEFINE_HOT_PUBLIC_FIELD(TYPE, NAME)                                 \
+    void rr_component_physical_set_##NAME(struct rr_component_physical *this,  \
+                                          TYPE ___)                            \
+    {                                                                          \
+        this->protocol_state |= (this->NAME != ___) * state_flags_##NAME;      \
+        this->NAME = ___;                                                      \
+        this->simulation->physical_##NAME[this->parent_id] = ___;              \
+    }
+
+RR_DEFINE_HOT_PUBLIC_FIELD(float, x)
+RR_DEFINE_HOT_PUBLIC_FIELD(float, y)
+RR_DEFINE_HOT_PUBLIC_FIELD(float, angle)
+RR_DEFINE_HOT_PUBLIC_FIELD(float, radius)
+
+void rr_component_physical_set_arena(struct rr_component_physical *this,
+                                     EntityIdx arena)
+{
+    this->arena = arena;
+    this->simulation->physical_arena[this->parent_id] = arena;
+}
 #endif
 
 #ifdef RR_CLIENT
+static int32_t read_position_delta(struct proto_bug *encoder,
+                                   char const *name)
+{
+    uint32_t zigzag = proto_bug_read_varuint(encoder, name);
+    return (int32_t)(zigzag >> 1) ^ -(int32_t)(zigzag & 1);
+}
+
 void rr_component_physical_read(struct rr_component_physical *this,
                                 struct proto_bug *encoder)
 {
     uint64_t state =
         proto_bug_read_varuint(encoder, "physical component state");
-#define X(NAME, TYPE) RR_DECODE_PUBLIC_FIELD(NAME, TYPE);
-    FOR_EACH_PUBLIC_FIELD
-#undef X
+    if (state & state_flags_angle)
+        this->angle = proto_bug_read_uint16(encoder, "field angle") *
+                      (2 * M_PI / ANGLE_STEPS);
+    RR_DECODE_PUBLIC_FIELD(radius, float32);
+    if (state & state_flags_x)
+    {
+        this->wire_x += read_position_delta(encoder, "field x");
+        this->x = (float)this->wire_x / RR_PHYSICAL_POSITION_SCALE;
+    }
+    if (state & state_flags_y)
+    {
+        this->wire_y += read_position_delta(encoder, "field y");
+        this->y = (float)this->wire_y / RR_PHYSICAL_POSITION_SCALE;
+    }
 }
 #endif
\ No newline at end of file
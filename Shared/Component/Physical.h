@@ -22,6 +22,11 @@
 #include <Shared/Utilities.h>
 #include <Shared/Vector.h>
 
+// positions go over the wire on a 1 / RR_PHYSICAL_POSITION_SCALE grid and
+// angles with RR_PHYSICAL_ANGLE_BITS of precision
+#define RR_PHYSICAL_POSITION_SCALE (8)
+#define RR_PHYSICAL_ANGLE_BITS (12)
+
 struct rr_simulation;
 struct proto_bug;
 
@@ -29,7 +34,19 @@ RR_SERVER_ONLY(struct rr_component_player_info;)
 
 struct rr_component_physical
 {
+    // x, y, radius, angle and arena are mirrored into the dense physical_*
+    // arrays of the server simulation by their setters. read them through
+    // rr_simulation_get_physical_* where a system sweeps many entities
+    float x;
+    float y;
+    float radius;
+    float angle;
     struct rr_vector velocity;
+    RR_SERVER_ONLY(EntityIdx arena;)
+    // quantized position clients last received. x and y are sent as deltas
+    // from it, or from 0 when the entity is created for a client
+    int32_t wire_x;
+    int32_t wire_y;
     RR_CLIENT_ONLY(struct rr_vector lerp_velocity;)
     RR_SERVER_ONLY(struct rr_vector
                        collision_velocity;) // used for collision resolution
@@ -45,15 +62,11 @@ struct rr_component_physical
     RR_SERVER_ONLY(float aggro_range_multiplier;)
     RR_SERVER_ONLY(float slow_resist;)
     RR_SERVER_ONLY(float web_slowdown;)
-    float angle;
     RR_SERVER_ONLY(float bearing_angle;)
     RR_CLIENT_ONLY(float lerp_angle;)
     RR_CLIENT_ONLY(float turning_animation;)
-    float x;
     RR_CLIENT_ONLY(float lerp_x;)
-    float y;
     RR_CLIENT_ONLY(float lerp_y;)
-    float radius;
     RR_CLIENT_ONLY(float lerp_radius;)
     RR_CLIENT_ONLY(float animation;)       // the actual animation client uses
     RR_CLIENT_ONLY(float animation_timer;) // global timer
@@ -68,9 +81,9 @@ struct rr_component_physical
     RR_CLIENT_ONLY(uint8_t animation_started : 1;)
     RR_SERVER_ONLY(uint8_t protocol_state;)
     EntityIdx parent_id;
-    RR_SERVER_ONLY(EntityIdx arena;)
     RR_SERVER_ONLY(uint16_t colliding_with_size;)
-    RR_SERVER_ONLY(EntityIdx colliding_with[RR_MAX_COLLISION_COUNT];)
+    RR_SERVER_ONLY(uint32_t colliding_with_start;) // into collision_pool
+    RR_SERVER_ONLY(struct rr_simulation *simulation;)
 };
 
 void rr_component_physical_init(struct rr_component_physical *,
@@ -88,3 +101,7 @@ RR_DECLARE_PUBLIC_FIELD(physical, float, x)
 RR_DECLARE_PUBLIC_FIELD(physical, float, y)
 RR_DECLARE_PUBLIC_FIELD(physical, float, angle)
 RR_DECLARE_PUBLIC_FIELD(physical, float, radius)
+RR_SERVER_ONLY(void rr_component_physical_set_arena(
+                   struct rr_component_physical *, EntityIdx);)
+RR_SERVER_ONLY(void rr_component_physical_update_wire_position(
+                   struct rr_component_physical *);)
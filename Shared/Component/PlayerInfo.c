@@ -86,6 +86,7 @@ void rr_component_player_info_free(struct rr_component_player_info *this,
     free(this->collected_this_run);
 #ifdef RR_SERVER
     free(this->entities_in_view);
+    rr_flow_field_free(&this->flow_field);
     if (rr_simulation_entity_alive(simulation, this->flower_id))
         rr_simulation_request_entity_deletion(simulation, this->flower_id);
 #endif
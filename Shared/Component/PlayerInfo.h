@@ -24,6 +24,10 @@
 #include <Shared/Utilities.h>
 #include <Shared/Vector.h>
 
+#ifdef RR_SERVER
+#include <Server/FlowField.h>
+#endif
+
 #ifdef RIVET_BUILD
 #define RR_BASE_FOV (0.9f)
 #else
@@ -92,6 +96,8 @@ struct rr_component_player_info
     uint8_t squad;
     uint8_t slot_count;
     RR_SERVER_ONLY(uint8_t *entities_in_view;)
+    RR_SERVER_ONLY(struct rr_flow_field flow_field;)
+    RR_SERVER_ONLY(uint8_t flow_field_ticks;)
     RR_SERVER_ONLY(struct rr_id_rarity_pair
                        drops_this_tick[RR_MAX_SLOT_COUNT];)
                                             // yes, it's limited to 12. if the
@@ -17,30 +17,19 @@
 #include <Shared/Crypto.h>
 
 #include <stdint.h>
-#include <stdlib.h>
 #include <string.h>
 
-#include <Shared/MagicNumber.h>
-
-// https://github.com/shiffthq/chacha20/blob/master/src/chacha20.c
-static inline void u32t8le(uint32_t v, uint8_t p[4])
-{
-    p[0] = v & 0xff;
-    p[1] = (v >> 8) & 0xff;
-    p[2] = (v >> 16) & 0xff;
-    p[3] = (v >> 24) & 0xff;
-}
+#if defined(__SSE2__)
+#include <immintrin.h>
+#elif defined(__wasm_simd128__)
+#include <wasm_simd128.h>
+#endif
 
-static inline uint32_t u8t32le(uint8_t p[4])
-{
-    uint32_t value = p[3];
+#include <Shared/MagicNumber.h>
 
-    value = (value << 8) | p[2];
-    value = (value << 8) | p[1];
-    value = (value << 8) | p[0];
-
-    return value;
-}
+// chacha20 (https://tools.ietf.org/html/rfc7539) with the constants xored so
+// the stream is not the standard one. it only obfuscates the protocol, the
+// keys are sent in the first packet
 
 static inline uint32_t rotl32(uint32_t x, int n)
 {
@@ -49,107 +38,199 @@ static inline uint32_t rotl32(uint32_t x, int n)
 }
 
 // https://tools.ietf.org/html/rfc7539#section-2.1
-static void chacha20_quarterround(uint32_t *x, int a, int b, int c, int d)
-{
-    x[a] += x[b];
-    x[d] = rotl32(x[d] ^ x[a], 16);
-    x[c] += x[d];
-    x[b] = rotl32(x[b] ^ x[c], 12);
-    x[a] += x[b];
-    x[d] = rotl32(x[d] ^ x[a], 8);
-    x[c] += x[d];
+#define QUARTERROUND(x, a, b, c, d)                                            \
+    x[a] += x[b];                                                              \
+    x[d] = rotl32(x[d] ^ x[a], 16);                                            \
+    x[c] += x[d];                                                              \
+    x[b] = rotl32(x[b] ^ x[c], 12);                                            \
+    x[a] += x[b];                                                              \
+    x[d] = rotl32(x[d] ^ x[a], 8);                                             \
+    x[c] += x[d];                                                              \
     x[b] = rotl32(x[b] ^ x[c], 7);
-}
 
-static void chacha20_serialize(uint32_t in[16], uint8_t output[64])
+// https://tools.ietf.org/html/rfc7539#section-2.3
+static void chacha20_block(uint32_t const in[16], uint32_t out[16])
 {
-    int i;
-    for (i = 0; i < 16; i++)
+    uint32_t x[16];
+    memcpy(x, in, sizeof x);
+    for (uint32_t i = 0; i < 10; ++i)
     {
-        u32t8le(in[i], output + (i << 2));
+        QUARTERROUND(x, 0, 4, 8, 12)
+        QUARTERROUND(x, 1, 5, 9, 13)
+        QUARTERROUND(x, 2, 6, 10, 14)
+        QUARTERROUND(x, 3, 7, 11, 15)
+        QUARTERROUND(x, 0, 5, 10, 15)
+        QUARTERROUND(x, 1, 6, 11, 12)
+        QUARTERROUND(x, 2, 7, 8, 13)
+        QUARTERROUND(x, 3, 4, 9, 14)
     }
+    for (uint32_t i = 0; i < 16; ++i)
+        out[i] = x[i] + in[i];
 }
 
-static void chacha20_block(uint32_t in[16], uint8_t out[64], int num_rounds)
-{
-    int i;
-    uint32_t x[16];
-
-    memcpy(x, in, sizeof(uint32_t) * 16);
+#undef QUARTERROUND
 
-    for (i = num_rounds; i > 0; i -= 2)
-    {
-        chacha20_quarterround(x, 0, 4, 8, 12);
-        chacha20_quarterround(x, 1, 5, 9, 13);
-        chacha20_quarterround(x, 2, 6, 10, 14);
-        chacha20_quarterround(x, 3, 7, 11, 15);
-        chacha20_quarterround(x, 1, 5, 10, 15);
-        chacha20_quarterround(x, 1, 6, 11, 14);
-        chacha20_quarterround(x, 2, 7, 8, 13);
-        chacha20_quarterround(x, 3, 4, 9, 14);
-    }
-
-    for (i = 0; i < 16; i++)
+static void chacha20_xor_scalar(uint32_t s[16], uint8_t *data, uint64_t size)
+{
+    uint32_t block[16];
+    while (size > 0)
     {
-        x[i] += in[i];
+        chacha20_block(s, block);
+        ++s[12];
+        uint64_t length = size < 64 ? size : 64;
+        // the protocol is little endian everywhere we run
+        uint8_t const *stream = (uint8_t const *)block;
+        for (uint64_t i = 0; i < length; ++i)
+            data[i] ^= stream[i];
+        data += length;
+        size -= length;
     }
-
-    chacha20_serialize(x, out);
 }
 
-// https://tools.ietf.org/html/rfc7539#section-2.3
-static void chacha20_init_state(uint32_t s[16], uint8_t key[32],
-                                uint32_t counter, uint8_t nonce[12])
+// one block per 128 bit vector, one row of the state per register. the
+// diagonal round rotates rows b, c and d so it is the column round again
+#define CHACHA20_DOUBLE_ROUND(ADD, XOR, ROTL, ROW1, ROW2, ROW3, a, b, c, d)   \
+    a = ADD(a, b);                                                             \
+    d = ROTL(XOR(d, a), 16);                                                   \
+    c = ADD(c, d);                                                             \
+    b = ROTL(XOR(b, c), 12);                                                   \
+    a = ADD(a, b);                                                             \
+    d = ROTL(XOR(d, a), 8);                                                    \
+    c = ADD(c, d);                                                             \
+    b = ROTL(XOR(b, c), 7);                                                    \
+    b = ROW1(b);                                                               \
+    c = ROW2(c);                                                               \
+    d = ROW3(d);                                                               \
+    a = ADD(a, b);                                                             \
+    d = ROTL(XOR(d, a), 16);                                                   \
+    c = ADD(c, d);                                                             \
+    b = ROTL(XOR(b, c), 12);                                                   \
+    a = ADD(a, b);                                                             \
+    d = ROTL(XOR(d, a), 8);                                                    \
+    c = ADD(c, d);                                                             \
+    b = ROTL(XOR(b, c), 7);                                                    \
+    b = ROW3(b);                                                               \
+    c = ROW2(c);                                                               \
+    d = ROW1(d);
+
+#if defined(__AVX2__)
+#define V256_ROTL(x, n)                                                        \
+    _mm256_or_si256(_mm256_slli_epi32(x, n), _mm256_srli_epi32(x, 32 - n))
+#define V256_ROW1(x) _mm256_shuffle_epi32(x, _MM_SHUFFLE(0, 3, 2, 1))
+#define V256_ROW2(x) _mm256_shuffle_epi32(x, _MM_SHUFFLE(1, 0, 3, 2))
+#define V256_ROW3(x) _mm256_shuffle_epi32(x, _MM_SHUFFLE(2, 1, 0, 3))
+
+// two blocks at once, one per 128 bit lane
+static void chacha20_xor_avx2(uint32_t s[16], uint8_t **data, uint64_t *size)
 {
-    int i;
-
-    // refer:
-    // https://dxr.mozilla.org/mozilla-beta/source/security/nss/lib/freebl/chacha20.c
-    // convert magic number to string: "expand 32-byte k"
-    s[0] = 0x61707865 ^ 0xfeedface;
-    s[1] = 0x3320646e ^ 0xfacefeed;
-    s[2] = 0x79622d32 ^ 0xdeadbeef;
-    s[3] = 0x6b206574 ^ 0xbeefdaed;
-
-    for (i = 0; i < 8; i++)
+    __m256i const a0 =
+        _mm256_broadcastsi128_si256(_mm_loadu_si128((__m128i const *)s));
+    __m256i const b0 =
+        _mm256_broadcastsi128_si256(_mm_loadu_si128((__m128i const *)s + 1));
+    __m256i const c0 =
+        _mm256_broadcastsi128_si256(_mm_loadu_si128((__m128i const *)s + 2));
+    __m256i d0 =
+        _mm256_broadcastsi128_si256(_mm_loadu_si128((__m128i const *)s + 3));
+    d0 = _mm256_add_epi32(d0, _mm256_setr_epi32(0, 0, 0, 0, 1, 0, 0, 0));
+    __m256i const two = _mm256_setr_epi32(2, 0, 0, 0, 2, 0, 0, 0);
+    while (*size >= 128)
     {
-        s[4 + i] = u8t32le(key + i * 4);
-    }
-
-    s[12] = counter;
-
-    for (i = 0; i < 3; i++)
-    {
-        s[13 + i] = u8t32le(nonce + i * 4);
+        __m256i a = a0, b = b0, c = c0, d = d0;
+        for (uint32_t i = 0; i < 10; ++i)
+        {
+            CHACHA20_DOUBLE_ROUND(_mm256_add_epi32, _mm256_xor_si256,
+                                  V256_ROTL, V256_ROW1, V256_ROW2, V256_ROW3,
+                                  a, b, c, d)
+        }
+        a = _mm256_add_epi32(a, a0);
+        b = _mm256_add_epi32(b, b0);
+        c = _mm256_add_epi32(c, c0);
+        d = _mm256_add_epi32(d, d0);
+        // the low lanes hold the first block, the high lanes the second
+        __m256i stream[4] = {_mm256_permute2x128_si256(a, b, 0x20),
+                             _mm256_permute2x128_si256(c, d, 0x20),
+                             _mm256_permute2x128_si256(a, b, 0x31),
+                             _mm256_permute2x128_si256(c, d, 0x31)};
+        __m256i *out = (__m256i *)*data;
+        for (uint32_t i = 0; i < 4; ++i)
+            _mm256_storeu_si256(
+                out + i, _mm256_xor_si256(_mm256_loadu_si256(out + i),
+                                          stream[i]));
+        d0 = _mm256_add_epi32(d0, two);
+        s[12] += 2;
+        *data += 128;
+        *size -= 128;
     }
 }
 
-static void ChaCha20XOR(uint8_t key[32], uint32_t counter, uint8_t nonce[12],
-                        uint8_t *in, uint8_t *out, int inlen)
+#undef V256_ROTL
+#undef V256_ROW1
+#undef V256_ROW2
+#undef V256_ROW3
+#endif
+
+#if defined(__SSE2__) || defined(__wasm_simd128__)
+#if defined(__SSE2__)
+typedef __m128i v128;
+#define V128_LOAD(p) _mm_loadu_si128((__m128i const *)(p))
+#define V128_STORE(p, x) _mm_storeu_si128((__m128i *)(p), x)
+#define V128_ADD _mm_add_epi32
+#define V128_XOR _mm_xor_si128
+#define V128_ROTL(x, n)                                                        \
+    _mm_or_si128(_mm_slli_epi32(x, n), _mm_srli_epi32(x, 32 - n))
+#define V128_ROW1(x) _mm_shuffle_epi32(x, _MM_SHUFFLE(0, 3, 2, 1))
+#define V128_ROW2(x) _mm_shuffle_epi32(x, _MM_SHUFFLE(1, 0, 3, 2))
+#define V128_ROW3(x) _mm_shuffle_epi32(x, _MM_SHUFFLE(2, 1, 0, 3))
+#else
+typedef v128_t v128;
+#define V128_LOAD(p) wasm_v128_load(p)
+#define V128_STORE(p, x) wasm_v128_store(p, x)
+#define V128_ADD wasm_i32x4_add
+#define V128_XOR wasm_v128_xor
+#define V128_ROTL(x, n)                                                        \
+    wasm_v128_or(wasm_i32x4_shl(x, n), wasm_u32x4_shr(x, 32 - n))
+#define V128_ROW1(x) wasm_i32x4_shuffle(x, x, 1, 2, 3, 0)
+#define V128_ROW2(x) wasm_i32x4_shuffle(x, x, 2, 3, 0, 1)
+#define V128_ROW3(x) wasm_i32x4_shuffle(x, x, 3, 0, 1, 2)
+#endif
+
+static void chacha20_xor_v128(uint32_t s[16], uint8_t **data, uint64_t *size)
 {
-    int i, j;
-
-    uint32_t s[16];
-    uint8_t block[64];
-
-    chacha20_init_state(s, key, counter, nonce);
-
-    for (i = 0; i < inlen; i += 64)
+    v128 const a0 = V128_LOAD(s);
+    v128 const b0 = V128_LOAD(s + 4);
+    v128 const c0 = V128_LOAD(s + 8);
+    while (*size >= 64)
     {
-        chacha20_block(s, block, 20);
-        s[12]++;
-
-        for (j = i; j < i + 64; j++)
+        v128 const d0 = V128_LOAD(s + 12);
+        v128 a = a0, b = b0, c = c0, d = d0;
+        for (uint32_t i = 0; i < 10; ++i)
         {
-            if (j >= inlen)
-            {
-                break;
-            }
-            out[j] = in[j] ^ block[j - i];
+            CHACHA20_DOUBLE_ROUND(V128_ADD, V128_XOR, V128_ROTL, V128_ROW1,
+                                  V128_ROW2, V128_ROW3, a, b, c, d)
         }
+        uint8_t *out = *data;
+        V128_STORE(out, V128_XOR(V128_LOAD(out), V128_ADD(a, a0)));
+        V128_STORE(out + 16, V128_XOR(V128_LOAD(out + 16), V128_ADD(b, b0)));
+        V128_STORE(out + 32, V128_XOR(V128_LOAD(out + 32), V128_ADD(c, c0)));
+        V128_STORE(out + 48, V128_XOR(V128_LOAD(out + 48), V128_ADD(d, d0)));
+        ++s[12];
+        *data += 64;
+        *size -= 64;
     }
 }
 
+#undef V128_LOAD
+#undef V128_STORE
+#undef V128_ADD
+#undef V128_XOR
+#undef V128_ROTL
+#undef V128_ROW1
+#undef V128_ROW2
+#undef V128_ROW3
+#endif
+
+#undef CHACHA20_DOUBLE_ROUND
+
 uint64_t rr_get_hash(uint64_t x)
 {
     x = (x + 1) * (100000 ^ RR_SECRET8);
@@ -163,27 +244,33 @@ static uint64_t g_random_seed = 123123213231231123;
 
 uint64_t rr_get_rand() { return g_random_seed = rr_get_hash(g_random_seed); }
 
-void rr_encrypt(uint8_t *start, uint64_t size, uint64_t key)
+static void chacha20_init_state(uint32_t s[16], uint64_t key)
 {
-    return; // disable crypto
-    uint8_t *clone = malloc(size);
-    memcpy(clone, start, size);
-    uint64_t cipher_key[4];
-    // idk what the nonce is for but it gets initialized with random bytes
-    uint32_t nonce[3];
-    // also don't know what the point in the counter is but it is also random
-    // bytes for this
-    uint32_t counter;
-    for (uint64_t i = 0; i < 4; i++)
-        cipher_key[i] = key = rr_get_hash(
-            rr_get_hash(rr_get_hash(rr_get_hash(rr_get_hash(key)))));
-    for (uint64_t i = 0; i < 3; i++)
-        nonce[i] = key = rr_get_hash(rr_get_hash(key));
-    counter = rr_get_hash(key);
-
-    ChaCha20XOR((uint8_t *)cipher_key, counter, (uint8_t *)nonce, clone, start,
-                size);
-    free(clone);
+    // convert magic number to string: "expand 32-byte k"
+    s[0] = 0x61707865 ^ 0xfeedface;
+    s[1] = 0x3320646e ^ 0xfacefeed;
+    s[2] = 0x79622d32 ^ 0xdeadbeef;
+    s[3] = 0x6b206574 ^ 0xbeefdaed;
+    // key words, then the counter and the nonce
+    for (uint32_t i = 4; i < 16; i += 2)
+    {
+        key = rr_get_hash(key);
+        s[i] = key;
+        s[i + 1] = key >> 32;
+    }
+}
+
+void rr_encrypt(uint8_t *data, uint64_t size, uint64_t key)
+{
+    uint32_t s[16];
+    chacha20_init_state(s, key);
+#if defined(__AVX2__)
+    chacha20_xor_avx2(s, &data, &size);
+#endif
+#if defined(__SSE2__) || defined(__wasm_simd128__)
+    chacha20_xor_v128(s, &data, &size);
+#endif
+    chacha20_xor_scalar(s, data, size);
 }
 
 void rr_decrypt(uint8_t *start, uint64_t size, uint64_t key)
@@ -28,6 +28,7 @@ typedef uint32_t EntityHash;
 #define RR_MAX_CLIENT_COUNT (64)
 #define RR_SQUAD_COUNT (RR_MAX_CLIENT_COUNT)
 #define RR_MAX_COLLISION_COUNT (256)
+#define RR_MAX_ANIMATION_COUNT (16384)
 
 #define RR_MAX_SLOT_COUNT (12)
 
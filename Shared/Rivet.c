@@ -94,8 +94,8 @@ int rr_rivet_players_connected(char const *lobby_token,
     curl_easy_setopt(curl, CURLOPT_URL,
                      "https://matchmaker.api.rivet.gg/v1/players/connected");
     curl_easy_setopt(curl, CURLOPT_POSTFIELDS, post_data);
+    curl_easy_setopt(curl, CURLOPT_TIMEOUT, 10);
     err = curl_easy_perform(curl);
-    assert(!err);
 
     long http_code = 0;
     curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &http_code);
@@ -104,13 +104,15 @@ int rr_rivet_players_connected(char const *lobby_token,
     cJSON_Delete(root);
     curl_easy_cleanup(curl);
     curl_slist_free_all(list);
+    if (err || http_code >= 500)
+        return -1;
     return http_code == 200;
 #endif
     return 1;
 }
 
-void rr_rivet_players_disconnected(char const *lobby_token,
-                                   char const *player_token)
+int rr_rivet_players_disconnected(char const *lobby_token,
+                                  char const *player_token)
 {
 #ifdef RR_SERVER
     cJSON *root = cJSON_CreateObject();
@@ -122,11 +124,16 @@ void rr_rivet_players_disconnected(char const *lobby_token,
     curl_easy_setopt(curl, CURLOPT_URL,
                      "https://matchmaker.api.rivet.gg/v1/players/disconnected");
     curl_easy_setopt(curl, CURLOPT_POSTFIELDS, post_data);
-    RR_RIVET_CURL_EPILOGUE
+    curl_easy_setopt(curl, CURLOPT_TIMEOUT, 10);
+    err = curl_easy_perform(curl);
+    curl_easy_cleanup(curl);
+    curl_slist_free_all(list);
 
     free(post_data);
     cJSON_Delete(root);
+    return !err;
 #endif
+    return 1;
 }
 
 // public token:
@@ -39,9 +39,11 @@ void rr_rivet_on_log_in(char *token, char *avatar_url, char *name,
                         void *captures);
 
 RR_SERVER_ONLY(extern void rr_rivet_lobbies_ready(char const *lobby_token);)
+// 1 if the player may stay, 0 if not and -1 if rivet could not be reached
 RR_SERVER_ONLY(extern int rr_rivet_players_connected(char const *lobby_token,
                                                      char const *player_token);)
-RR_SERVER_ONLY(extern void rr_rivet_players_disconnected(
+// 0 if rivet could not be reached
+RR_SERVER_ONLY(extern int rr_rivet_players_disconnected(
                    char const *lobby_token, char const *player_token);)
 RR_SERVER_ONLY(extern void rr_rivet_lobbies_set_closed(char const *lobby_token,
                                                        int closed);)
@@ -60,24 +60,47 @@ void __rr_simulation_pending_deletion_unset_entity(uint64_t i, void *captures)
     RR_SERVER_ONLY(printf("<rr_simulation::deletion::%lu>\n", i);)
 #endif
 
-    this->entity_tracker[(EntityIdx)i] = 0;
+    EntityIdx entity = i;
+#define XX(COMPONENT, ID)                                                      \
+    if (this->entity_tracker[entity] & (1 << ID))                              \
+    {                                                                          \
+        EntityIdx index = this->COMPONENT##_vector_index[entity];              \
+        EntityIdx last = this->COMPONENT##_vector[--this->COMPONENT##_count];  \
+        this->COMPONENT##_vector[index] = last;                                \
+        this->COMPONENT##_vector_index[last] = index;                          \
+    }
+    RR_FOR_EACH_COMPONENT;
+#undef XX
+    this->entity_tracker[entity] = 0;
 }
 
-void rr_simulation_create_component_vectors(struct rr_simulation *this)
+EntityIdx __rr_simulation_take_free_entity(struct rr_simulation *this)
 {
-#define XX(COMPONENT, ID) this->COMPONENT##_count = 0;
-    RR_FOR_EACH_COMPONENT;
-#undef XX
-    for (EntityIdx entity = 1; entity < RR_MAX_ENTITY_COUNT; ++entity)
+    // the client main simulation also holds server assigned ids, so an id
+    // may have been taken since it was released
+    while (this->free_entity_count > 0)
     {
-        if (!(this->entity_tracker[entity] & 1))
-            continue;
-#define XX(COMPONENT, ID)                                                      \
-    if (this->entity_tracker[entity] & (1 << ID))                              \
-        this->COMPONENT##_vector[this->COMPONENT##_count++] = entity;
-        RR_FOR_EACH_COMPONENT;
-#undef XX
+        EntityIdx entity = this->free_entities[--this->free_entity_count];
+        if (!rr_simulation_has_entity(this, entity))
+            return entity;
+    }
+    while (this->entity_watermark < RR_MAX_ENTITY_COUNT - 1)
+    {
+        EntityIdx entity = ++this->entity_watermark;
+        if (!rr_simulation_has_entity(this, entity))
+            return entity;
     }
+    return RR_NULL_ENTITY;
+}
+
+void __rr_simulation_release_entity(uint64_t i, void *captures)
+{
+    struct rr_simulation *this = captures;
+    // ids never handed out are picked up by the watermark instead
+    if (i > this->entity_watermark)
+        return;
+    assert(this->free_entity_count < RR_MAX_ENTITY_COUNT);
+    this->free_entities[this->free_entity_count++] = i;
 }
 
 void rr_simulation_for_each_entity(struct rr_simulation *this,
@@ -110,11 +133,15 @@ void rr_simulation_for_each_entity(struct rr_simulation *this,
         struct rr_simulation *this, EntityIdx entity)                          \
     {                                                                          \
         assert(rr_simulation_has_entity(this, entity));                        \
-        this->entity_tracker[entity] |= (1 << ID);                             \
+        if (!(this->entity_tracker[entity] & (1 << ID)))                       \
+        {                                                                      \
+            this->entity_tracker[entity] |= (1 << ID);                         \
+            this->COMPONENT##_vector_index[entity] = this->COMPONENT##_count;  \
+            this->COMPONENT##_vector[this->COMPONENT##_count++] = entity;      \
+        }                                                                      \
         rr_component_##COMPONENT##_init(&this->COMPONENT##_components[entity], \
                                         this);                                 \
         this->COMPONENT##_components[entity].parent_id = entity;               \
-        this->COMPONENT##_vector[this->COMPONENT##_count++] = entity;          \
         return rr_simulation_get_##COMPONENT(this, entity);                    \
     }                                                                          \
     struct rr_component_##COMPONENT *rr_simulation_get_##COMPONENT(            \
@@ -73,6 +73,15 @@ enum rr_simulation_team_id
     rr_simulation_team_id_pvp
 };
 
+// physical fields every system reads, kept in dense per-field arrays on the
+// server so sweeps over many entities stay within a few cache lines
+#define RR_FOR_EACH_PHYSICAL_HOT_FIELD                                         \
+    X(float, x)                                                                \
+    X(float, y)                                                                \
+    X(float, radius)                                                           \
+    X(float, angle)                                                            \
+    X(EntityIdx, arena)
+
 #define is_same_team(team1, team2)                                             \
     (team1 == team2 ||                                                         \
      (team1 == rr_simulation_team_id_players &&                                \
@@ -87,17 +96,49 @@ struct rr_simulation
     uint8_t pending_deletions[RR_BITSET_ROUND(RR_MAX_ENTITY_COUNT)];
     RR_SERVER_ONLY(
         uint8_t deleted_last_tick[RR_BITSET_ROUND(RR_MAX_ENTITY_COUNT)];)
+    // ids handed back by rr_simulation_release_entity, reused last in first
+    // out. ids above entity_watermark were never handed out
+    EntityIdx free_entities[RR_MAX_ENTITY_COUNT];
+    EntityIdx free_entity_count;
+    EntityIdx entity_watermark;
 
+    // COMPONENT##_vector holds every entity with the component and is kept
+    // up to date by add and unset_entity. COMPONENT##_vector_index is the
+    // position of an entity in it so removal can swap in the last entry
 #define XX(COMPONENT, ID)                                                      \
     struct rr_component_##COMPONENT                                            \
         COMPONENT##_components[RR_MAX_ENTITY_COUNT];                           \
     EntityIdx COMPONENT##_vector[RR_MAX_ENTITY_COUNT];                         \
+    EntityIdx COMPONENT##_vector_index[RR_MAX_ENTITY_COUNT];                   \
     EntityIdx COMPONENT##_count;
     RR_FOR_EACH_COMPONENT;
 #undef XX
-    RR_SERVER_ONLY(struct rr_simulation_animation animations[16384];)
+#ifdef RR_SERVER
+    // written through by the physical setters, see Component/Physical.h
+#define X(TYPE, NAME) TYPE physical_##NAME[RR_MAX_ENTITY_COUNT];
+    RR_FOR_EACH_PHYSICAL_HOT_FIELD
+#undef X
+    // the colliding_with lists of every physical packed back to back. pairs
+    // found by the broadphase are gathered first and grouped by entity once
+    // all arenas are done
+    EntityIdx *collision_pool;
+    EntityIdx (*collision_pairs)[2];
+    uint32_t collision_pair_count;
+    uint32_t collision_pair_capacity;
+    // per squad damage of the few health components that more than
+    // RR_SQUAD_DAMAGE_INLINE_COUNT squads hit
+    float squad_damage_blocks[RR_SQUAD_DAMAGE_BLOCK_COUNT][RR_SQUAD_COUNT];
+    uint16_t free_squad_damage_blocks[RR_SQUAD_DAMAGE_BLOCK_COUNT];
+    uint16_t free_squad_damage_block_count;
+    uint16_t squad_damage_blocks_used; // blocks ever handed out
+#endif
+    RR_SERVER_ONLY(
+        struct rr_simulation_animation animations[RR_MAX_ANIMATION_COUNT];)
     RR_SERVER_ONLY(uint32_t animation_length;)
     RR_SERVER_ONLY(struct rr_server *server;)
+    // bound while the simulation ticks so that everything drawn during a tick
+    // comes from one stream, see rr_rng_bind
+    RR_SERVER_ONLY(struct rr_rng rng;)
     RR_CLIENT_ONLY(uint8_t updated_this_tick;)
     uint8_t game_over;
 };
@@ -107,11 +148,12 @@ int rr_simulation_has_entity(struct rr_simulation *, EntityIdx);
 void rr_simulation_request_entity_deletion(struct rr_simulation *, EntityIdx);
 void rr_simulation_for_each_entity(struct rr_simulation *, void *,
                                    void (*)(EntityIdx, void *));
-void rr_simulation_create_component_vectors(struct rr_simulation *);
 
 // internal use
 void __rr_simulation_pending_deletion_free_components(uint64_t, void *);
 void __rr_simulation_pending_deletion_unset_entity(uint64_t, void *);
+EntityIdx __rr_simulation_take_free_entity(struct rr_simulation *);
+void __rr_simulation_release_entity(uint64_t, void *);
 
 #define XX(COMPONENT, ID)                                                      \
     uint8_t rr_simulation_has_##COMPONENT(struct rr_simulation *, EntityIdx);  \
@@ -123,3 +165,21 @@ void __rr_simulation_pending_deletion_unset_entity(uint64_t, void *);
                                             void (*)(EntityIdx, void *));
 RR_FOR_EACH_COMPONENT
 #undef XX
+
+#ifdef RR_SERVER
+#define X(TYPE, NAME)                                                          \
+    static inline TYPE rr_simulation_get_physical_##NAME(                      \
+        struct rr_simulation *this, EntityIdx entity)                          \
+    {                                                                          \
+        return this->physical_##NAME[entity];                                  \
+    }
+RR_FOR_EACH_PHYSICAL_HOT_FIELD
+#undef X
+
+static inline EntityIdx *
+rr_simulation_get_colliding_with(struct rr_simulation *this,
+                                 struct rr_component_physical *physical)
+{
+    return this->collision_pool + physical->colliding_with_start;
+}
+#endif
@@ -64,7 +64,9 @@ enum rr_clientbound_packet_header
     rr_clientbound_squad_leave,
     rr_clientbound_account_result,
     rr_clientbound_craft_result,
-    rr_clientbound_oauth2_data
+    rr_clientbound_oauth2_data,
+    rr_clientbound_account_delta,
+    rr_clientbound_max
 };
 
 enum rr_dev_cheat_type
@@ -251,6 +253,11 @@ struct rr_maze_grid
     uint32_t grid_points;
     float local_difficulty;
     float overload_factor;
+    double spawn_rarity_thresholds[2];
+    uint32_t flower_count;
+    uint8_t spawn_rarity;
+    // set on the top left grid of a 2x2 block in the arena's active list
+    uint8_t active;
 #endif
     uint8_t value;
     float difficulty;
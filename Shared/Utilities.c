@@ -20,6 +20,7 @@
 #include <stdlib.h>
 #include <string.h>
 #include <ctype.h>
+#include <time.h>
 
 void rr_log_hex(uint8_t *start, uint8_t *end)
 {
@@ -53,7 +54,95 @@ float rr_angle_lerp(float start, float end, float t)
     }
 }
 
-float rr_frand() { return (double)rand() / ((double)RAND_MAX + 1.0); }
+static _Thread_local struct rr_rng thread_rng;
+static _Thread_local struct rr_rng *bound_rng;
+
+static uint64_t splitmix64(uint64_t *x)
+{
+    uint64_t z = (*x += 0x9e3779b97f4a7c15);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111eb;
+    return z ^ (z >> 31);
+}
+
+void rr_rng_seed(struct rr_rng *this, uint64_t seed)
+{
+    // splitmix64 never yields two zero words in a row
+    uint64_t a = splitmix64(&seed);
+    uint64_t b = splitmix64(&seed);
+    this->s[0] = a;
+    this->s[1] = a >> 32;
+    this->s[2] = b;
+    this->s[3] = b >> 32;
+}
+
+static inline uint32_t rotl(uint32_t x, int k)
+{
+    return (x << k) | (x >> (32 - k));
+}
+
+uint32_t rr_rng_next(struct rr_rng *this)
+{
+    uint32_t *s = this->s;
+    uint32_t result = rotl(s[1] * 5, 7) * 9;
+    uint32_t t = s[1] << 9;
+    s[2] ^= s[0];
+    s[3] ^= s[1];
+    s[1] ^= s[2];
+    s[0] ^= s[3];
+    s[2] ^= t;
+    s[3] = rotl(s[3], 11);
+    return result;
+}
+
+// the top 24 bits fill a float mantissa exactly, so the result is in [0, 1)
+float rr_rng_frand(struct rr_rng *this)
+{
+    return (rr_rng_next(this) >> 8) * 0x1p-24f;
+}
+
+void rr_rng_frand_n(struct rr_rng *this, float *out, uint32_t count)
+{
+    // a local copy keeps the state in registers across the loop
+    struct rr_rng rng = *this;
+    for (uint32_t i = 0; i < count; ++i)
+        out[i] = (rr_rng_next(&rng) >> 8) * 0x1p-24f;
+    *this = rng;
+}
+
+static struct rr_rng *current_rng()
+{
+    if (__builtin_expect(bound_rng == NULL, 0))
+    {
+        // distinct per thread even when two threads start in the same second
+        rr_rng_seed(&thread_rng, (uintptr_t)&thread_rng ^ time(NULL));
+        bound_rng = &thread_rng;
+    }
+    return bound_rng;
+}
+
+struct rr_rng *rr_rng_bind(struct rr_rng *rng)
+{
+    struct rr_rng *previous = current_rng();
+    bound_rng = rng;
+    return previous;
+}
+
+void rr_srand(uint64_t seed)
+{
+    rr_rng_seed(&thread_rng, seed);
+    if (bound_rng == NULL)
+        bound_rng = &thread_rng;
+}
+
+uint32_t rr_rand() { return rr_rng_next(current_rng()); }
+
+float rr_frand() { return rr_rng_frand(current_rng()); }
+
+void rr_frand_n(float *out, uint32_t count)
+{
+    rr_rng_frand_n(current_rng(), out, count);
+}
 
 float rr_fclamp(float v, float s, float e)
 {
@@ -38,11 +38,31 @@
 #define RR_SERVER_ONLY(...)
 #endif
 
+// xoshiro128**. the state must never be all zeroes, which rr_rng_seed
+// guarantees
+struct rr_rng
+{
+    uint32_t s[4];
+};
+
+void rr_rng_seed(struct rr_rng *, uint64_t);
+uint32_t rr_rng_next(struct rr_rng *);
+float rr_rng_frand(struct rr_rng *);
+void rr_rng_frand_n(struct rr_rng *, float *, uint32_t);
+// returns the generator that was bound before
+struct rr_rng *rr_rng_bind(struct rr_rng *);
+
 void rr_log_hex(uint8_t *, uint8_t *);
 float rr_lerp(float, float, float);
 float rr_angle_lerp(float, float, float);
 int rr_angle_within(float, float, float);
+// the draw functions below use the generator bound to the calling thread.
+// that is the thread's own, seeded with rr_srand or from the clock on first
+// use, unless another one was bound with rr_rng_bind
+void rr_srand(uint64_t);
+uint32_t rr_rand();
 float rr_frand();
+void rr_frand_n(float *, uint32_t);
 float rr_fclamp(float, float, float);
 char *rr_sprintf(char *, double);
 uint8_t rr_validate_user_string(char *);